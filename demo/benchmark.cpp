@@ -0,0 +1,1000 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../include/mapped.hpp"
+#include "../include/outofcore.hpp"
+#include "../include/skyline.hpp"
+
+// Five point Laplacian on an m by m grid in natural ordering, every column has height m
+template <typename R> skyline::SymmetricMatrix<size_t, R, std::vector> laplacian(size_t m)
+{
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m);
+  }
+  skyline::SymmetricMatrix<size_t, R, std::vector> sky(heights);
+  for (size_t k = 0; k < n; ++k) {
+    sky(k, k) = 4.0;
+    if (k % m != 0) {
+      sky(k - 1, k) = -1.0;
+    }
+    if (k >= m) {
+      sky(k - m, k) = -1.0;
+    }
+  }
+  return sky;
+}
+
+template <typename F> double seconds(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+template <typename R> void kernel_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  auto original = laplacian<R>(m);
+  std::vector<R> reference;
+  skyline::kernels::Isa best = skyline::kernels::detect();
+  printf("%-8s %12s %12s %12s\n", "Kernels", "utdu (s)", "solve (s)", "rel. diff");
+  for (int isa = 0; isa <= static_cast<int>(best); ++isa) {
+    skyline::kernels::set_isa(static_cast<skyline::kernels::Isa>(isa));
+    double factor = 0.0;
+    double solve = 0.0;
+    std::vector<R> x;
+    for (int i = 0; i < repeat; ++i) {
+      auto sky = original;
+      factor += seconds([&]() { sky.utdu(); });
+      x.assign(n, 1.0);
+      solve += seconds([&]() {
+        sky.forward_substitution(x);
+        sky.back_substitution(x);
+      });
+    }
+    if (reference.empty()) {
+      reference = x;
+    }
+    double diff = 0.0;
+    double size = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      diff = std::max(diff, (double)std::abs(x[i] - reference[i]));
+      size = std::max(size, (double)std::abs(reference[i]));
+    }
+    printf("%-8s %12.4e %12.4e %12.4e\n", skyline::kernels::name(skyline::kernels::isa()), factor / repeat,
+      solve / repeat, diff / size);
+  }
+  skyline::kernels::set_isa(best);
+}
+
+// Floating point operations in utdu, counting a multiply-add as two
+template <typename R> double utdu_flops(const skyline::SymmetricMatrix<size_t, R, std::vector> &sky)
+{
+  auto minima = sky.minima();
+  double flops = 0.0;
+  for (size_t k = 0; k < minima.size(); ++k) {
+    flops += 3.0 * (k - minima[k]);
+    for (size_t j = minima[k]; j < k; ++j) {
+      flops += 2.0 * (j - std::max(minima[k], minima[j]));
+    }
+  }
+  return flops;
+}
+
+template <typename R> void panel_benchmark(size_t m, int repeat)
+{
+  auto original = laplacian<R>(m);
+  double flops = utdu_flops(original);
+  skyline::kernels::Isa best = skyline::kernels::isa();
+  printf("%-18s %12s %12s\n", "utdu", "time (s)", "GFLOP/s");
+  for (int run = 0; run < 3; ++run) {
+    bool blocked = run == 2;
+    skyline::kernels::set_isa(run == 0 ? skyline::kernels::Isa::Scalar : best);
+    double factor = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+      auto sky = original;
+      sky.blocked(blocked);
+      factor += seconds([&]() { sky.utdu(); });
+    }
+    factor /= repeat;
+    std::string label = std::string(blocked ? "Blocked " : "Columns ") + skyline::kernels::name(skyline::kernels::isa());
+    printf("%-18s %12.4e %12.4f\n", label.c_str(), factor, 1.0e-9 * flops / factor);
+  }
+  skyline::kernels::set_isa(best);
+}
+
+// Factor with 1 through the given number of threads, the speedup is relative to one thread
+template <typename R> void thread_benchmark(size_t m, int repeat, unsigned threads)
+{
+  auto original = laplacian<R>(m);
+  double flops = utdu_flops(original);
+  double serial = 0.0;
+  printf("%-8s %12s %12s %12s\n", "Threads", "time (s)", "GFLOP/s", "speedup");
+  for (unsigned t = 1; t <= threads; ++t) {
+    double factor = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+      auto sky = original;
+      sky.threads(t);
+      factor += seconds([&]() { sky.utdu(); });
+    }
+    factor /= repeat;
+    if (t == 1) {
+      serial = factor;
+    }
+    printf("%-8u %12.4e %12.4f %12.4f\n", t, factor, 1.0e-9 * flops / factor, serial / factor);
+  }
+}
+
+// The substitutions with threads, for the Laplacian, for many separate dense blocks of m
+// unknowns, where the rows in the same place in each block can be solved together, and for the
+// same blocks with a border of m / 2 unknowns coupling all of them, as nested dissection gives
+void level_benchmark(size_t m, int repeat, unsigned threads)
+{
+  auto dense_blocks = [&](size_t border) {
+    size_t n = m * m + border;
+    std::vector<size_t> heights(n);
+    for (size_t k = 0; k < n; ++k) {
+      heights[k] = k < m * m ? k % m : k;
+    }
+    skyline::SymmetricMatrix<size_t, double, std::vector> blocks(heights);
+    for (size_t k = 0; k < n; ++k) {
+      blocks(k, k) = 2.0 * n;
+      for (size_t i = k - heights[k]; i < k; ++i) {
+        blocks(i, k) = -1.0;
+      }
+    }
+    return blocks;
+  };
+  const char *names[] = { "Laplacian", "Blocks", "Bordered" };
+  printf("%-12s %8s %8s %12s %12s %12s\n", "Matrix", "levels", "threads", "time (s)", "GFLOP/s", "speedup");
+  for (int run = 0; run < 3; ++run) {
+    auto original = run == 0 ? laplacian<double>(m) : dense_blocks(run == 1 ? 0 : m / 2);
+    size_t n = original.rows();
+    original.utdu();
+    double flops = 4.0 * original.structure()->profile() + n;
+    double serial = 0.0;
+    for (unsigned t = 1; t <= threads; ++t) {
+      auto sky = original;
+      sky.threads(t);
+      std::vector<double> b(n);
+      double solve = 0.0;
+      for (int i = 0; i < repeat; ++i) {
+        std::fill(b.begin(), b.end(), 1.0);
+        solve += seconds([&]() {
+          sky.forward_substitution(b);
+          sky.back_substitution(b);
+        });
+      }
+      solve /= repeat;
+      if (t == 1) {
+        serial = solve;
+      }
+      printf("%-12s %8zu %8u %12.4e %12.4f %12.4f\n", names[run],
+        (size_t)sky.structure()->forward_levels(), t, solve, 1.0e-9 * flops / solve, serial / solve);
+    }
+  }
+}
+
+// The product with the skyline against the separate dot and axpy passes that it replaces, with
+// the rate at which the values are read next to that of a plain copy of the same size
+template <typename R> void product_benchmark(size_t m, int repeat, unsigned threads)
+{
+  size_t n = m * m;
+  auto sky = laplacian<R>(m);
+  size_t size = n + sky.structure()->profile();
+  std::vector<R> x(n, 1.0), y(n), values(size, 1.0), copy(size);
+  double two = 0.0;
+  double one = 0.0;
+  double copied = 0.0;
+  std::vector<R> ad = sky.diagonal();
+  std::vector<R> au = sky.upper();
+  std::vector<size_t> ik = sky.offsets();
+  std::vector<size_t> im = sky.minima();
+  for (int r = 0; r < repeat; ++r) {
+    two += seconds([&]() {
+      for (size_t k = 0; k < n; ++k) {
+        y[k] = ad[k] * x[k];
+      }
+      for (size_t k = 1; k < n; ++k) {
+        y[k] += skyline::kernels::dot(au.data() + ik[k], x.data() + im[k], k - im[k]);
+        skyline::kernels::axpy(x[k], au.data() + ik[k], y.data() + im[k], k - im[k]);
+      }
+    });
+    one += seconds([&]() { sky.multiply(x, y); });
+    copied += seconds([&]() { std::copy(values.begin(), values.end(), copy.begin()); });
+  }
+  double bytes = (double)(size * sizeof(R));
+  printf("%-12s %12s %12s\n", "", "time (s)", "GB/s");
+  printf("%-12s %12.4e %12.2f\n", "dot, axpy", two / repeat, repeat * bytes / two * 1.0e-9);
+  printf("%-12s %12.4e %12.2f\n", "multiply", one / repeat, repeat * bytes / one * 1.0e-9);
+  if (threads > 1) {
+    sky.threads(threads);
+    double parallel = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+      parallel += seconds([&]() { sky.multiply(x, y); });
+    }
+    printf("%-9s %2u %12.4e %12.2f\n", "threads", threads, parallel / repeat, repeat * bytes / parallel * 1.0e-9);
+  }
+  printf("%-12s %12.4e %12.2f\n", "copy", copied / repeat, 2.0 * repeat * bytes / copied * 1.0e-9);
+}
+
+// Conjugate gradients on the Laplacian with the preconditioner cut down to narrower and
+// narrower bands, next to the direct solve with the full skyline
+void cg_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  std::vector<std::vector<size_t>> adjacency(n);
+  for (size_t k = 0; k < n; ++k) {
+    if (k % m != 0) {
+      adjacency[k].push_back(k - 1);
+    }
+    if (k >= m) {
+      adjacency[k].push_back(k - m);
+    }
+  }
+  skyline::ConjugateGradientMatrix<size_t, double, std::vector> cg{ skyline::Graph<size_t, std::vector>(adjacency) };
+  for (size_t k = 0; k < n; ++k) {
+    cg(k, k) = 4.0;
+    for (size_t j : adjacency[k]) {
+      cg(j, k) = -1.0;
+    }
+  }
+  std::vector<double> b(n, 1.0);
+  auto sky = laplacian<double>(m);
+  double direct = 0.0;
+  for (int r = 0; r < repeat; ++r) {
+    auto copy(sky);
+    std::vector<double> x(b);
+    direct += seconds([&]() { copy.ldlt_solve(x); });
+  }
+  printf("%-10s %12s %10s %12s\n", "Band", "profile", "iterations", "time (s)");
+  printf("%-10s %12zu %10s %12.4e\n", "direct", sky.structure()->profile(), "", direct / repeat);
+  for (size_t band : { m, (size_t)1, (size_t)0 }) {
+    cg.band(band);
+    double time = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+      std::vector<double> x(b);
+      time += seconds([&]() {
+        cg.precondition();
+        cg.solve(x);
+      });
+    }
+    printf("%-10zu %12zu %10zu %12.4e\n", band, cg.preconditioner()->structure()->profile(), cg.iterations(),
+      time / repeat);
+  }
+}
+
+// Building the Laplacian from triplets, against the heights and element by element writes
+void assembly_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  double triplets = 0.0;
+  double elements = 0.0;
+  for (int r = 0; r < repeat; ++r) {
+    triplets += seconds([&]() {
+      skyline::TripletAssembler<size_t, double, std::vector> assembler(n);
+      assembler.reserve(3 * n);
+      for (size_t k = 0; k < n; ++k) {
+        assembler.add(k, k, 4.0);
+        if (k % m != 0) {
+          assembler.add(k, k - 1, -1.0);
+        }
+        if (k >= m) {
+          assembler.add(k, k - m, -1.0);
+        }
+      }
+      auto sky = assembler.matrix();
+    });
+    elements += seconds([&]() { auto sky = laplacian<double>(m); });
+  }
+  printf("%-12s %12s\n", "", "time (s)");
+  printf("%-12s %12.4e\n", "triplets", triplets / repeat);
+  printf("%-12s %12.4e\n", "elements", elements / repeat);
+}
+
+// Moving the Laplacian in and out of compressed sparse rows
+void compressed_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  auto sky = laplacian<double>(m);
+  std::vector<size_t> offsets{ 0 }, indices;
+  std::vector<double> values;
+  for (size_t k = 0; k < n; ++k) {
+    for (size_t j : { k - m, k - 1, k, k + 1, k + m }) {
+      if (j < n && (j / m == k / m || j % m == k % m)) {
+        indices.push_back(j);
+        values.push_back(j == k ? 4.0 : -1.0);
+      }
+    }
+    offsets.push_back(indices.size());
+  }
+  std::vector<double> out(values.size());
+  double in = 0.0;
+  double assign = 0.0;
+  double export_time = 0.0;
+  for (int r = 0; r < repeat; ++r) {
+    in += seconds([&]() { skyline::SymmetricMatrix<size_t, double, std::vector> built(offsets, indices, values); });
+    assign += seconds([&]() { sky.assign_compressed(offsets, indices, values); });
+    export_time += seconds([&]() { sky.compressed_values(offsets, indices, out); });
+  }
+  printf("%-22s %12s\n", "", "time (s)");
+  printf("%-22s %12.4e\n", "build from rows", in / repeat);
+  printf("%-22s %12.4e\n", "assign from rows", assign / repeat);
+  printf("%-22s %12.4e\n", "values out to rows", export_time / repeat);
+}
+
+// Adding up bilinear elements on an m x m grid of cells, one element at a time through element
+// access and from the threads in both ways that keep them apart
+void scatter_benchmark(size_t m, int repeat, unsigned threads)
+{
+  size_t n = (m + 1) * (m + 1);
+  std::vector<std::vector<size_t>> elements;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m + 2);
+  }
+  for (size_t y = 0; y < m; ++y) {
+    for (size_t x = 0; x < m; ++x) {
+      size_t c = y * (m + 1) + x;
+      elements.push_back({ c, c + 1, c + m + 1, c + m + 2 });
+    }
+  }
+  auto contribution = [&](size_t e, const auto &add) {
+    const std::vector<size_t> &nodes = elements[e];
+    for (size_t p = 0; p < 4; ++p) {
+      add(nodes[p], nodes[p], 2.0);
+      for (size_t q = p + 1; q < 4; ++q) {
+        add(nodes[p], nodes[q], -0.5);
+      }
+    }
+  };
+  skyline::SymmetricMatrix<size_t, double, std::vector> sky(heights);
+  double serial = 0.0;
+  for (int r = 0; r < repeat; ++r) {
+    serial += seconds([&]() {
+      for (size_t e = 0; e < elements.size(); ++e) {
+        contribution(e, [&](size_t i, size_t j, double v) { sky(i, j) += v; });
+      }
+    });
+  }
+  sky.threads(threads);
+  skyline::ScatterAssembler<size_t, double, std::vector> assembler(sky, elements);
+  printf("%-22s %12s\n", "", "time (s)");
+  printf("%-22s %12.4e\n", "element access", serial / repeat);
+  for (auto scatter : { skyline::Scatter::Colored, skyline::Scatter::Private }) {
+    double time = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+      time += seconds([&]() { assembler.add(contribution, scatter); });
+    }
+    printf("%-9s %2u threads %12.4e\n", scatter == skyline::Scatter::Colored ? "colored" : "private", threads,
+      time / repeat);
+  }
+}
+
+// Starting up by building and factoring the Laplacian, against mapping the factors from a file
+// and solving with them
+void mapped_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  const char *path = "benchmark.sky";
+  std::vector<double> b(n, 1.0);
+  {
+    auto sky = laplacian<double>(m);
+    sky.utdu();
+    skyline::MappedSymmetricMatrix<size_t, double, std::vector>::write(sky, path);
+  }
+  double rebuild = 0.0;
+  double mapped = 0.0;
+  for (int r = 0; r < repeat; ++r) {
+    std::vector<double> x(b);
+    rebuild += seconds([&]() {
+      auto sky = laplacian<double>(m);
+      sky.ldlt_solve(x);
+    });
+    std::vector<double> y(b);
+    mapped += seconds([&]() {
+      skyline::MappedSymmetricMatrix<size_t, double, std::vector> factors(path);
+      factors.solve(y);
+    });
+  }
+  std::remove(path);
+  printf("%-22s %12s\n", "", "time (s)");
+  printf("%-22s %12.4e\n", "build, factor, solve", rebuild / repeat);
+  printf("%-22s %12.4e\n", "map, solve", mapped / repeat);
+}
+
+// Factoring and solving the Laplacian from a file with windows of a few sizes, against the
+// same in memory
+void outofcore_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  std::vector<size_t> offsets{ 0 }, indices;
+  std::vector<double> values;
+  for (size_t k = 0; k < n; ++k) {
+    for (size_t j : { k - m, k - 1, k }) {
+      if (j < n && (j / m == k / m || j % m == k % m)) {
+        indices.push_back(j);
+        values.push_back(j == k ? 4.0 : -1.0);
+      }
+    }
+    offsets.push_back(indices.size());
+  }
+  std::vector<double> b(n, 1.0);
+  double memory = 0.0;
+  std::vector<size_t> heights;
+  for (int r = 0; r < repeat; ++r) {
+    skyline::SymmetricMatrix<size_t, double, std::vector> sky(offsets, indices, values);
+    heights = sky.heights();
+    std::vector<double> x(b);
+    memory += seconds([&]() { sky.ldlt_solve(x); });
+  }
+  const char *path = "benchmark.sky";
+  size_t bytes = (n + std::accumulate(heights.begin(), heights.end(), (size_t)0)) * sizeof(double);
+  printf("%-12s %8s %12s %12s\n", "Window (MB)", "blocks", "time (s)", "ratio");
+  printf("%-12.1f %8d %12.4e %12.2f\n", bytes / 1048576.0, 0, memory / repeat, 1.0);
+  for (size_t window : { bytes / 4, bytes / 16, bytes / 64 }) {
+    double disk = 0.0;
+    size_t blocks = 0;
+    for (int r = 0; r < repeat; ++r) {
+      skyline::OutOfCoreMatrix<size_t, double, std::vector> sky(heights, path, window);
+      sky.assign_compressed(offsets, indices, values);
+      blocks = sky.blocks();
+      std::vector<double> x(b);
+      disk += seconds([&]() { sky.ldlt_solve(x); });
+    }
+    printf("%-12.1f %8zu %12.4e %12.2f\n", window / 1048576.0, blocks, disk / repeat, disk / memory);
+  }
+  std::remove(path);
+}
+
+// Forward substitution for a right hand side with a single nonzero, over every row and over
+// only the rows it reaches
+void sparse_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = k % m;
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> blocks(heights);
+  for (size_t k = 0; k < n; ++k) {
+    blocks(k, k) = 100.0;
+    for (size_t i = k - k % m; i < k; ++i) {
+      blocks(i, k) = -1.0;
+    }
+  }
+  blocks.utdu();
+  auto grid = laplacian<double>(m);
+  grid.utdu();
+  printf("%-12s %10s %10s %12s %12s %12s\n", "Matrix", "nonzero", "reach", "full (s)", "sparse (s)", "speedup");
+  for (int run = 0; run < 2; ++run) {
+    auto &sky = run == 0 ? grid : blocks;
+    for (size_t i : { n / 2, n - m, n - 1 }) {
+      std::vector<double> b(n);
+      double full = 0.0;
+      double sparse = 0.0;
+      size_t reach = 0;
+      for (int r = 0; r < repeat; ++r) {
+        std::fill(b.begin(), b.end(), 0.0);
+        b[i] = 1.0;
+        full += seconds([&]() { sky.forward_substitution(b); });
+        std::fill(b.begin(), b.end(), 0.0);
+        b[i] = 1.0;
+        sparse += seconds([&]() { reach = sky.sparse_forward_substitution(b, { i }).size(); });
+      }
+      printf("%-12s %10zu %10zu %12.4e %12.4e %12.2f\n", run == 0 ? "Laplacian" : "Blocks", i, reach, full / repeat,
+        sparse / repeat, full / sparse);
+    }
+  }
+}
+
+// Back substitution for a few monitored unknowns, over every column and over only the columns
+// they depend on
+void partial_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  auto sky = laplacian<double>(m);
+  sky.utdu();
+  std::vector<double> b(n, 1.0);
+  sky.forward_substitution(b);
+  printf("%-22s %10s %12s %12s %12s\n", "Unknowns", "columns", "full (s)", "partial (s)", "speedup");
+  std::vector<std::pair<const char *, std::vector<size_t>>> cases{ { "last", { n - 1 } },
+    { "last row of the grid", { n - m, n - m / 2, n - 1 } }, { "middle", { n / 2 } }, { "first", { 0 } } };
+  for (auto &c : cases) {
+    double full = 0.0;
+    double partial = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+      std::vector<double> z(b);
+      full += seconds([&]() { sky.back_substitution(z); });
+      z = b;
+      partial += seconds([&]() { sky.partial_back_substitution(z, c.second); });
+    }
+    printf("%-22s %10zu %12.4e %12.4e %12.2f\n", c.first, sky.reach(c.second).size(), full / repeat,
+      partial / repeat, full / partial);
+  }
+}
+
+// Change one value and refactor, the cost depends on how far along the changed column is
+template <typename R> void refactor_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  auto sky = laplacian<R>(m);
+  sky.track(true);
+  double full = seconds([&]() { sky.utdu(); });
+  printf("%-18s %12s %12s\n", "Changed column", "time (s)", "fraction");
+  printf("%-18s %12.4e %12.4f\n", "all", full, 1.0);
+  for (size_t k : { n / 2, n - m, n - 1 }) {
+    double factor = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+      sky(k - 1, k) = -1.0 - 0.01 * (i + 1);
+      factor += seconds([&]() { sky.utdu(); });
+    }
+    factor /= repeat;
+    printf("%-18zu %12.4e %12.4f\n", k, factor, factor / full);
+  }
+}
+
+// Solve for several right hand sides one at a time and all at once with the same factors
+template <typename R> void rhs_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  auto sky = laplacian<R>(m);
+  sky.utdu();
+  printf("%-18s %12s %12s %12s\n", "Right hand sides", "single (s)", "block (s)", "speedup");
+  for (size_t nrhs : { 4, 16, 64 }) {
+    std::vector<R> b(n * nrhs);
+    for (size_t i = 0; i < b.size(); ++i) {
+      b[i] = 1.0 + (R)(i % 7);
+    }
+    std::vector<R> x(n);
+    double single = 0.0;
+    double block = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+      single += seconds([&]() {
+        for (size_t r = 0; r < nrhs; ++r) {
+          for (size_t k = 0; k < n; ++k) {
+            x[k] = b[nrhs * k + r];
+          }
+          sky.forward_substitution(x);
+          sky.back_substitution(x);
+        }
+      });
+      std::vector<R> y(b);
+      block += seconds([&]() {
+        sky.forward_substitution(y, nrhs);
+        sky.back_substitution(y, nrhs);
+      });
+    }
+    printf("%-18zu %12.4e %12.4e %12.2f\n", nrhs, single / repeat, block / repeat, single / block);
+  }
+}
+
+// Factor and solve many small systems with the same skyline one by one and in batches
+template <typename R> void batch_benchmark(size_t count, int repeat)
+{
+  constexpr size_t w = skyline::BatchedSymmetricMatrix<size_t, R, std::vector>::width();
+  printf("%-18s %12s %12s %12s\n", "Unknowns", "single (s)", "batched (s)", "speedup");
+  for (size_t m : { 4, 8, 14 }) {
+    size_t n = m * m;
+    auto original = laplacian<R>(m);
+    auto structure = original.structure();
+    std::vector<R> values = original.diagonal();
+    std::vector<R> upper = original.upper();
+    values.insert(values.end(), upper.begin(), upper.end());
+    std::vector<skyline::SymmetricMatrix<size_t, R, std::vector>> singles;
+    std::vector<skyline::BatchedSymmetricMatrix<size_t, R, std::vector>> batches;
+    for (size_t c = 0; c < count; ++c) {
+      singles.emplace_back(structure);
+    }
+    for (size_t c = 0; c < count / w; ++c) {
+      batches.emplace_back(structure);
+    }
+    std::vector<R> b(n, 1.0), bb(n * w, 1.0);
+    double single = 0.0;
+    double batched = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+      for (size_t c = 0; c < count; ++c) {
+        values[0] = 4.0 + 0.001 * c;
+        singles[c].refactor(values);
+      }
+      single += seconds([&]() {
+        for (auto &sky : singles) {
+          sky.utdu();
+          std::fill(b.begin(), b.end(), 1.0);
+          sky.forward_substitution(b);
+          sky.back_substitution(b);
+        }
+      });
+      for (size_t c = 0; c < count; ++c) {
+        values[0] = 4.0 + 0.001 * c;
+        batches[c / w].set(c % w, values);
+      }
+      batched += seconds([&]() {
+        for (auto &batch : batches) {
+          std::fill(bb.begin(), bb.end(), 1.0);
+          batch.ldlt_solve(bb);
+        }
+      });
+    }
+    printf("%-18zu %12.4e %12.4e %12.2f\n", n, single / repeat, batched / repeat, single / batched);
+  }
+}
+
+// Building, factoring and solving many matrices with a shared structure in each time step.
+// The matrices of a step are all kept until the end of the step, as they would be in a
+// simulation, and then thrown away.
+template <template <typename ...> typename V> double timestep_case(size_t m, size_t count, int steps,
+  typename V<double>::allocator_type allocator, std::function<void()> end_step)
+{
+  size_t n = m * m;
+  V<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m);
+  }
+  auto structure = std::make_shared<const skyline::Structure<size_t, V>>(heights);
+  V<double> values(n + structure->profile(), 0.0);
+  for (size_t k = 0; k < n; ++k) {
+    values[k] = 4.0;
+  }
+  std::vector<skyline::SymmetricMatrix<size_t, double, V>> skies;
+  skies.reserve(count);
+  return seconds([&]() {
+    for (int step = 0; step < steps; ++step) {
+      for (size_t c = 0; c < count; ++c) {
+        skies.emplace_back(structure, allocator);
+        values[0] = 4.0 + 0.001 * c;
+        skies.back().refactor(values);
+      }
+      for (auto &sky : skies) {
+        V<double> b(n, 1.0, allocator);
+        sky.forward_substitution(b);
+        sky.back_substitution(b);
+      }
+      skies.clear();
+      end_step();
+    }
+  });
+}
+
+// The same with the default vectors, with aligned vectors and with polymorphic vectors from an
+// arena that is released at the end of each step
+void timestep_benchmark(size_t count, int steps)
+{
+  printf("%-18s %12s %12s %12s\n", "Unknowns", "default (s)", "aligned (s)", "arena (s)");
+  for (size_t m : { 4, 8, 16 }) {
+    double plain = timestep_case<std::vector>(m, count, steps, {}, []() {});
+    double aligned = timestep_case<skyline::AlignedVector>(m, count, steps, {}, []() {});
+    // The arena starts out with room for a whole step, so after the first step it never goes
+    // back to the heap
+    size_t n = m * m;
+    std::vector<char> buffer(count * 2 * (n * (m + 4) * sizeof(double) + 5 * skyline::storage_alignment));
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+    skyline::AlignedResource resource(&arena);
+    double pooled = timestep_case<std::pmr::vector>(m, count, steps, &resource, [&arena]() { arena.release(); });
+    printf("%-18zu %12.4e %12.4e %12.4e\n", n, plain, aligned, pooled);
+  }
+}
+
+// Refactoring and solving one small system many times over, with the skyline fixed when
+// compiled and with the same skyline in a SymmetricMatrix
+template <typename F> void fixed_case(size_t count)
+{
+  constexpr size_t n = F::rows();
+  auto heights = F::heights();
+  std::vector<size_t> h(heights.begin(), heights.end());
+  skyline::SymmetricMatrix<size_t, double, std::vector> sky(h);
+  F fixed;
+  std::vector<double> values(n + F::profile(), -1.0);
+  std::fill(values.begin(), values.begin() + n, 2.0 * n);
+  std::array<double, n + F::profile()> fixed_values;
+  std::copy(values.begin(), values.end(), fixed_values.begin());
+  double checksum[2] = { 0.0, 0.0 };
+  std::vector<double> b(n);
+  double single = seconds([&]() {
+    for (size_t c = 0; c < count; ++c) {
+      values[0] = 2.0 * n + 1.0e-6 * c;
+      sky.refactor(values);
+      std::fill(b.begin(), b.end(), 1.0);
+      sky.forward_substitution(b);
+      sky.back_substitution(b);
+      checksum[0] += b[0];
+    }
+  });
+  std::array<double, n> x;
+  double fixed_time = seconds([&]() {
+    for (size_t c = 0; c < count; ++c) {
+      fixed_values[0] = 2.0 * n + 1.0e-6 * c;
+      fixed.refactor(fixed_values);
+      x.fill(1.0);
+      fixed.forward_substitution(x);
+      fixed.back_substitution(x);
+      checksum[1] += x[0];
+    }
+  });
+  printf("%-18zu %12.4e %12.4e %12.2f %s\n", n, single, fixed_time, single / fixed_time,
+    std::abs(checksum[0] - checksum[1]) < 1.0e-6 * std::abs(checksum[0]) ? "" : "(mismatch)");
+}
+
+void fixed_benchmark(size_t count)
+{
+  printf("%-18s %12s %12s %12s\n", "Unknowns", "generic (s)", "fixed (s)", "speedup");
+  // A chain, a ladder and a five by six grid
+  fixed_case<skyline::FixedSymmetricMatrix<size_t, double, 0, 1, 1, 1, 1>>(count);
+  fixed_case<skyline::FixedSymmetricMatrix<size_t, double, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2>>(count);
+  fixed_case<skyline::FixedSymmetricMatrix<size_t, double, 0, 1, 2, 3, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5>>(count);
+}
+
+// The graph of the Laplacian on an m by m grid with the vertices numbered at random
+skyline::Graph<size_t, std::vector> shuffled_grid(size_t m)
+{
+  size_t n = m * m;
+  std::vector<size_t> number(n);
+  std::iota(number.begin(), number.end(), (size_t)0);
+  std::mt19937 generator(1234);
+  std::shuffle(number.begin(), number.end(), generator);
+  std::vector<std::vector<size_t>> adjacency(n);
+  for (size_t k = 0; k < n; ++k) {
+    if (k % m != 0) {
+      adjacency[number[k]].push_back(number[k - 1]);
+    }
+    if (k >= m) {
+      adjacency[number[k]].push_back(number[k - m]);
+    }
+  }
+  return skyline::Graph<size_t, std::vector>(adjacency);
+}
+
+// The graph of n points at random in the unit square, with the points closer than r linked
+skyline::Graph<size_t, std::vector> random_network(size_t n, double r)
+{
+  std::mt19937 generator(4321);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<double> x(n), y(n);
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = uniform(generator);
+    y[i] = uniform(generator);
+  }
+  std::vector<std::vector<size_t>> adjacency(n);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      if ((x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]) < r * r) {
+        adjacency[i].push_back(j);
+      }
+    }
+  }
+  return skyline::Graph<size_t, std::vector>(adjacency);
+}
+
+// Profile, ordering time and factorization time of each ordering of a graph
+void ordering_benchmark(const skyline::Graph<size_t, std::vector> &graph)
+{
+  printf("%-8s %12s %12s %12s\n", "Ordering", "profile", "order (s)", "utdu (s)");
+  std::pair<const char *, skyline::Ordering> orderings[] = { { "Natural", skyline::Ordering::Natural },
+    { "RCM", skyline::Ordering::RCM }, { "Sloan", skyline::Ordering::Sloan }, { "GPS", skyline::Ordering::GPS },
+    { "Best", skyline::Ordering::Best } };
+  for (auto &ordering : orderings) {
+    auto result = graph.evaluate(ordering.second);
+    double order = result.seconds;
+    skyline::PermutedMatrix<size_t, double, std::vector> sky(graph, result.permutation);
+    for (size_t i = 0; i < graph.size(); ++i) {
+      sky.diagonal(i) = 1.0 + graph.degree(i);
+      for (size_t j : graph.neighbors(i)) {
+        sky(i, j) = -1.0;
+      }
+    }
+    double factor = seconds([&]() { sky.utdu(); });
+    printf("%-8s %12zu %12.4e %12.4e\n", ordering.first, sky.structure()->profile(), order, factor);
+  }
+}
+
+// Convection and diffusion on an m by m grid, the same skyline as the Laplacian but not symmetric
+void nonsymmetric_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m);
+  }
+  skyline::NonsymmetricMatrix<size_t, double, std::vector> original(heights);
+  for (size_t k = 0; k < n; ++k) {
+    original(k, k) = 4.0;
+    if (k % m != 0) {
+      original(k - 1, k) = -1.3;
+      original(k, k - 1) = -0.7;
+    }
+    if (k >= m) {
+      original(k - m, k) = -1.1;
+      original(k, k - m) = -0.9;
+    }
+  }
+  printf("%-8s %12s %12s %12s\n", "Kernels", "ldu (s)", "solve (s)", "rel. diff");
+  skyline::kernels::Isa best = skyline::kernels::isa();
+  std::vector<double> reference;
+  for (auto isa : { skyline::kernels::Isa::Scalar, best }) {
+    skyline::kernels::set_isa(isa);
+    double factor = 0.0;
+    double solve = 0.0;
+    std::vector<double> x;
+    for (int i = 0; i < repeat; ++i) {
+      auto sky = original;
+      factor += seconds([&]() { sky.ldu(); });
+      x.assign(n, 1.0);
+      solve += seconds([&]() {
+        sky.forward_substitution(x);
+        sky.back_substitution(x);
+      });
+    }
+    if (reference.empty()) {
+      reference = x;
+    }
+    double diff = 0.0;
+    double size = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      diff = std::max(diff, std::abs(x[i] - reference[i]));
+      size = std::max(size, std::abs(reference[i]));
+    }
+    printf("%-8s %12.4e %12.4e %12.4e\n", skyline::kernels::name(isa), factor / repeat, solve / repeat, diff / size);
+  }
+  skyline::kernels::set_isa(best);
+}
+
+// Factor and solve in double precision, then with a single precision factorization and refinement
+void mixed_benchmark(size_t m, int repeat)
+{
+  size_t n = m * m;
+  auto original = laplacian<double>(m);
+  std::vector<double> b(n), reference;
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  printf("%-18s %12s %12s %12s\n", "Precision", "solve (s)", "iterations", "rel. diff");
+  for (int run = 0; run < 2; ++run) {
+    double solve = 0.0;
+    size_t iterations = 0;
+    std::vector<double> x;
+    for (int i = 0; i < repeat; ++i) {
+      x = b;
+      if (run == 0) {
+        auto sky = original;
+        solve += seconds([&]() { sky.ldlt_solve(x); });
+      } else {
+        skyline::MixedPrecisionMatrix<size_t, std::vector> sky(original.structure());
+        for (size_t k = 0; k < n; ++k) {
+          sky(k, k) = 4.0;
+          if (k % m != 0) {
+            sky(k - 1, k) = -1.0;
+          }
+          if (k >= m) {
+            sky(k - m, k) = -1.0;
+          }
+        }
+        solve += seconds([&]() { sky.ldlt_solve(x); });
+        iterations = sky.iterations();
+      }
+    }
+    if (reference.empty()) {
+      reference = x;
+    }
+    double diff = 0.0;
+    double size = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      diff = std::max(diff, std::abs(x[i] - reference[i]));
+      size = std::max(size, std::abs(reference[i]));
+    }
+    printf("%-18s %12.4e %12zu %12.4e\n", run == 0 ? "double" : "float + refinement", solve / repeat, iterations,
+      diff / size);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  size_t m = 100;
+  int repeat = 3;
+  if (argc > 1) {
+    m = std::stoul(argv[1]);
+  }
+  if (argc > 2) {
+    repeat = std::stoi(argv[2]);
+  }
+  unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+  if (argc > 3) {
+    threads = std::stoul(argv[3]);
+  }
+  printf("Laplacian on a %zu x %zu grid, %zu unknowns\n\n", m, m, m * m);
+  puts("double");
+  kernel_benchmark<double>(m, repeat);
+  puts("\nfloat");
+  kernel_benchmark<float>(m, repeat);
+  puts("\nPanels\n\ndouble");
+  panel_benchmark<double>(m, repeat);
+  puts("\nfloat");
+  panel_benchmark<float>(m, repeat);
+  puts("\nThreads\n\ndouble");
+  thread_benchmark<double>(m, repeat, threads);
+  puts("\nfloat");
+  thread_benchmark<float>(m, repeat, threads);
+  puts("\nSubstitutions with threads\n");
+  level_benchmark(m, repeat, std::max(threads, 2u));
+  puts("\nMatrix vector products\n\ndouble");
+  product_benchmark<double>(m, repeat, threads);
+  puts("\nfloat");
+  product_benchmark<float>(m, repeat, threads);
+  puts("\nSparse right hand sides\n");
+  sparse_benchmark(m, repeat);
+  puts("\nPartial solutions\n");
+  partial_benchmark(m, repeat);
+  puts("\nAssembly\n");
+  assembly_benchmark(m, repeat);
+  puts("\nCompressed sparse rows\n");
+  compressed_benchmark(m, repeat);
+  puts("\nConcurrent assembly\n");
+  scatter_benchmark(m, repeat, threads);
+  puts("\nStarting from mapped factors\n");
+  mapped_benchmark(m, repeat);
+  puts("\nOut of core, the first line is in memory\n");
+  outofcore_benchmark(m, repeat);
+  puts("\nRefactorization\n\ndouble");
+  refactor_benchmark<double>(m, repeat);
+  puts("\nMultiple right hand sides\n\ndouble");
+  rhs_benchmark<double>(m, repeat);
+  puts("\nfloat");
+  rhs_benchmark<float>(m, repeat);
+  puts("\nBatches of 4096 small systems\n\ndouble");
+  batch_benchmark<double>(4096, repeat);
+  puts("\nfloat");
+  batch_benchmark<float>(4096, repeat);
+  puts("\nTime steps of 1000 matrices with a shared structure, 20 steps\n");
+  timestep_benchmark(1000, 20);
+  puts("\nOne small system with a fixed skyline, solved a million times\n");
+  fixed_benchmark(1000000);
+  puts("\nConjugate gradients with a banded incomplete factorization\n");
+  cg_benchmark(m, repeat);
+  puts("\nMixed precision\n");
+  mixed_benchmark(m, repeat);
+  puts("\nNonsymmetric\n");
+  nonsymmetric_benchmark(m, repeat);
+  size_t mo = std::min(m, (size_t)60);
+  printf("\nOrderings of a %zu x %zu grid numbered at random\n\n", mo, mo);
+  ordering_benchmark(shuffled_grid(mo));
+  printf("\nOrderings of a random network of %zu points\n\n", mo * mo);
+  ordering_benchmark(random_network(mo * mo, 1.5 / mo));
+  exit(EXIT_SUCCESS);
+}
@@ -27,6 +27,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <stdio.h>
+#include <stdlib.h>
 #include "../include/skyline.hpp"
 
 int main()
@@ -0,0 +1,126 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+namespace skyline {
+
+// Storage aligned to a cache line, which is also the width of an AVX-512 register. The
+// default vectors only promise the alignment of the element type.
+constexpr std::size_t storage_alignment = 64;
+
+// An allocator that aligns every allocation to A bytes
+template <typename T, std::size_t A = storage_alignment> class AlignedAllocator
+{
+public:
+  typedef T value_type;
+
+  template <typename U> struct rebind
+  {
+    typedef AlignedAllocator<U, A> other;
+  };
+
+  AlignedAllocator() noexcept = default;
+
+  template <typename U> AlignedAllocator(const AlignedAllocator<U, A> &) noexcept
+  {}
+
+  T *allocate(std::size_t n)
+  {
+    return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(A)));
+  }
+
+  void deallocate(T *p, std::size_t) noexcept
+  {
+    ::operator delete(p, std::align_val_t(A));
+  }
+
+  template <typename U> bool operator==(const AlignedAllocator<U, A> &) const noexcept
+  {
+    return true;
+  }
+
+  template <typename U> bool operator!=(const AlignedAllocator<U, A> &) const noexcept
+  {
+    return false;
+  }
+};
+
+// A vector with aligned storage, to be given as V to the matrices
+template <typename T> using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// A memory resource that passes everything on to another with at least A byte alignment. Put
+// in front of an arena, the values of matrices built with std::pmr::vector are aligned the
+// same way as with AlignedVector.
+class AlignedResource : public std::pmr::memory_resource
+{
+public:
+  AlignedResource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource(),
+    std::size_t alignment = storage_alignment) : m_upstream(upstream), m_alignment(alignment)
+  {}
+
+  std::pmr::memory_resource *upstream() const
+  {
+    return m_upstream;
+  }
+
+  std::size_t alignment() const
+  {
+    return m_alignment;
+  }
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    return m_upstream->allocate(bytes, std::max(alignment, m_alignment));
+  }
+
+  void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+  {
+    m_upstream->deallocate(p, bytes, std::max(alignment, m_alignment));
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource *m_upstream; // Where the memory comes from
+  std::size_t m_alignment; // Least alignment of every allocation
+};
+
+}
+
+#endif // !ALLOCATOR_HPP
@@ -0,0 +1,1640 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SKYLINE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SKYLINE_TARGET(isa)
+#else
+#define SKYLINE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+// Dense kernels for the short contiguous segments of the skyline. The vector versions are
+// compiled for several instruction sets and the best one the CPU supports is picked at run
+// time. The scalar versions are the plain loops that the solver used to have inline, and
+// may be selected with set_isa to check the vector versions.
+
+namespace skyline {
+namespace kernels {
+
+enum class Isa { Scalar = 0, SSE2, AVX2, AVX512 };
+
+// Segments shorter than this are always done with the scalar loop
+constexpr std::size_t minimum_length = 16;
+
+inline Isa detect()
+{
+#if defined(SKYLINE_X86) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  int nids = info[0];
+  if (nids < 7) {
+    return Isa::SSE2;
+  }
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool fma = (info[2] & (1 << 12)) != 0;
+  if (!osxsave) {
+    return Isa::SSE2;
+  }
+  unsigned long long xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  bool avx2 = (info[1] & (1 << 5)) != 0;
+  bool avx512f = (info[1] & (1 << 16)) != 0;
+  // The AVX-512 kernels finish with the AVX2 ones
+  if (avx512f && avx2 && fma && (xcr0 & 0xe6) == 0xe6) {
+    return Isa::AVX512;
+  }
+  if (avx2 && fma && (xcr0 & 0x6) == 0x6) {
+    return Isa::AVX2;
+  }
+  return Isa::SSE2;
+#elif defined(SKYLINE_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return Isa::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return Isa::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return Isa::SSE2;
+  }
+  return Isa::Scalar;
+#else
+  return Isa::Scalar;
+#endif
+}
+
+inline std::atomic<Isa> &selected()
+{
+  static std::atomic<Isa> isa{ detect() };
+  return isa;
+}
+
+// The instruction set currently in use
+inline Isa isa()
+{
+  return selected().load(std::memory_order_relaxed);
+}
+
+// Select an instruction set, limited to what the CPU supports. Returns the one selected.
+inline Isa set_isa(Isa isa)
+{
+  Isa best = detect();
+  if (static_cast<int>(isa) > static_cast<int>(best)) {
+    isa = best;
+  }
+  selected().store(isa);
+  return isa;
+}
+
+inline const char *name(Isa isa)
+{
+  switch (isa) {
+  case Isa::SSE2:
+    return "SSE2";
+  case Isa::AVX2:
+    return "AVX2";
+  case Isa::AVX512:
+    return "AVX-512";
+  default:
+    return "Scalar";
+  }
+}
+
+namespace scalar {
+
+template <typename R> R dot(const R *a, const R *b, std::size_t n)
+{
+  R value = 0.0;
+  for (std::size_t i = 0; i < n; ++i) {
+    value += a[i] * b[i];
+  }
+  return value;
+}
+
+template <typename R> void axpy(R alpha, const R *x, R *y, std::size_t n)
+{
+  for (std::size_t i = 0; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+template <typename R> R dot_axpy(const R *a, const R *x, R alpha, R *y, std::size_t n)
+{
+  R value = 0.0;
+  for (std::size_t i = 0; i < n; ++i) {
+    value += a[i] * x[i];
+    y[i] += alpha * a[i];
+  }
+  return value;
+}
+
+template <typename R> void dot_rows(const R *a, const R *x, std::size_t ldx, std::size_t n, R *y, std::size_t m)
+{
+  for (std::size_t k = 0; k < n; ++k) {
+    const R *xk = x + k * ldx;
+    for (std::size_t r = 0; r < m; ++r) {
+      y[r] -= a[k] * xk[r];
+    }
+  }
+}
+
+template <typename R> void axpy_rows(const R *a, const R *y, std::size_t n, R *x, std::size_t ldx, std::size_t m)
+{
+  for (std::size_t k = 0; k < n; ++k) {
+    R *xk = x + k * ldx;
+    for (std::size_t r = 0; r < m; ++r) {
+      xk[r] -= a[k] * y[r];
+    }
+  }
+}
+
+template <typename R> void dot_lanes(const R *a, const R *b, std::size_t ld, std::size_t n, R *y, std::size_t m)
+{
+  for (std::size_t k = 0; k < n; ++k) {
+    const R *ak = a + k * ld;
+    const R *bk = b + k * ld;
+    for (std::size_t s = 0; s < m; ++s) {
+      y[s] -= ak[s] * bk[s];
+    }
+  }
+}
+
+template <typename R> void axpy_lanes(const R *a, const R *x, std::size_t ld, std::size_t n, R *y, std::size_t m)
+{
+  for (std::size_t k = 0; k < n; ++k) {
+    const R *ak = a + k * ld;
+    R *yk = y + k * ld;
+    for (std::size_t s = 0; s < m; ++s) {
+      yk[s] -= ak[s] * x[s];
+    }
+  }
+}
+
+template <typename R> void dot4x4(const R *const *v, const R *const *a, std::size_t n, R *out)
+{
+  for (int p = 0; p < 4; ++p) {
+    for (int q = 0; q < 4; ++q) {
+      out[4 * p + q] = dot(v[p], a[q], n);
+    }
+  }
+}
+
+}
+
+#ifdef SKYLINE_X86
+
+namespace sse2 {
+
+SKYLINE_TARGET("sse2") inline double dot(const double *a, const double *b, std::size_t n)
+{
+  __m128d s0 = _mm_setzero_pd();
+  __m128d s1 = _mm_setzero_pd();
+  __m128d s2 = _mm_setzero_pd();
+  __m128d s3 = _mm_setzero_pd();
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    s2 = _mm_add_pd(s2, _mm_mul_pd(_mm_loadu_pd(a + i + 4), _mm_loadu_pd(b + i + 4)));
+    s3 = _mm_add_pd(s3, _mm_mul_pd(_mm_loadu_pd(a + i + 6), _mm_loadu_pd(b + i + 6)));
+  }
+  s0 = _mm_add_pd(_mm_add_pd(s0, s1), _mm_add_pd(s2, s3));
+  double value = _mm_cvtsd_f64(_mm_add_sd(s0, _mm_unpackhi_pd(s0, s0)));
+  for (; i < n; ++i) {
+    value += a[i] * b[i];
+  }
+  return value;
+}
+
+SKYLINE_TARGET("sse2") inline float dot(const float *a, const float *b, std::size_t n)
+{
+  __m128 s0 = _mm_setzero_ps();
+  __m128 s1 = _mm_setzero_ps();
+  __m128 s2 = _mm_setzero_ps();
+  __m128 s3 = _mm_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+    s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+  }
+  s0 = _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3));
+  alignas(16) float sums[4];
+  _mm_store_ps(sums, s0);
+  float value = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+  for (; i < n; ++i) {
+    value += a[i] * b[i];
+  }
+  return value;
+}
+
+SKYLINE_TARGET("sse2") inline void axpy(double alpha, const double *x, double *y, std::size_t n)
+{
+  __m128d va = _mm_set1_pd(alpha);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+    _mm_storeu_pd(y + i + 2, _mm_add_pd(_mm_loadu_pd(y + i + 2), _mm_mul_pd(va, _mm_loadu_pd(x + i + 2))));
+  }
+  for (; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+SKYLINE_TARGET("sse2") inline void axpy(float alpha, const float *x, float *y, std::size_t n)
+{
+  __m128 va = _mm_set1_ps(alpha);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+    _mm_storeu_ps(y + i + 4, _mm_add_ps(_mm_loadu_ps(y + i + 4), _mm_mul_ps(va, _mm_loadu_ps(x + i + 4))));
+  }
+  for (; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+SKYLINE_TARGET("sse2") inline double dot_axpy(const double *a, const double *x, double alpha, double *y, std::size_t n)
+{
+  __m128d va = _mm_set1_pd(alpha);
+  __m128d s0 = _mm_setzero_pd();
+  __m128d s1 = _mm_setzero_pd();
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128d a0 = _mm_loadu_pd(a + i);
+    __m128d a1 = _mm_loadu_pd(a + i + 2);
+    s0 = _mm_add_pd(s0, _mm_mul_pd(a0, _mm_loadu_pd(x + i)));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(a1, _mm_loadu_pd(x + i + 2)));
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, a0)));
+    _mm_storeu_pd(y + i + 2, _mm_add_pd(_mm_loadu_pd(y + i + 2), _mm_mul_pd(va, a1)));
+  }
+  s0 = _mm_add_pd(s0, s1);
+  double value = _mm_cvtsd_f64(_mm_add_sd(s0, _mm_unpackhi_pd(s0, s0)));
+  for (; i < n; ++i) {
+    value += a[i] * x[i];
+    y[i] += alpha * a[i];
+  }
+  return value;
+}
+
+SKYLINE_TARGET("sse2") inline float dot_axpy(const float *a, const float *x, float alpha, float *y, std::size_t n)
+{
+  __m128 va = _mm_set1_ps(alpha);
+  __m128 s0 = _mm_setzero_ps();
+  __m128 s1 = _mm_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128 a0 = _mm_loadu_ps(a + i);
+    __m128 a1 = _mm_loadu_ps(a + i + 4);
+    s0 = _mm_add_ps(s0, _mm_mul_ps(a0, _mm_loadu_ps(x + i)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(a1, _mm_loadu_ps(x + i + 4)));
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, a0)));
+    _mm_storeu_ps(y + i + 4, _mm_add_ps(_mm_loadu_ps(y + i + 4), _mm_mul_ps(va, a1)));
+  }
+  s0 = _mm_add_ps(s0, s1);
+  s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+  float value = _mm_cvtss_f32(_mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1)));
+  for (; i < n; ++i) {
+    value += a[i] * x[i];
+    y[i] += alpha * a[i];
+  }
+  return value;
+}
+
+SKYLINE_TARGET("sse2") inline void dot_rows(const double *a, const double *x, std::size_t ldx, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 8 <= m; r += 8) {
+    __m128d s0 = _mm_loadu_pd(y + r);
+    __m128d s1 = _mm_loadu_pd(y + r + 2);
+    __m128d s2 = _mm_loadu_pd(y + r + 4);
+    __m128d s3 = _mm_loadu_pd(y + r + 6);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m128d va = _mm_set1_pd(a[k]);
+      const double *xk = x + k * ldx + r;
+      s0 = _mm_sub_pd(s0, _mm_mul_pd(va, _mm_loadu_pd(xk)));
+      s1 = _mm_sub_pd(s1, _mm_mul_pd(va, _mm_loadu_pd(xk + 2)));
+      s2 = _mm_sub_pd(s2, _mm_mul_pd(va, _mm_loadu_pd(xk + 4)));
+      s3 = _mm_sub_pd(s3, _mm_mul_pd(va, _mm_loadu_pd(xk + 6)));
+    }
+    _mm_storeu_pd(y + r, s0);
+    _mm_storeu_pd(y + r + 2, s1);
+    _mm_storeu_pd(y + r + 4, s2);
+    _mm_storeu_pd(y + r + 6, s3);
+  }
+  for (; r + 2 <= m; r += 2) {
+    __m128d s0 = _mm_loadu_pd(y + r);
+    __m128d s1 = _mm_setzero_pd();
+    __m128d s2 = _mm_setzero_pd();
+    __m128d s3 = _mm_setzero_pd();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm_sub_pd(s0, _mm_mul_pd(_mm_set1_pd(a[k]), _mm_loadu_pd(x + k * ldx + r)));
+      s1 = _mm_sub_pd(s1, _mm_mul_pd(_mm_set1_pd(a[k + 1]), _mm_loadu_pd(x + (k + 1) * ldx + r)));
+      s2 = _mm_sub_pd(s2, _mm_mul_pd(_mm_set1_pd(a[k + 2]), _mm_loadu_pd(x + (k + 2) * ldx + r)));
+      s3 = _mm_sub_pd(s3, _mm_mul_pd(_mm_set1_pd(a[k + 3]), _mm_loadu_pd(x + (k + 3) * ldx + r)));
+    }
+    for (; k < n; ++k) {
+      s0 = _mm_sub_pd(s0, _mm_mul_pd(_mm_set1_pd(a[k]), _mm_loadu_pd(x + k * ldx + r)));
+    }
+    _mm_storeu_pd(y + r, _mm_add_pd(_mm_add_pd(s0, s1), _mm_add_pd(s2, s3)));
+  }
+  scalar::dot_rows(a, x + r, ldx, n, y + r, m - r);
+}
+
+SKYLINE_TARGET("sse2") inline void axpy_rows(const double *a, const double *y, std::size_t n, double *x, std::size_t ldx, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 8 <= m; r += 8) {
+    __m128d y0 = _mm_loadu_pd(y + r);
+    __m128d y1 = _mm_loadu_pd(y + r + 2);
+    __m128d y2 = _mm_loadu_pd(y + r + 4);
+    __m128d y3 = _mm_loadu_pd(y + r + 6);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m128d va = _mm_set1_pd(a[k]);
+      double *xk = x + k * ldx + r;
+      _mm_storeu_pd(xk, _mm_sub_pd(_mm_loadu_pd(xk), _mm_mul_pd(va, y0)));
+      _mm_storeu_pd(xk + 2, _mm_sub_pd(_mm_loadu_pd(xk + 2), _mm_mul_pd(va, y1)));
+      _mm_storeu_pd(xk + 4, _mm_sub_pd(_mm_loadu_pd(xk + 4), _mm_mul_pd(va, y2)));
+      _mm_storeu_pd(xk + 6, _mm_sub_pd(_mm_loadu_pd(xk + 6), _mm_mul_pd(va, y3)));
+    }
+  }
+  for (; r + 2 <= m; r += 2) {
+    __m128d vy = _mm_loadu_pd(y + r);
+    for (std::size_t k = 0; k < n; ++k) {
+      double *xk = x + k * ldx + r;
+      _mm_storeu_pd(xk, _mm_sub_pd(_mm_loadu_pd(xk), _mm_mul_pd(_mm_set1_pd(a[k]), vy)));
+    }
+  }
+  scalar::axpy_rows(a, y + r, n, x + r, ldx, m - r);
+}
+
+SKYLINE_TARGET("sse2") inline void dot_rows(const float *a, const float *x, std::size_t ldx, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 16 <= m; r += 16) {
+    __m128 s0 = _mm_loadu_ps(y + r);
+    __m128 s1 = _mm_loadu_ps(y + r + 4);
+    __m128 s2 = _mm_loadu_ps(y + r + 8);
+    __m128 s3 = _mm_loadu_ps(y + r + 12);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m128 va = _mm_set1_ps(a[k]);
+      const float *xk = x + k * ldx + r;
+      s0 = _mm_sub_ps(s0, _mm_mul_ps(va, _mm_loadu_ps(xk)));
+      s1 = _mm_sub_ps(s1, _mm_mul_ps(va, _mm_loadu_ps(xk + 4)));
+      s2 = _mm_sub_ps(s2, _mm_mul_ps(va, _mm_loadu_ps(xk + 8)));
+      s3 = _mm_sub_ps(s3, _mm_mul_ps(va, _mm_loadu_ps(xk + 12)));
+    }
+    _mm_storeu_ps(y + r, s0);
+    _mm_storeu_ps(y + r + 4, s1);
+    _mm_storeu_ps(y + r + 8, s2);
+    _mm_storeu_ps(y + r + 12, s3);
+  }
+  for (; r + 4 <= m; r += 4) {
+    __m128 s0 = _mm_loadu_ps(y + r);
+    __m128 s1 = _mm_setzero_ps();
+    __m128 s2 = _mm_setzero_ps();
+    __m128 s3 = _mm_setzero_ps();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm_sub_ps(s0, _mm_mul_ps(_mm_set1_ps(a[k]), _mm_loadu_ps(x + k * ldx + r)));
+      s1 = _mm_sub_ps(s1, _mm_mul_ps(_mm_set1_ps(a[k + 1]), _mm_loadu_ps(x + (k + 1) * ldx + r)));
+      s2 = _mm_sub_ps(s2, _mm_mul_ps(_mm_set1_ps(a[k + 2]), _mm_loadu_ps(x + (k + 2) * ldx + r)));
+      s3 = _mm_sub_ps(s3, _mm_mul_ps(_mm_set1_ps(a[k + 3]), _mm_loadu_ps(x + (k + 3) * ldx + r)));
+    }
+    for (; k < n; ++k) {
+      s0 = _mm_sub_ps(s0, _mm_mul_ps(_mm_set1_ps(a[k]), _mm_loadu_ps(x + k * ldx + r)));
+    }
+    _mm_storeu_ps(y + r, _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+  }
+  scalar::dot_rows(a, x + r, ldx, n, y + r, m - r);
+}
+
+SKYLINE_TARGET("sse2") inline void axpy_rows(const float *a, const float *y, std::size_t n, float *x, std::size_t ldx, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 16 <= m; r += 16) {
+    __m128 y0 = _mm_loadu_ps(y + r);
+    __m128 y1 = _mm_loadu_ps(y + r + 4);
+    __m128 y2 = _mm_loadu_ps(y + r + 8);
+    __m128 y3 = _mm_loadu_ps(y + r + 12);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m128 va = _mm_set1_ps(a[k]);
+      float *xk = x + k * ldx + r;
+      _mm_storeu_ps(xk, _mm_sub_ps(_mm_loadu_ps(xk), _mm_mul_ps(va, y0)));
+      _mm_storeu_ps(xk + 4, _mm_sub_ps(_mm_loadu_ps(xk + 4), _mm_mul_ps(va, y1)));
+      _mm_storeu_ps(xk + 8, _mm_sub_ps(_mm_loadu_ps(xk + 8), _mm_mul_ps(va, y2)));
+      _mm_storeu_ps(xk + 12, _mm_sub_ps(_mm_loadu_ps(xk + 12), _mm_mul_ps(va, y3)));
+    }
+  }
+  for (; r + 4 <= m; r += 4) {
+    __m128 vy = _mm_loadu_ps(y + r);
+    for (std::size_t k = 0; k < n; ++k) {
+      float *xk = x + k * ldx + r;
+      _mm_storeu_ps(xk, _mm_sub_ps(_mm_loadu_ps(xk), _mm_mul_ps(_mm_set1_ps(a[k]), vy)));
+    }
+  }
+  scalar::axpy_rows(a, y + r, n, x + r, ldx, m - r);
+}
+
+SKYLINE_TARGET("sse2") inline void dot_lanes(const double *a, const double *b, std::size_t ld, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 2 <= m; s += 2) {
+    __m128d s0 = _mm_loadu_pd(y + s);
+    __m128d s1 = _mm_setzero_pd();
+    __m128d s2 = _mm_setzero_pd();
+    __m128d s3 = _mm_setzero_pd();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm_sub_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + k * ld + s), _mm_loadu_pd(b + k * ld + s)));
+      s1 = _mm_sub_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + (k + 1) * ld + s), _mm_loadu_pd(b + (k + 1) * ld + s)));
+      s2 = _mm_sub_pd(s2, _mm_mul_pd(_mm_loadu_pd(a + (k + 2) * ld + s), _mm_loadu_pd(b + (k + 2) * ld + s)));
+      s3 = _mm_sub_pd(s3, _mm_mul_pd(_mm_loadu_pd(a + (k + 3) * ld + s), _mm_loadu_pd(b + (k + 3) * ld + s)));
+    }
+    for (; k < n; ++k) {
+      s0 = _mm_sub_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + k * ld + s), _mm_loadu_pd(b + k * ld + s)));
+    }
+    _mm_storeu_pd(y + s, _mm_add_pd(_mm_add_pd(s0, s1), _mm_add_pd(s2, s3)));
+  }
+  scalar::dot_lanes(a + s, b + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("sse2") inline void axpy_lanes(const double *a, const double *x, std::size_t ld, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 2 <= m; s += 2) {
+    __m128d vx = _mm_loadu_pd(x + s);
+    for (std::size_t k = 0; k < n; ++k) {
+      double *yk = y + k * ld + s;
+      _mm_storeu_pd(yk, _mm_sub_pd(_mm_loadu_pd(yk), _mm_mul_pd(_mm_loadu_pd(a + k * ld + s), vx)));
+    }
+  }
+  scalar::axpy_lanes(a + s, x + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("sse2") inline void dot_lanes(const float *a, const float *b, std::size_t ld, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 4 <= m; s += 4) {
+    __m128 s0 = _mm_loadu_ps(y + s);
+    __m128 s1 = _mm_setzero_ps();
+    __m128 s2 = _mm_setzero_ps();
+    __m128 s3 = _mm_setzero_ps();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm_sub_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + k * ld + s), _mm_loadu_ps(b + k * ld + s)));
+      s1 = _mm_sub_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + (k + 1) * ld + s), _mm_loadu_ps(b + (k + 1) * ld + s)));
+      s2 = _mm_sub_ps(s2, _mm_mul_ps(_mm_loadu_ps(a + (k + 2) * ld + s), _mm_loadu_ps(b + (k + 2) * ld + s)));
+      s3 = _mm_sub_ps(s3, _mm_mul_ps(_mm_loadu_ps(a + (k + 3) * ld + s), _mm_loadu_ps(b + (k + 3) * ld + s)));
+    }
+    for (; k < n; ++k) {
+      s0 = _mm_sub_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + k * ld + s), _mm_loadu_ps(b + k * ld + s)));
+    }
+    _mm_storeu_ps(y + s, _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+  }
+  scalar::dot_lanes(a + s, b + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("sse2") inline void axpy_lanes(const float *a, const float *x, std::size_t ld, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 4 <= m; s += 4) {
+    __m128 vx = _mm_loadu_ps(x + s);
+    for (std::size_t k = 0; k < n; ++k) {
+      float *yk = y + k * ld + s;
+      _mm_storeu_ps(yk, _mm_sub_ps(_mm_loadu_ps(yk), _mm_mul_ps(_mm_loadu_ps(a + k * ld + s), vx)));
+    }
+  }
+  scalar::axpy_lanes(a + s, x + s, ld, n, y + s, m - s);
+}
+
+// Two columns at a time, eight accumulators
+SKYLINE_TARGET("sse2") inline void dot4x2(const double *const *v, const double *a0, const double *a1, std::size_t n, double *out)
+{
+  __m128d s[4][2];
+  for (int p = 0; p < 4; ++p) {
+    s[p][0] = _mm_setzero_pd();
+    s[p][1] = _mm_setzero_pd();
+  }
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d x0 = _mm_loadu_pd(a0 + i);
+    __m128d x1 = _mm_loadu_pd(a1 + i);
+    for (int p = 0; p < 4; ++p) {
+      __m128d y = _mm_loadu_pd(v[p] + i);
+      s[p][0] = _mm_add_pd(s[p][0], _mm_mul_pd(y, x0));
+      s[p][1] = _mm_add_pd(s[p][1], _mm_mul_pd(y, x1));
+    }
+  }
+  for (int p = 0; p < 4; ++p) {
+    for (int q = 0; q < 2; ++q) {
+      out[4 * p + q] = _mm_cvtsd_f64(_mm_add_sd(s[p][q], _mm_unpackhi_pd(s[p][q], s[p][q])));
+    }
+  }
+  for (; i < n; ++i) {
+    for (int p = 0; p < 4; ++p) {
+      out[4 * p] += v[p][i] * a0[i];
+      out[4 * p + 1] += v[p][i] * a1[i];
+    }
+  }
+}
+
+SKYLINE_TARGET("sse2") inline void dot4x2(const float *const *v, const float *a0, const float *a1, std::size_t n, float *out)
+{
+  __m128 s[4][2];
+  for (int p = 0; p < 4; ++p) {
+    s[p][0] = _mm_setzero_ps();
+    s[p][1] = _mm_setzero_ps();
+  }
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 x0 = _mm_loadu_ps(a0 + i);
+    __m128 x1 = _mm_loadu_ps(a1 + i);
+    for (int p = 0; p < 4; ++p) {
+      __m128 y = _mm_loadu_ps(v[p] + i);
+      s[p][0] = _mm_add_ps(s[p][0], _mm_mul_ps(y, x0));
+      s[p][1] = _mm_add_ps(s[p][1], _mm_mul_ps(y, x1));
+    }
+  }
+  for (int p = 0; p < 4; ++p) {
+    for (int q = 0; q < 2; ++q) {
+      alignas(16) float sums[4];
+      _mm_store_ps(sums, s[p][q]);
+      out[4 * p + q] = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+  }
+  for (; i < n; ++i) {
+    for (int p = 0; p < 4; ++p) {
+      out[4 * p] += v[p][i] * a0[i];
+      out[4 * p + 1] += v[p][i] * a1[i];
+    }
+  }
+}
+
+template <typename R> void dot4x4(const R *const *v, const R *const *a, std::size_t n, R *out)
+{
+  R half[16];
+  dot4x2(v, a[0], a[1], n, out);
+  dot4x2(v, a[2], a[3], n, half);
+  for (int p = 0; p < 4; ++p) {
+    out[4 * p + 2] = half[4 * p];
+    out[4 * p + 3] = half[4 * p + 1];
+  }
+}
+
+}
+
+namespace avx2 {
+
+// The sum of the lanes of a vector
+SKYLINE_TARGET("avx2,fma") inline double sum(__m256d s)
+{
+  __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+SKYLINE_TARGET("avx2,fma") inline float sum(__m256 s)
+{
+  __m128 h = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+  h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+  return _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+}
+
+SKYLINE_TARGET("avx2,fma") inline double dot(const double *a, const double *b, std::size_t n)
+{
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  __m256d s2 = _mm256_setzero_pd();
+  __m256d s3 = _mm256_setzero_pd();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+    s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), s1);
+    s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 8), _mm256_loadu_pd(b + i + 8), s2);
+    s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12), s3);
+  }
+  for (; i + 4 <= n; i += 4) {
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+  }
+  double value = sum(_mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3)));
+  for (; i < n; ++i) {
+    value += a[i] * b[i];
+  }
+  return value;
+}
+
+SKYLINE_TARGET("avx2,fma") inline float dot(const float *a, const float *b, std::size_t n)
+{
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  __m256 s2 = _mm256_setzero_ps();
+  __m256 s3 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+    s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), s2);
+    s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), s3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+  }
+  float value = sum(_mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+  for (; i < n; ++i) {
+    value += a[i] * b[i];
+  }
+  return value;
+}
+
+SKYLINE_TARGET("avx2,fma") inline void axpy(double alpha, const double *x, double *y, std::size_t n)
+{
+  __m256d va = _mm256_set1_pd(alpha);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    _mm256_storeu_pd(y + i + 4, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+  }
+  for (; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+SKYLINE_TARGET("avx2,fma") inline void axpy(float alpha, const float *x, float *y, std::size_t n)
+{
+  __m256 va = _mm256_set1_ps(alpha);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    _mm256_storeu_ps(y + i + 8, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+  }
+  for (; i < n; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+SKYLINE_TARGET("avx2,fma") inline double dot_axpy(const double *a, const double *x, double alpha, double *y, std::size_t n)
+{
+  __m256d va = _mm256_set1_pd(alpha);
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256d a0 = _mm256_loadu_pd(a + i);
+    __m256d a1 = _mm256_loadu_pd(a + i + 4);
+    s0 = _mm256_fmadd_pd(a0, _mm256_loadu_pd(x + i), s0);
+    s1 = _mm256_fmadd_pd(a1, _mm256_loadu_pd(x + i + 4), s1);
+    _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, a0, _mm256_loadu_pd(y + i)));
+    _mm256_storeu_pd(y + i + 4, _mm256_fmadd_pd(va, a1, _mm256_loadu_pd(y + i + 4)));
+  }
+  return sum(_mm256_add_pd(s0, s1)) + sse2::dot_axpy(a + i, x + i, alpha, y + i, n - i);
+}
+
+SKYLINE_TARGET("avx2,fma") inline float dot_axpy(const float *a, const float *x, float alpha, float *y, std::size_t n)
+{
+  __m256 va = _mm256_set1_ps(alpha);
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256 a0 = _mm256_loadu_ps(a + i);
+    __m256 a1 = _mm256_loadu_ps(a + i + 8);
+    s0 = _mm256_fmadd_ps(a0, _mm256_loadu_ps(x + i), s0);
+    s1 = _mm256_fmadd_ps(a1, _mm256_loadu_ps(x + i + 8), s1);
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, a0, _mm256_loadu_ps(y + i)));
+    _mm256_storeu_ps(y + i + 8, _mm256_fmadd_ps(va, a1, _mm256_loadu_ps(y + i + 8)));
+  }
+  return sum(_mm256_add_ps(s0, s1)) + sse2::dot_axpy(a + i, x + i, alpha, y + i, n - i);
+}
+
+SKYLINE_TARGET("avx2,fma") inline void dot_rows(const double *a, const double *x, std::size_t ldx, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 16 <= m; r += 16) {
+    __m256d s0 = _mm256_loadu_pd(y + r);
+    __m256d s1 = _mm256_loadu_pd(y + r + 4);
+    __m256d s2 = _mm256_loadu_pd(y + r + 8);
+    __m256d s3 = _mm256_loadu_pd(y + r + 12);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m256d va = _mm256_set1_pd(a[k]);
+      const double *xk = x + k * ldx + r;
+      s0 = _mm256_fnmadd_pd(va, _mm256_loadu_pd(xk), s0);
+      s1 = _mm256_fnmadd_pd(va, _mm256_loadu_pd(xk + 4), s1);
+      s2 = _mm256_fnmadd_pd(va, _mm256_loadu_pd(xk + 8), s2);
+      s3 = _mm256_fnmadd_pd(va, _mm256_loadu_pd(xk + 12), s3);
+    }
+    _mm256_storeu_pd(y + r, s0);
+    _mm256_storeu_pd(y + r + 4, s1);
+    _mm256_storeu_pd(y + r + 8, s2);
+    _mm256_storeu_pd(y + r + 12, s3);
+  }
+  for (; r + 4 <= m; r += 4) {
+    __m256d s0 = _mm256_loadu_pd(y + r);
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    __m256d s3 = _mm256_setzero_pd();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm256_fnmadd_pd(_mm256_set1_pd(a[k]), _mm256_loadu_pd(x + k * ldx + r), s0);
+      s1 = _mm256_fnmadd_pd(_mm256_set1_pd(a[k + 1]), _mm256_loadu_pd(x + (k + 1) * ldx + r), s1);
+      s2 = _mm256_fnmadd_pd(_mm256_set1_pd(a[k + 2]), _mm256_loadu_pd(x + (k + 2) * ldx + r), s2);
+      s3 = _mm256_fnmadd_pd(_mm256_set1_pd(a[k + 3]), _mm256_loadu_pd(x + (k + 3) * ldx + r), s3);
+    }
+    for (; k < n; ++k) {
+      s0 = _mm256_fnmadd_pd(_mm256_set1_pd(a[k]), _mm256_loadu_pd(x + k * ldx + r), s0);
+    }
+    _mm256_storeu_pd(y + r, _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3)));
+  }
+  sse2::dot_rows(a, x + r, ldx, n, y + r, m - r);
+}
+
+SKYLINE_TARGET("avx2,fma") inline void axpy_rows(const double *a, const double *y, std::size_t n, double *x, std::size_t ldx, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 16 <= m; r += 16) {
+    __m256d y0 = _mm256_loadu_pd(y + r);
+    __m256d y1 = _mm256_loadu_pd(y + r + 4);
+    __m256d y2 = _mm256_loadu_pd(y + r + 8);
+    __m256d y3 = _mm256_loadu_pd(y + r + 12);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m256d va = _mm256_set1_pd(a[k]);
+      double *xk = x + k * ldx + r;
+      _mm256_storeu_pd(xk, _mm256_fnmadd_pd(va, y0, _mm256_loadu_pd(xk)));
+      _mm256_storeu_pd(xk + 4, _mm256_fnmadd_pd(va, y1, _mm256_loadu_pd(xk + 4)));
+      _mm256_storeu_pd(xk + 8, _mm256_fnmadd_pd(va, y2, _mm256_loadu_pd(xk + 8)));
+      _mm256_storeu_pd(xk + 12, _mm256_fnmadd_pd(va, y3, _mm256_loadu_pd(xk + 12)));
+    }
+  }
+  for (; r + 4 <= m; r += 4) {
+    __m256d vy = _mm256_loadu_pd(y + r);
+    for (std::size_t k = 0; k < n; ++k) {
+      double *xk = x + k * ldx + r;
+      _mm256_storeu_pd(xk, _mm256_fnmadd_pd(_mm256_set1_pd(a[k]), vy, _mm256_loadu_pd(xk)));
+    }
+  }
+  sse2::axpy_rows(a, y + r, n, x + r, ldx, m - r);
+}
+
+SKYLINE_TARGET("avx2,fma") inline void dot_rows(const float *a, const float *x, std::size_t ldx, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 32 <= m; r += 32) {
+    __m256 s0 = _mm256_loadu_ps(y + r);
+    __m256 s1 = _mm256_loadu_ps(y + r + 8);
+    __m256 s2 = _mm256_loadu_ps(y + r + 16);
+    __m256 s3 = _mm256_loadu_ps(y + r + 24);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m256 va = _mm256_set1_ps(a[k]);
+      const float *xk = x + k * ldx + r;
+      s0 = _mm256_fnmadd_ps(va, _mm256_loadu_ps(xk), s0);
+      s1 = _mm256_fnmadd_ps(va, _mm256_loadu_ps(xk + 8), s1);
+      s2 = _mm256_fnmadd_ps(va, _mm256_loadu_ps(xk + 16), s2);
+      s3 = _mm256_fnmadd_ps(va, _mm256_loadu_ps(xk + 24), s3);
+    }
+    _mm256_storeu_ps(y + r, s0);
+    _mm256_storeu_ps(y + r + 8, s1);
+    _mm256_storeu_ps(y + r + 16, s2);
+    _mm256_storeu_ps(y + r + 24, s3);
+  }
+  for (; r + 8 <= m; r += 8) {
+    __m256 s0 = _mm256_loadu_ps(y + r);
+    __m256 s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps();
+    __m256 s3 = _mm256_setzero_ps();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm256_fnmadd_ps(_mm256_set1_ps(a[k]), _mm256_loadu_ps(x + k * ldx + r), s0);
+      s1 = _mm256_fnmadd_ps(_mm256_set1_ps(a[k + 1]), _mm256_loadu_ps(x + (k + 1) * ldx + r), s1);
+      s2 = _mm256_fnmadd_ps(_mm256_set1_ps(a[k + 2]), _mm256_loadu_ps(x + (k + 2) * ldx + r), s2);
+      s3 = _mm256_fnmadd_ps(_mm256_set1_ps(a[k + 3]), _mm256_loadu_ps(x + (k + 3) * ldx + r), s3);
+    }
+    for (; k < n; ++k) {
+      s0 = _mm256_fnmadd_ps(_mm256_set1_ps(a[k]), _mm256_loadu_ps(x + k * ldx + r), s0);
+    }
+    _mm256_storeu_ps(y + r, _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+  }
+  sse2::dot_rows(a, x + r, ldx, n, y + r, m - r);
+}
+
+SKYLINE_TARGET("avx2,fma") inline void axpy_rows(const float *a, const float *y, std::size_t n, float *x, std::size_t ldx, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 32 <= m; r += 32) {
+    __m256 y0 = _mm256_loadu_ps(y + r);
+    __m256 y1 = _mm256_loadu_ps(y + r + 8);
+    __m256 y2 = _mm256_loadu_ps(y + r + 16);
+    __m256 y3 = _mm256_loadu_ps(y + r + 24);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m256 va = _mm256_set1_ps(a[k]);
+      float *xk = x + k * ldx + r;
+      _mm256_storeu_ps(xk, _mm256_fnmadd_ps(va, y0, _mm256_loadu_ps(xk)));
+      _mm256_storeu_ps(xk + 8, _mm256_fnmadd_ps(va, y1, _mm256_loadu_ps(xk + 8)));
+      _mm256_storeu_ps(xk + 16, _mm256_fnmadd_ps(va, y2, _mm256_loadu_ps(xk + 16)));
+      _mm256_storeu_ps(xk + 24, _mm256_fnmadd_ps(va, y3, _mm256_loadu_ps(xk + 24)));
+    }
+  }
+  for (; r + 8 <= m; r += 8) {
+    __m256 vy = _mm256_loadu_ps(y + r);
+    for (std::size_t k = 0; k < n; ++k) {
+      float *xk = x + k * ldx + r;
+      _mm256_storeu_ps(xk, _mm256_fnmadd_ps(_mm256_set1_ps(a[k]), vy, _mm256_loadu_ps(xk)));
+    }
+  }
+  sse2::axpy_rows(a, y + r, n, x + r, ldx, m - r);
+}
+
+SKYLINE_TARGET("avx2,fma") inline void dot_lanes(const double *a, const double *b, std::size_t ld, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 4 <= m; s += 4) {
+    __m256d s0 = _mm256_loadu_pd(y + s);
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    __m256d s3 = _mm256_setzero_pd();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm256_fnmadd_pd(_mm256_loadu_pd(a + k * ld + s), _mm256_loadu_pd(b + k * ld + s), s0);
+      s1 = _mm256_fnmadd_pd(_mm256_loadu_pd(a + (k + 1) * ld + s), _mm256_loadu_pd(b + (k + 1) * ld + s), s1);
+      s2 = _mm256_fnmadd_pd(_mm256_loadu_pd(a + (k + 2) * ld + s), _mm256_loadu_pd(b + (k + 2) * ld + s), s2);
+      s3 = _mm256_fnmadd_pd(_mm256_loadu_pd(a + (k + 3) * ld + s), _mm256_loadu_pd(b + (k + 3) * ld + s), s3);
+    }
+    for (; k < n; ++k) {
+      s0 = _mm256_fnmadd_pd(_mm256_loadu_pd(a + k * ld + s), _mm256_loadu_pd(b + k * ld + s), s0);
+    }
+    _mm256_storeu_pd(y + s, _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3)));
+  }
+  sse2::dot_lanes(a + s, b + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("avx2,fma") inline void axpy_lanes(const double *a, const double *x, std::size_t ld, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 4 <= m; s += 4) {
+    __m256d vx = _mm256_loadu_pd(x + s);
+    for (std::size_t k = 0; k < n; ++k) {
+      double *yk = y + k * ld + s;
+      _mm256_storeu_pd(yk, _mm256_fnmadd_pd(_mm256_loadu_pd(a + k * ld + s), vx, _mm256_loadu_pd(yk)));
+    }
+  }
+  sse2::axpy_lanes(a + s, x + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("avx2,fma") inline void dot_lanes(const float *a, const float *b, std::size_t ld, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 8 <= m; s += 8) {
+    __m256 s0 = _mm256_loadu_ps(y + s);
+    __m256 s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps();
+    __m256 s3 = _mm256_setzero_ps();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm256_fnmadd_ps(_mm256_loadu_ps(a + k * ld + s), _mm256_loadu_ps(b + k * ld + s), s0);
+      s1 = _mm256_fnmadd_ps(_mm256_loadu_ps(a + (k + 1) * ld + s), _mm256_loadu_ps(b + (k + 1) * ld + s), s1);
+      s2 = _mm256_fnmadd_ps(_mm256_loadu_ps(a + (k + 2) * ld + s), _mm256_loadu_ps(b + (k + 2) * ld + s), s2);
+      s3 = _mm256_fnmadd_ps(_mm256_loadu_ps(a + (k + 3) * ld + s), _mm256_loadu_ps(b + (k + 3) * ld + s), s3);
+    }
+    for (; k < n; ++k) {
+      s0 = _mm256_fnmadd_ps(_mm256_loadu_ps(a + k * ld + s), _mm256_loadu_ps(b + k * ld + s), s0);
+    }
+    _mm256_storeu_ps(y + s, _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+  }
+  sse2::dot_lanes(a + s, b + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("avx2,fma") inline void axpy_lanes(const float *a, const float *x, std::size_t ld, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 8 <= m; s += 8) {
+    __m256 vx = _mm256_loadu_ps(x + s);
+    for (std::size_t k = 0; k < n; ++k) {
+      float *yk = y + k * ld + s;
+      _mm256_storeu_ps(yk, _mm256_fnmadd_ps(_mm256_loadu_ps(a + k * ld + s), vx, _mm256_loadu_ps(yk)));
+    }
+  }
+  sse2::axpy_lanes(a + s, x + s, ld, n, y + s, m - s);
+}
+
+// Two columns at a time, eight accumulators
+SKYLINE_TARGET("avx2,fma") inline void dot4x2(const double *const *v, const double *a0, const double *a1, std::size_t n, double *out)
+{
+  __m256d s[4][2];
+  for (int p = 0; p < 4; ++p) {
+    s[p][0] = _mm256_setzero_pd();
+    s[p][1] = _mm256_setzero_pd();
+  }
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x0 = _mm256_loadu_pd(a0 + i);
+    __m256d x1 = _mm256_loadu_pd(a1 + i);
+    for (int p = 0; p < 4; ++p) {
+      __m256d y = _mm256_loadu_pd(v[p] + i);
+      s[p][0] = _mm256_fmadd_pd(y, x0, s[p][0]);
+      s[p][1] = _mm256_fmadd_pd(y, x1, s[p][1]);
+    }
+  }
+  for (int p = 0; p < 4; ++p) {
+    for (int q = 0; q < 2; ++q) {
+      __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s[p][q]), _mm256_extractf128_pd(s[p][q], 1));
+      out[4 * p + q] = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+    }
+  }
+  for (; i < n; ++i) {
+    for (int p = 0; p < 4; ++p) {
+      out[4 * p] += v[p][i] * a0[i];
+      out[4 * p + 1] += v[p][i] * a1[i];
+    }
+  }
+}
+
+SKYLINE_TARGET("avx2,fma") inline void dot4x2(const float *const *v, const float *a0, const float *a1, std::size_t n, float *out)
+{
+  __m256 s[4][2];
+  for (int p = 0; p < 4; ++p) {
+    s[p][0] = _mm256_setzero_ps();
+    s[p][1] = _mm256_setzero_ps();
+  }
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x0 = _mm256_loadu_ps(a0 + i);
+    __m256 x1 = _mm256_loadu_ps(a1 + i);
+    for (int p = 0; p < 4; ++p) {
+      __m256 y = _mm256_loadu_ps(v[p] + i);
+      s[p][0] = _mm256_fmadd_ps(y, x0, s[p][0]);
+      s[p][1] = _mm256_fmadd_ps(y, x1, s[p][1]);
+    }
+  }
+  for (int p = 0; p < 4; ++p) {
+    for (int q = 0; q < 2; ++q) {
+      __m128 h = _mm_add_ps(_mm256_castps256_ps128(s[p][q]), _mm256_extractf128_ps(s[p][q], 1));
+      h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+      out[4 * p + q] = _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+    }
+  }
+  for (; i < n; ++i) {
+    for (int p = 0; p < 4; ++p) {
+      out[4 * p] += v[p][i] * a0[i];
+      out[4 * p + 1] += v[p][i] * a1[i];
+    }
+  }
+}
+
+template <typename R> void dot4x4(const R *const *v, const R *const *a, std::size_t n, R *out)
+{
+  R half[16];
+  dot4x2(v, a[0], a[1], n, out);
+  dot4x2(v, a[2], a[3], n, half);
+  for (int p = 0; p < 4; ++p) {
+    out[4 * p + 2] = half[4 * p];
+    out[4 * p + 3] = half[4 * p + 1];
+  }
+}
+
+}
+
+namespace avx512 {
+
+// The low and high halves of a vector. These are masked extracts because the plain extract,
+// the casts and _mm512_reduce_add all warn that they use an uninitialized value with some
+// compilers.
+SKYLINE_TARGET("avx512f") inline __m256d half(__m512d s, int high)
+{
+  return high ? _mm512_maskz_extractf64x4_pd(0xf, s, 1) : _mm512_maskz_extractf64x4_pd(0xf, s, 0);
+}
+
+SKYLINE_TARGET("avx512f") inline __m256 half(__m512 s, int high)
+{
+  return _mm256_castpd_ps(half(_mm512_castps_pd(s), high));
+}
+
+// The sum of the lanes of a vector
+SKYLINE_TARGET("avx512f") inline double sum(__m512d s)
+{
+  return avx2::sum(_mm256_add_pd(half(s, 0), half(s, 1)));
+}
+
+SKYLINE_TARGET("avx512f") inline float sum(__m512 s)
+{
+  return avx2::sum(_mm256_add_ps(half(s, 0), half(s, 1)));
+}
+
+SKYLINE_TARGET("avx512f") inline double dot(const double *a, const double *b, std::size_t n)
+{
+  __m512d s0 = _mm512_setzero_pd();
+  __m512d s1 = _mm512_setzero_pd();
+  __m512d s2 = _mm512_setzero_pd();
+  __m512d s3 = _mm512_setzero_pd();
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+    s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), s1);
+    s2 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 16), _mm512_loadu_pd(b + i + 16), s2);
+    s3 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 24), _mm512_loadu_pd(b + i + 24), s3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+  }
+  if (i < n) {
+    __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+    s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + i), _mm512_maskz_loadu_pd(mask, b + i), s1);
+  }
+  return sum(_mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3)));
+}
+
+SKYLINE_TARGET("avx512f") inline float dot(const float *a, const float *b, std::size_t n)
+{
+  __m512 s0 = _mm512_setzero_ps();
+  __m512 s1 = _mm512_setzero_ps();
+  __m512 s2 = _mm512_setzero_ps();
+  __m512 s3 = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+    s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), s1);
+    s2 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32), s2);
+    s3 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48), s3);
+  }
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+  }
+  if (i < n) {
+    __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+    s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), s1);
+  }
+  return sum(_mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+}
+
+SKYLINE_TARGET("avx512f") inline void axpy(double alpha, const double *x, double *y, std::size_t n)
+{
+  __m512d va = _mm512_set1_pd(alpha);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+  }
+  if (i < n) {
+    __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+    _mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i)));
+  }
+}
+
+SKYLINE_TARGET("avx512f") inline void axpy(float alpha, const float *x, float *y, std::size_t n)
+{
+  __m512 va = _mm512_set1_ps(alpha);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+  }
+  if (i < n) {
+    __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+    _mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i)));
+  }
+}
+
+SKYLINE_TARGET("avx512f") inline double dot_axpy(const double *a, const double *x, double alpha, double *y, std::size_t n)
+{
+  __m512d va = _mm512_set1_pd(alpha);
+  __m512d s0 = _mm512_setzero_pd();
+  __m512d s1 = _mm512_setzero_pd();
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512d a0 = _mm512_loadu_pd(a + i);
+    __m512d a1 = _mm512_loadu_pd(a + i + 8);
+    s0 = _mm512_fmadd_pd(a0, _mm512_loadu_pd(x + i), s0);
+    s1 = _mm512_fmadd_pd(a1, _mm512_loadu_pd(x + i + 8), s1);
+    _mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, a0, _mm512_loadu_pd(y + i)));
+    _mm512_storeu_pd(y + i + 8, _mm512_fmadd_pd(va, a1, _mm512_loadu_pd(y + i + 8)));
+  }
+  // The next column updates most of the same entries, so leave the remainder to unmasked stores
+  return sum(_mm512_add_pd(s0, s1)) + avx2::dot_axpy(a + i, x + i, alpha, y + i, n - i);
+}
+
+SKYLINE_TARGET("avx512f") inline float dot_axpy(const float *a, const float *x, float alpha, float *y, std::size_t n)
+{
+  __m512 va = _mm512_set1_ps(alpha);
+  __m512 s0 = _mm512_setzero_ps();
+  __m512 s1 = _mm512_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m512 a0 = _mm512_loadu_ps(a + i);
+    __m512 a1 = _mm512_loadu_ps(a + i + 16);
+    s0 = _mm512_fmadd_ps(a0, _mm512_loadu_ps(x + i), s0);
+    s1 = _mm512_fmadd_ps(a1, _mm512_loadu_ps(x + i + 16), s1);
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, a0, _mm512_loadu_ps(y + i)));
+    _mm512_storeu_ps(y + i + 16, _mm512_fmadd_ps(va, a1, _mm512_loadu_ps(y + i + 16)));
+  }
+  return sum(_mm512_add_ps(s0, s1)) + avx2::dot_axpy(a + i, x + i, alpha, y + i, n - i);
+}
+
+SKYLINE_TARGET("avx512f") inline void dot_rows(const double *a, const double *x, std::size_t ldx, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 32 <= m; r += 32) {
+    __m512d s0 = _mm512_loadu_pd(y + r);
+    __m512d s1 = _mm512_loadu_pd(y + r + 8);
+    __m512d s2 = _mm512_loadu_pd(y + r + 16);
+    __m512d s3 = _mm512_loadu_pd(y + r + 24);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m512d va = _mm512_set1_pd(a[k]);
+      const double *xk = x + k * ldx + r;
+      s0 = _mm512_fnmadd_pd(va, _mm512_loadu_pd(xk), s0);
+      s1 = _mm512_fnmadd_pd(va, _mm512_loadu_pd(xk + 8), s1);
+      s2 = _mm512_fnmadd_pd(va, _mm512_loadu_pd(xk + 16), s2);
+      s3 = _mm512_fnmadd_pd(va, _mm512_loadu_pd(xk + 24), s3);
+    }
+    _mm512_storeu_pd(y + r, s0);
+    _mm512_storeu_pd(y + r + 8, s1);
+    _mm512_storeu_pd(y + r + 16, s2);
+    _mm512_storeu_pd(y + r + 24, s3);
+  }
+  for (; r + 8 <= m; r += 8) {
+    __m512d s0 = _mm512_loadu_pd(y + r);
+    __m512d s1 = _mm512_setzero_pd();
+    __m512d s2 = _mm512_setzero_pd();
+    __m512d s3 = _mm512_setzero_pd();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm512_fnmadd_pd(_mm512_set1_pd(a[k]), _mm512_loadu_pd(x + k * ldx + r), s0);
+      s1 = _mm512_fnmadd_pd(_mm512_set1_pd(a[k + 1]), _mm512_loadu_pd(x + (k + 1) * ldx + r), s1);
+      s2 = _mm512_fnmadd_pd(_mm512_set1_pd(a[k + 2]), _mm512_loadu_pd(x + (k + 2) * ldx + r), s2);
+      s3 = _mm512_fnmadd_pd(_mm512_set1_pd(a[k + 3]), _mm512_loadu_pd(x + (k + 3) * ldx + r), s3);
+    }
+    for (; k < n; ++k) {
+      s0 = _mm512_fnmadd_pd(_mm512_set1_pd(a[k]), _mm512_loadu_pd(x + k * ldx + r), s0);
+    }
+    _mm512_storeu_pd(y + r, _mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3)));
+  }
+  avx2::dot_rows(a, x + r, ldx, n, y + r, m - r);
+}
+
+SKYLINE_TARGET("avx512f") inline void axpy_rows(const double *a, const double *y, std::size_t n, double *x, std::size_t ldx, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 32 <= m; r += 32) {
+    __m512d y0 = _mm512_loadu_pd(y + r);
+    __m512d y1 = _mm512_loadu_pd(y + r + 8);
+    __m512d y2 = _mm512_loadu_pd(y + r + 16);
+    __m512d y3 = _mm512_loadu_pd(y + r + 24);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m512d va = _mm512_set1_pd(a[k]);
+      double *xk = x + k * ldx + r;
+      _mm512_storeu_pd(xk, _mm512_fnmadd_pd(va, y0, _mm512_loadu_pd(xk)));
+      _mm512_storeu_pd(xk + 8, _mm512_fnmadd_pd(va, y1, _mm512_loadu_pd(xk + 8)));
+      _mm512_storeu_pd(xk + 16, _mm512_fnmadd_pd(va, y2, _mm512_loadu_pd(xk + 16)));
+      _mm512_storeu_pd(xk + 24, _mm512_fnmadd_pd(va, y3, _mm512_loadu_pd(xk + 24)));
+    }
+  }
+  for (; r + 8 <= m; r += 8) {
+    __m512d vy = _mm512_loadu_pd(y + r);
+    for (std::size_t k = 0; k < n; ++k) {
+      double *xk = x + k * ldx + r;
+      _mm512_storeu_pd(xk, _mm512_fnmadd_pd(_mm512_set1_pd(a[k]), vy, _mm512_loadu_pd(xk)));
+    }
+  }
+  avx2::axpy_rows(a, y + r, n, x + r, ldx, m - r);
+}
+
+SKYLINE_TARGET("avx512f") inline void dot_rows(const float *a, const float *x, std::size_t ldx, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 64 <= m; r += 64) {
+    __m512 s0 = _mm512_loadu_ps(y + r);
+    __m512 s1 = _mm512_loadu_ps(y + r + 16);
+    __m512 s2 = _mm512_loadu_ps(y + r + 32);
+    __m512 s3 = _mm512_loadu_ps(y + r + 48);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m512 va = _mm512_set1_ps(a[k]);
+      const float *xk = x + k * ldx + r;
+      s0 = _mm512_fnmadd_ps(va, _mm512_loadu_ps(xk), s0);
+      s1 = _mm512_fnmadd_ps(va, _mm512_loadu_ps(xk + 16), s1);
+      s2 = _mm512_fnmadd_ps(va, _mm512_loadu_ps(xk + 32), s2);
+      s3 = _mm512_fnmadd_ps(va, _mm512_loadu_ps(xk + 48), s3);
+    }
+    _mm512_storeu_ps(y + r, s0);
+    _mm512_storeu_ps(y + r + 16, s1);
+    _mm512_storeu_ps(y + r + 32, s2);
+    _mm512_storeu_ps(y + r + 48, s3);
+  }
+  for (; r + 16 <= m; r += 16) {
+    __m512 s0 = _mm512_loadu_ps(y + r);
+    __m512 s1 = _mm512_setzero_ps();
+    __m512 s2 = _mm512_setzero_ps();
+    __m512 s3 = _mm512_setzero_ps();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm512_fnmadd_ps(_mm512_set1_ps(a[k]), _mm512_loadu_ps(x + k * ldx + r), s0);
+      s1 = _mm512_fnmadd_ps(_mm512_set1_ps(a[k + 1]), _mm512_loadu_ps(x + (k + 1) * ldx + r), s1);
+      s2 = _mm512_fnmadd_ps(_mm512_set1_ps(a[k + 2]), _mm512_loadu_ps(x + (k + 2) * ldx + r), s2);
+      s3 = _mm512_fnmadd_ps(_mm512_set1_ps(a[k + 3]), _mm512_loadu_ps(x + (k + 3) * ldx + r), s3);
+    }
+    for (; k < n; ++k) {
+      s0 = _mm512_fnmadd_ps(_mm512_set1_ps(a[k]), _mm512_loadu_ps(x + k * ldx + r), s0);
+    }
+    _mm512_storeu_ps(y + r, _mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+  }
+  avx2::dot_rows(a, x + r, ldx, n, y + r, m - r);
+}
+
+SKYLINE_TARGET("avx512f") inline void axpy_rows(const float *a, const float *y, std::size_t n, float *x, std::size_t ldx, std::size_t m)
+{
+  std::size_t r = 0;
+  for (; r + 64 <= m; r += 64) {
+    __m512 y0 = _mm512_loadu_ps(y + r);
+    __m512 y1 = _mm512_loadu_ps(y + r + 16);
+    __m512 y2 = _mm512_loadu_ps(y + r + 32);
+    __m512 y3 = _mm512_loadu_ps(y + r + 48);
+    for (std::size_t k = 0; k < n; ++k) {
+      __m512 va = _mm512_set1_ps(a[k]);
+      float *xk = x + k * ldx + r;
+      _mm512_storeu_ps(xk, _mm512_fnmadd_ps(va, y0, _mm512_loadu_ps(xk)));
+      _mm512_storeu_ps(xk + 16, _mm512_fnmadd_ps(va, y1, _mm512_loadu_ps(xk + 16)));
+      _mm512_storeu_ps(xk + 32, _mm512_fnmadd_ps(va, y2, _mm512_loadu_ps(xk + 32)));
+      _mm512_storeu_ps(xk + 48, _mm512_fnmadd_ps(va, y3, _mm512_loadu_ps(xk + 48)));
+    }
+  }
+  for (; r + 16 <= m; r += 16) {
+    __m512 vy = _mm512_loadu_ps(y + r);
+    for (std::size_t k = 0; k < n; ++k) {
+      float *xk = x + k * ldx + r;
+      _mm512_storeu_ps(xk, _mm512_fnmadd_ps(_mm512_set1_ps(a[k]), vy, _mm512_loadu_ps(xk)));
+    }
+  }
+  avx2::axpy_rows(a, y + r, n, x + r, ldx, m - r);
+}
+
+SKYLINE_TARGET("avx512f") inline void dot_lanes(const double *a, const double *b, std::size_t ld, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 8 <= m; s += 8) {
+    __m512d s0 = _mm512_loadu_pd(y + s);
+    __m512d s1 = _mm512_setzero_pd();
+    __m512d s2 = _mm512_setzero_pd();
+    __m512d s3 = _mm512_setzero_pd();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm512_fnmadd_pd(_mm512_loadu_pd(a + k * ld + s), _mm512_loadu_pd(b + k * ld + s), s0);
+      s1 = _mm512_fnmadd_pd(_mm512_loadu_pd(a + (k + 1) * ld + s), _mm512_loadu_pd(b + (k + 1) * ld + s), s1);
+      s2 = _mm512_fnmadd_pd(_mm512_loadu_pd(a + (k + 2) * ld + s), _mm512_loadu_pd(b + (k + 2) * ld + s), s2);
+      s3 = _mm512_fnmadd_pd(_mm512_loadu_pd(a + (k + 3) * ld + s), _mm512_loadu_pd(b + (k + 3) * ld + s), s3);
+    }
+    for (; k < n; ++k) {
+      s0 = _mm512_fnmadd_pd(_mm512_loadu_pd(a + k * ld + s), _mm512_loadu_pd(b + k * ld + s), s0);
+    }
+    _mm512_storeu_pd(y + s, _mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3)));
+  }
+  avx2::dot_lanes(a + s, b + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("avx512f") inline void axpy_lanes(const double *a, const double *x, std::size_t ld, std::size_t n, double *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 8 <= m; s += 8) {
+    __m512d vx = _mm512_loadu_pd(x + s);
+    for (std::size_t k = 0; k < n; ++k) {
+      double *yk = y + k * ld + s;
+      _mm512_storeu_pd(yk, _mm512_fnmadd_pd(_mm512_loadu_pd(a + k * ld + s), vx, _mm512_loadu_pd(yk)));
+    }
+  }
+  avx2::axpy_lanes(a + s, x + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("avx512f") inline void dot_lanes(const float *a, const float *b, std::size_t ld, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 16 <= m; s += 16) {
+    __m512 s0 = _mm512_loadu_ps(y + s);
+    __m512 s1 = _mm512_setzero_ps();
+    __m512 s2 = _mm512_setzero_ps();
+    __m512 s3 = _mm512_setzero_ps();
+    std::size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+      s0 = _mm512_fnmadd_ps(_mm512_loadu_ps(a + k * ld + s), _mm512_loadu_ps(b + k * ld + s), s0);
+      s1 = _mm512_fnmadd_ps(_mm512_loadu_ps(a + (k + 1) * ld + s), _mm512_loadu_ps(b + (k + 1) * ld + s), s1);
+      s2 = _mm512_fnmadd_ps(_mm512_loadu_ps(a + (k + 2) * ld + s), _mm512_loadu_ps(b + (k + 2) * ld + s), s2);
+      s3 = _mm512_fnmadd_ps(_mm512_loadu_ps(a + (k + 3) * ld + s), _mm512_loadu_ps(b + (k + 3) * ld + s), s3);
+    }
+    for (; k < n; ++k) {
+      s0 = _mm512_fnmadd_ps(_mm512_loadu_ps(a + k * ld + s), _mm512_loadu_ps(b + k * ld + s), s0);
+    }
+    _mm512_storeu_ps(y + s, _mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+  }
+  avx2::dot_lanes(a + s, b + s, ld, n, y + s, m - s);
+}
+
+SKYLINE_TARGET("avx512f") inline void axpy_lanes(const float *a, const float *x, std::size_t ld, std::size_t n, float *y, std::size_t m)
+{
+  std::size_t s = 0;
+  for (; s + 16 <= m; s += 16) {
+    __m512 vx = _mm512_loadu_ps(x + s);
+    for (std::size_t k = 0; k < n; ++k) {
+      float *yk = y + k * ld + s;
+      _mm512_storeu_ps(yk, _mm512_fnmadd_ps(_mm512_loadu_ps(a + k * ld + s), vx, _mm512_loadu_ps(yk)));
+    }
+  }
+  avx2::axpy_lanes(a + s, x + s, ld, n, y + s, m - s);
+}
+
+// All sixteen accumulators fit in registers
+SKYLINE_TARGET("avx512f") inline void dot4x4(const double *const *v, const double *const *a, std::size_t n, double *out)
+{
+  __m512d s[4][4];
+  for (int p = 0; p < 4; ++p) {
+    for (int q = 0; q < 4; ++q) {
+      s[p][q] = _mm512_setzero_pd();
+    }
+  }
+  std::size_t i = 0;
+  for (; i < n; i += 8) {
+    __mmask8 mask = n - i >= 8 ? (__mmask8)0xff : (__mmask8)((1u << (n - i)) - 1);
+    __m512d x[4];
+    for (int q = 0; q < 4; ++q) {
+      x[q] = _mm512_maskz_loadu_pd(mask, a[q] + i);
+    }
+    for (int p = 0; p < 4; ++p) {
+      __m512d y = _mm512_maskz_loadu_pd(mask, v[p] + i);
+      for (int q = 0; q < 4; ++q) {
+        s[p][q] = _mm512_fmadd_pd(y, x[q], s[p][q]);
+      }
+    }
+  }
+  // Reduce the four accumulators of each row together
+  for (int p = 0; p < 4; ++p) {
+    __m256d t[4];
+    for (int q = 0; q < 4; ++q) {
+      t[q] = _mm256_add_pd(half(s[p][q], 0), half(s[p][q], 1));
+    }
+    __m256d h01 = _mm256_hadd_pd(t[0], t[1]);
+    __m256d h23 = _mm256_hadd_pd(t[2], t[3]);
+    __m256d r = _mm256_add_pd(_mm256_permute2f128_pd(h01, h23, 0x21), _mm256_blend_pd(h01, h23, 0xc));
+    _mm256_storeu_pd(out + 4 * p, r);
+  }
+}
+
+SKYLINE_TARGET("avx512f") inline void dot4x4(const float *const *v, const float *const *a, std::size_t n, float *out)
+{
+  __m512 s[4][4];
+  for (int p = 0; p < 4; ++p) {
+    for (int q = 0; q < 4; ++q) {
+      s[p][q] = _mm512_setzero_ps();
+    }
+  }
+  std::size_t i = 0;
+  for (; i < n; i += 16) {
+    __mmask16 mask = n - i >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (n - i)) - 1);
+    __m512 x[4];
+    for (int q = 0; q < 4; ++q) {
+      x[q] = _mm512_maskz_loadu_ps(mask, a[q] + i);
+    }
+    for (int p = 0; p < 4; ++p) {
+      __m512 y = _mm512_maskz_loadu_ps(mask, v[p] + i);
+      for (int q = 0; q < 4; ++q) {
+        s[p][q] = _mm512_fmadd_ps(y, x[q], s[p][q]);
+      }
+    }
+  }
+  // Reduce the four accumulators of each row together
+  for (int p = 0; p < 4; ++p) {
+    __m256 t[4];
+    for (int q = 0; q < 4; ++q) {
+      t[q] = _mm256_add_ps(half(s[p][q], 0), half(s[p][q], 1));
+    }
+    __m256 h = _mm256_hadd_ps(_mm256_hadd_ps(t[0], t[1]), _mm256_hadd_ps(t[2], t[3]));
+    _mm_storeu_ps(out + 4 * p, _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1)));
+  }
+}
+
+}
+
+#endif
+
+// Dot product of two contiguous segments
+template <typename R> R dot(const R *a, const R *b, std::size_t n)
+{
+#ifdef SKYLINE_X86
+  if constexpr (std::is_same_v<R, double> || std::is_same_v<R, float>) {
+    if (n >= minimum_length) {
+      switch (isa()) {
+      case Isa::AVX512:
+        return avx512::dot(a, b, n);
+      case Isa::AVX2:
+        return avx2::dot(a, b, n);
+      case Isa::SSE2:
+        return sse2::dot(a, b, n);
+      default:
+        break;
+      }
+    }
+  }
+#endif
+  return scalar::dot(a, b, n);
+}
+
+// Sixteen dot products out[4*p + q] = v[p].a[q] of segments with a common length, the
+// register blocked update used by the panel factorization
+template <typename R> void dot4x4(const R *const *v, const R *const *a, std::size_t n, R *out)
+{
+#ifdef SKYLINE_X86
+  if constexpr (std::is_same_v<R, double> || std::is_same_v<R, float>) {
+    if (n >= minimum_length) {
+      switch (isa()) {
+      case Isa::AVX512:
+        avx512::dot4x4(v, a, n, out);
+        return;
+      case Isa::AVX2:
+        avx2::dot4x4(v, a, n, out);
+        return;
+      case Isa::SSE2:
+        sse2::dot4x4(v, a, n, out);
+        return;
+      default:
+        break;
+      }
+    }
+  }
+#endif
+  scalar::dot4x4(v, a, n, out);
+}
+
+// y += alpha*x for contiguous segments
+template <typename R> void axpy(R alpha, const R *x, R *y, std::size_t n)
+{
+#ifdef SKYLINE_X86
+  if constexpr (std::is_same_v<R, double> || std::is_same_v<R, float>) {
+    if (n >= minimum_length) {
+      switch (isa()) {
+      case Isa::AVX512:
+        avx512::axpy(alpha, x, y, n);
+        return;
+      case Isa::AVX2:
+        avx2::axpy(alpha, x, y, n);
+        return;
+      case Isa::SSE2:
+        sse2::axpy(alpha, x, y, n);
+        return;
+      default:
+        break;
+      }
+    }
+  }
+#endif
+  scalar::axpy(alpha, x, y, n);
+}
+
+// Returns a.x and adds alpha*a to y in the same pass over a, the two halves of a column of
+// a symmetric product
+template <typename R> R dot_axpy(const R *a, const R *x, R alpha, R *y, std::size_t n)
+{
+#ifdef SKYLINE_X86
+  if constexpr (std::is_same_v<R, double> || std::is_same_v<R, float>) {
+    if (n >= minimum_length) {
+      switch (isa()) {
+      case Isa::AVX512:
+        return avx512::dot_axpy(a, x, alpha, y, n);
+      case Isa::AVX2:
+        return avx2::dot_axpy(a, x, alpha, y, n);
+      case Isa::SSE2:
+        return sse2::dot_axpy(a, x, alpha, y, n);
+      default:
+        break;
+      }
+    }
+  }
+#endif
+  return scalar::dot_axpy(a, x, alpha, y, n);
+}
+
+// y[r] -= sum_k a[k]*x[k*ldx + r] for r < m, the dot products of a segment with each column
+// of a row major block, used to apply a row of the factor to several right hand sides
+template <typename R> void dot_rows(const R *a, const R *x, std::size_t ldx, std::size_t n, R *y, std::size_t m)
+{
+#ifdef SKYLINE_X86
+  if constexpr (std::is_same_v<R, double> || std::is_same_v<R, float>) {
+    switch (isa()) {
+    case Isa::AVX512:
+      avx512::dot_rows(a, x, ldx, n, y, m);
+      return;
+    case Isa::AVX2:
+      avx2::dot_rows(a, x, ldx, n, y, m);
+      return;
+    case Isa::SSE2:
+      sse2::dot_rows(a, x, ldx, n, y, m);
+      return;
+    default:
+      break;
+    }
+  }
+#endif
+  scalar::dot_rows(a, x, ldx, n, y, m);
+}
+
+// x[k*ldx + r] -= a[k]*y[r] for k < n and r < m, the rank one update of a row major block
+template <typename R> void axpy_rows(const R *a, const R *y, std::size_t n, R *x, std::size_t ldx, std::size_t m)
+{
+#ifdef SKYLINE_X86
+  if constexpr (std::is_same_v<R, double> || std::is_same_v<R, float>) {
+    switch (isa()) {
+    case Isa::AVX512:
+      avx512::axpy_rows(a, y, n, x, ldx, m);
+      return;
+    case Isa::AVX2:
+      avx2::axpy_rows(a, y, n, x, ldx, m);
+      return;
+    case Isa::SSE2:
+      sse2::axpy_rows(a, y, n, x, ldx, m);
+      return;
+    default:
+      break;
+    }
+  }
+#endif
+  scalar::axpy_rows(a, y, n, x, ldx, m);
+}
+
+// y[s] -= sum_k a[k*ld + s]*b[k*ld + s] for s < m, m dot products at once of segments that
+// are interleaved with a stride of ld, used to factor a batch of matrices in lockstep
+template <typename R> void dot_lanes(const R *a, const R *b, std::size_t ld, std::size_t n, R *y, std::size_t m)
+{
+#ifdef SKYLINE_X86
+  if constexpr (std::is_same_v<R, double> || std::is_same_v<R, float>) {
+    switch (isa()) {
+    case Isa::AVX512:
+      avx512::dot_lanes(a, b, ld, n, y, m);
+      return;
+    case Isa::AVX2:
+      avx2::dot_lanes(a, b, ld, n, y, m);
+      return;
+    case Isa::SSE2:
+      sse2::dot_lanes(a, b, ld, n, y, m);
+      return;
+    default:
+      break;
+    }
+  }
+#endif
+  scalar::dot_lanes(a, b, ld, n, y, m);
+}
+
+// y[k*ld + s] -= a[k*ld + s]*x[s] for k < n and s < m, the interleaved version of axpy
+template <typename R> void axpy_lanes(const R *a, const R *x, std::size_t ld, std::size_t n, R *y, std::size_t m)
+{
+#ifdef SKYLINE_X86
+  if constexpr (std::is_same_v<R, double> || std::is_same_v<R, float>) {
+    switch (isa()) {
+    case Isa::AVX512:
+      avx512::axpy_lanes(a, x, ld, n, y, m);
+      return;
+    case Isa::AVX2:
+      avx2::axpy_lanes(a, x, ld, n, y, m);
+      return;
+    case Isa::SSE2:
+      sse2::axpy_lanes(a, x, ld, n, y, m);
+      return;
+    default:
+      break;
+    }
+  }
+#endif
+  scalar::axpy_lanes(a, x, ld, n, y, m);
+}
+}
+}
+
+#endif // !KERNELS_HPP
@@ -0,0 +1,340 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef MAPPED_HPP
+#define MAPPED_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include "skyline.hpp"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A binary file format for skyline matrices, meant for factors that are written once and then
+// solved with by many processes. The file is a header followed by the offsets to the top of
+// each skyline, the top row of each skyline, the diagonal and the upper triangle, each section
+// starting on a 64 byte boundary. The reader maps the file and solves straight from the mapped
+// pages. Only the offsets and tops are read when the file is opened, to check that every
+// column fits, and nothing is copied.
+
+namespace skyline {
+
+struct MappedHeader
+{
+  char magic[8];           // "SKYLINE" and a zero
+  std::uint32_t version;   // MappedHeader::current
+  std::uint32_t order;     // 0x01020304 in the byte order of the writer
+  std::uint32_t index;     // Size of the index type in bytes
+  std::uint32_t real;      // Size of the value type in bytes
+  std::uint32_t layout;    // 0 if the writer stored the matrix in one array, 1 if in two
+  std::uint32_t factored;  // 1 if the values are the factors
+  std::uint64_t n;         // System size
+  std::uint64_t profile;   // Size of the upper triangle
+  std::uint64_t ik;        // Byte offsets of the sections
+  std::uint64_t im;
+  std::uint64_t diagonal;
+  std::uint64_t upper;
+
+  static constexpr std::uint32_t current = 1;
+  static constexpr std::uint64_t alignment = 64;
+};
+
+template <typename I, typename R, template <typename ...> typename V> class MappedSymmetricMatrix
+{
+public:
+
+  MappedSymmetricMatrix() = default;
+
+  explicit MappedSymmetricMatrix(const std::string &path)
+  {
+    open(path);
+  }
+
+  MappedSymmetricMatrix(const MappedSymmetricMatrix &) = delete;
+  MappedSymmetricMatrix &operator=(const MappedSymmetricMatrix &) = delete;
+
+  ~MappedSymmetricMatrix()
+  {
+    close();
+  }
+
+  // Write a matrix, factored or not, returning false if the file could not be written. The
+  // sections are the same whatever the layout of the matrix.
+  static bool write(const SymmetricMatrix<I, R, V> &matrix, const std::string &path)
+  {
+    MappedHeader header{};
+    std::memcpy(header.magic, "SKYLINE", 8);
+    header.version = MappedHeader::current;
+    header.order = 0x01020304;
+    header.index = sizeof(I);
+    header.real = sizeof(R);
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    header.layout = 0;
+#else
+    header.layout = 1;
+#endif
+    header.factored = matrix.m_factored ? 1 : 0;
+    header.n = matrix.m_n;
+    header.profile = matrix.m_structure->profile();
+    header.ik = align(sizeof(MappedHeader));
+    header.im = align(header.ik + header.n * sizeof(I));
+    header.diagonal = align(header.im + header.n * sizeof(I));
+    header.upper = align(header.diagonal + header.n * sizeof(R));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    auto section = [&](std::uint64_t offset, const void *data, std::uint64_t bytes) {
+      static const char zeros[MappedHeader::alignment]{};
+      file.write(zeros, offset - (std::uint64_t)file.tellp());
+      file.write(static_cast<const char *>(data), bytes);
+    };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    V<I> ik = matrix.offsets();
+    V<I> im = matrix.minima();
+    section(header.ik, ik.data(), header.n * sizeof(I));
+    section(header.im, im.data(), header.n * sizeof(I));
+    section(header.diagonal, matrix.diagonal_data(), header.n * sizeof(R));
+    section(header.upper, matrix.upper_data(), header.profile * sizeof(R));
+    return (bool)file;
+  }
+
+  // Map a file, returning false if it can't be, was written with different types or has sections
+  // that don't fit together or in the file. Whatever was mapped before is unmapped.
+  bool open(const std::string &path)
+  {
+    close();
+    if (!map(path)) {
+      return false;
+    }
+    MappedHeader header;
+    if (m_size < sizeof(header)) {
+      close();
+      return false;
+    }
+    std::memcpy(&header, m_data, sizeof(header));
+    if (std::memcmp(header.magic, "SKYLINE", 8) != 0 || header.version != MappedHeader::current
+      || header.order != 0x01020304 || header.index != sizeof(I) || header.real != sizeof(R)
+      || header.n > (std::uint64_t)std::numeric_limits<I>::max() || !sections(header)) {
+      close();
+      return false;
+    }
+    m_n = header.n;
+    m_factored = header.factored == 1;
+    m_layout = header.layout;
+    m_ik = reinterpret_cast<const I *>(m_data + header.ik);
+    m_im = reinterpret_cast<const I *>(m_data + header.im);
+    m_ad = reinterpret_cast<const R *>(m_data + header.diagonal);
+    m_au = reinterpret_cast<const R *>(m_data + header.upper);
+    if (!columns(header.profile)) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+    if (m_data) {
+#ifdef _WIN32
+      UnmapViewOfFile(m_data);
+      CloseHandle(m_mapping);
+      CloseHandle(m_file);
+#else
+      munmap(const_cast<char *>(m_data), m_size);
+#endif
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_n = 0;
+    m_factored = false;
+  }
+
+  bool is_open() const
+  {
+    return m_data != nullptr;
+  }
+
+  // True if the file holds the factors, which the substitutions need
+  bool factored() const
+  {
+    return m_factored;
+  }
+
+  // True if the writer stored the diagonal and the upper triangle in separate arrays
+  bool multiple_array() const
+  {
+    return m_layout == 1;
+  }
+
+  void forward_substitution(V<R> &b) const
+  {
+    for (I i = 1; i < m_n; ++i) {
+      b[i] -= kernels::dot(m_au + m_ik[i], b.data() + m_im[i], i - m_im[i]);
+    }
+  }
+
+  void back_substitution(V<R> &z) const
+  {
+    for (I j = 0; j < m_n; ++j) {
+      z[j] /= m_ad[j];
+    }
+    for (I j = m_n - 1; j > 0; --j) {
+      kernels::axpy(-z[j], m_au + m_ik[j], z.data() + m_im[j], j - m_im[j]);
+    }
+  }
+
+  // Solve with the mapped factors, b is replaced by the solution. Returns false, leaving b
+  // alone, if nothing is mapped or the file does not hold factors.
+  bool solve(V<R> &b) const
+  {
+    if (!m_data || !m_factored) {
+      return false;
+    }
+    forward_substitution(b);
+    back_substitution(b);
+    return true;
+  }
+
+  I rows() const
+  {
+    return m_n;
+  }
+
+  I cols() const
+  {
+    return m_n;
+  }
+
+private:
+
+  static std::uint64_t align(std::uint64_t offset)
+  {
+    return (offset + MappedHeader::alignment - 1) / MappedHeader::alignment * MappedHeader::alignment;
+  }
+
+  // Whether the sections are aligned for their types, in order without overlapping, and inside
+  // the file
+  bool sections(const MappedHeader &header) const
+  {
+    auto fits = [](std::uint64_t offset, std::uint64_t count, std::uint64_t size, std::uint64_t end) {
+      return offset % size == 0 && offset <= end && count <= (end - offset) / size;
+    };
+    return header.ik >= sizeof(MappedHeader) && fits(header.ik, header.n, sizeof(I), header.im)
+      && fits(header.im, header.n, sizeof(I), header.diagonal) && fits(header.diagonal, header.n, sizeof(R), header.upper)
+      && fits(header.upper, header.profile, sizeof(R), m_size);
+  }
+
+  // Whether every column starts where the one before it ends and has its top on or above the
+  // diagonal, and the last column ends where the upper triangle does
+  bool columns(std::uint64_t profile) const
+  {
+    std::uint64_t end = 0;
+    for (I k = 0; k < m_n; ++k) {
+      if (m_im[k] > k || m_ik[k] != end) {
+        return false;
+      }
+      end += k - m_im[k];
+    }
+    return end == profile;
+  }
+
+  bool map(const std::string &path)
+  {
+#ifdef _WIN32
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+      nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+      CloseHandle(m_file);
+      return false;
+    }
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+      CloseHandle(m_file);
+      return false;
+    }
+    m_data = static_cast<const char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+      CloseHandle(m_mapping);
+      CloseHandle(m_file);
+      return false;
+    }
+    m_size = size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      return false;
+    }
+    m_data = static_cast<const char *>(data);
+    m_size = info.st_size;
+#endif
+    return true;
+  }
+
+  const char *m_data{ nullptr }; // The mapped file
+  std::uint64_t m_size{ 0 };     // Size of the mapped file in bytes
+#ifdef _WIN32
+  HANDLE m_file{ INVALID_HANDLE_VALUE };
+  HANDLE m_mapping{ nullptr };
+#endif
+  I m_n{ 0 };                    // System size
+  bool m_factored{ false };      // The values are the factors
+  std::uint32_t m_layout{ 0 };   // Layout of the writer
+  const I *m_ik{ nullptr };      // Index offsets to top of skylines, in the mapping
+  const I *m_im{ nullptr };      // Minimum row, or top of skyline, in the mapping
+  const R *m_ad{ nullptr };      // Diagonal, in the mapping
+  const R *m_au{ nullptr };      // Upper triangle, in the mapping
+};
+
+}
+
+#endif
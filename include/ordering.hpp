@@ -0,0 +1,646 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef ORDERING_HPP
+#define ORDERING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <queue>
+#include <utility>
+
+// Profile reducing orderings. The skyline storage and the work of the factorization both grow
+// with the profile, which depends very much on how the unknowns are numbered. These work on
+// the graph of the matrix and give a permutation, permutation[new] = old.
+
+namespace skyline {
+
+enum class Ordering { Natural, RCM, Sloan, GPS, Best };
+
+// An ordering of a graph and what it gives
+template <typename I, template <typename ...> typename V> struct OrderingResult
+{
+  Ordering ordering;  // Which ordering, never Best
+  V<I> permutation;   // permutation[new] = old
+  I profile;          // Profile of the skyline in the new numbering
+  double seconds;     // Time it took to find the permutation
+};
+
+template <typename I, template <typename ...> typename V> class Graph
+{
+public:
+
+  // The graph with the given neighbors of each vertex. Self loops and repeats are dropped, and
+  // the neighbor lists are made symmetric if they are not already.
+  Graph(const V<V<I>> &adjacency) : m_n(adjacency.size())
+  {
+    m_xadj.resize(m_n + 1);
+    for (I i = 0; i <= m_n; ++i) {
+      m_xadj[i] = 0;
+    }
+    for (I i = 0; i < m_n; ++i) {
+      for (I j : adjacency[i]) {
+        if (j != i) {
+          ++m_xadj[i + 1];
+          ++m_xadj[j + 1];
+        }
+      }
+    }
+    for (I i = 0; i < m_n; ++i) {
+      m_xadj[i + 1] += m_xadj[i];
+    }
+    m_adj.resize(m_xadj[m_n]);
+    V<I> next(m_xadj.begin(), m_xadj.end() - 1);
+    for (I i = 0; i < m_n; ++i) {
+      for (I j : adjacency[i]) {
+        if (j != i) {
+          m_adj[next[i]++] = j;
+          m_adj[next[j]++] = i;
+        }
+      }
+    }
+    // Sort and drop the repeats, compacting as we go
+    I count = 0;
+    for (I i = 0; i < m_n; ++i) {
+      auto begin = m_adj.begin() + m_xadj[i];
+      auto end = m_adj.begin() + m_xadj[i + 1];
+      std::sort(begin, end);
+      end = std::unique(begin, end);
+      m_xadj[i] = count;
+      count = std::copy(begin, end, m_adj.begin() + count) - m_adj.begin();
+    }
+    m_xadj[m_n] = count;
+    m_adj.resize(count);
+  }
+
+  // The graph of the nonzeros of a dense symmetric matrix
+  template <typename R> static Graph dense(const V<V<R>> &M)
+  {
+    V<V<I>> adjacency(M.size());
+    for (I i = 0; i < M.size(); ++i) {
+      for (I j = 0; j < i; ++j) {
+        if (M[i][j] != 0.0) {
+          adjacency[i].push_back(j);
+        }
+      }
+    }
+    return Graph(adjacency);
+  }
+
+  I size() const
+  {
+    return m_n;
+  }
+
+  I degree(I i) const
+  {
+    return m_xadj[i + 1] - m_xadj[i];
+  }
+
+  V<I> neighbors(I i) const
+  {
+    return V<I>(m_adj.begin() + m_xadj[i], m_adj.begin() + m_xadj[i + 1]);
+  }
+
+  // The skyline heights when the vertices are numbered by the permutation
+  V<I> heights(const V<I> &permutation) const
+  {
+    V<I> inverse = invert(permutation);
+    V<I> heights(m_n);
+    for (I k = 0; k < m_n; ++k) {
+      I top = k;
+      I i = permutation[k];
+      for (I r = m_xadj[i]; r < m_xadj[i + 1]; ++r) {
+        top = std::min(top, inverse[m_adj[r]]);
+      }
+      heights[k] = k - top;
+    }
+    return heights;
+  }
+
+  // The skyline heights in the natural ordering
+  V<I> heights() const
+  {
+    return heights(identity());
+  }
+
+  // The size of the upper triangle of the skyline when the vertices are numbered by the permutation
+  I profile(const V<I> &permutation) const
+  {
+    V<I> h = heights(permutation);
+    return std::accumulate(h.begin(), h.end(), (I)0);
+  }
+
+  I profile() const
+  {
+    return profile(identity());
+  }
+
+  V<I> order(Ordering ordering) const
+  {
+    switch (ordering) {
+    case Ordering::RCM:
+      return rcm();
+    case Ordering::Sloan:
+      return sloan();
+    case Ordering::GPS:
+      return gps();
+    case Ordering::Best:
+      return best().permutation;
+    default:
+      return identity();
+    }
+  }
+
+  // Compute an ordering and see what it gives
+  OrderingResult<I, V> evaluate(Ordering ordering) const
+  {
+    if (ordering == Ordering::Best) {
+      return best();
+    }
+    auto start = std::chrono::steady_clock::now();
+    V<I> permutation = order(ordering);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    I p = profile(permutation);
+    return { ordering, std::move(permutation), p, elapsed.count() };
+  }
+
+  // Every ordering and what it gives, the natural one first
+  V<OrderingResult<I, V>> compare() const
+  {
+    V<OrderingResult<I, V>> results;
+    for (Ordering ordering : { Ordering::Natural, Ordering::RCM, Ordering::Sloan, Ordering::GPS }) {
+      results.push_back(evaluate(ordering));
+    }
+    return results;
+  }
+
+  // The ordering with the smallest profile. The time is that of all the orderings tried.
+  OrderingResult<I, V> best() const
+  {
+    auto results = compare();
+    double seconds = 0.0;
+    I b = 0;
+    for (I i = 0; i < results.size(); ++i) {
+      seconds += results[i].seconds;
+      if (results[i].profile < results[b].profile) {
+        b = i;
+      }
+    }
+    results[b].seconds = seconds;
+    return results[b];
+  }
+
+  // Reverse Cuthill-McKee. Each connected component is numbered breadth first from a pseudo
+  // peripheral vertex, visiting the neighbors of each vertex in order of increasing degree, and
+  // the whole numbering is then reversed.
+  V<I> rcm() const
+  {
+    V<I> permutation;
+    permutation.reserve(m_n);
+    V<I> numbered(m_n);
+    for (I i = 0; i < m_n; ++i) {
+      numbered[i] = 0;
+    }
+    V<I> neighbors;
+    Marks marks(m_n);
+    for (I s = 0; s < m_n; ++s) {
+      if (numbered[s]) {
+        continue;
+      }
+      I first = permutation.size();
+      permutation.push_back(peripheral(s, marks));
+      numbered[permutation.back()] = 1;
+      for (I q = first; q < permutation.size(); ++q) {
+        I i = permutation[q];
+        neighbors.clear();
+        for (I r = m_xadj[i]; r < m_xadj[i + 1]; ++r) {
+          if (!numbered[m_adj[r]]) {
+            neighbors.push_back(m_adj[r]);
+            numbered[m_adj[r]] = 1;
+          }
+        }
+        std::stable_sort(neighbors.begin(), neighbors.end(), [this](I a, I b) { return degree(a) < degree(b); });
+        permutation.insert(permutation.end(), neighbors.begin(), neighbors.end());
+      }
+    }
+    std::reverse(permutation.begin(), permutation.end());
+    return permutation;
+  }
+
+  // Sloan's ordering. Each component is numbered from one end of a pseudo diameter toward the
+  // other, at each step picking the vertex with the highest priority, which favors vertices far
+  // from the end and vertices that add the fewest new vertices to the front.
+  V<I> sloan() const
+  {
+    enum Status { Inactive, Preactive, Active, Postactive };
+    const long long w1 = 2; // Weight of the distance from the end
+    const long long w2 = 1; // Weight of the growth of the front
+    V<I> permutation;
+    permutation.reserve(m_n);
+    V<int> status(m_n);
+    V<long long> priority(m_n);
+    for (I i = 0; i < m_n; ++i) {
+      status[i] = Inactive;
+    }
+    Marks marks(m_n);
+    V<I> vertices, offsets;
+    std::priority_queue<std::pair<long long, I>> queue;
+    for (I s0 = 0; s0 < m_n; ++s0) {
+      if (status[s0] != Inactive) {
+        continue;
+      }
+      I s, e;
+      diameter(s0, marks, s, e);
+      // Initial priorities from the distance to the end
+      levels(e, vertices, offsets, marks);
+      for (I l = 0; l + 1 < offsets.size(); ++l) {
+        for (I q = offsets[l]; q < offsets[l + 1]; ++q) {
+          I i = vertices[q];
+          priority[i] = w1 * (long long)l - w2 * (long long)(degree(i) + 1);
+        }
+      }
+      auto raise = [&](I i) {
+        priority[i] += w2;
+        if (status[i] == Preactive || status[i] == Active) {
+          queue.emplace(priority[i], i);
+        }
+      };
+      status[s] = Preactive;
+      queue.emplace(priority[s], s);
+      while (!queue.empty()) {
+        auto top = queue.top();
+        queue.pop();
+        I i = top.second;
+        // Skip entries left behind by priority changes
+        if (status[i] == Postactive || top.first != priority[i]) {
+          continue;
+        }
+        if (status[i] == Preactive) {
+          for (I r = m_xadj[i]; r < m_xadj[i + 1]; ++r) {
+            I j = m_adj[r];
+            if (status[j] == Inactive) {
+              status[j] = Preactive;
+            }
+            if (status[j] != Postactive) {
+              raise(j);
+            }
+          }
+        }
+        status[i] = Postactive;
+        permutation.push_back(i);
+        for (I r = m_xadj[i]; r < m_xadj[i + 1]; ++r) {
+          I j = m_adj[r];
+          if (status[j] != Preactive) {
+            continue;
+          }
+          status[j] = Active;
+          raise(j);
+          for (I t = m_xadj[j]; t < m_xadj[j + 1]; ++t) {
+            I k = m_adj[t];
+            if (status[k] == Inactive) {
+              status[k] = Preactive;
+            }
+            if (status[k] != Postactive) {
+              raise(k);
+            }
+          }
+        }
+      }
+    }
+    return permutation;
+  }
+
+  // The Gibbs-Poole-Stockmeyer ordering. The level structures from the two ends of a pseudo
+  // diameter are combined into one that is as narrow as possible, which is numbered level by
+  // level much like Cuthill-McKee. The numbering is reversed at the end, as in RCM.
+  V<I> gps() const
+  {
+    const I none = m_n;
+    V<I> permutation;
+    permutation.reserve(m_n);
+    V<I> numbered(m_n), level(m_n), lu(m_n), lv(m_n);
+    for (I i = 0; i < m_n; ++i) {
+      numbered[i] = 0;
+    }
+    Marks marks(m_n);
+    V<I> vertices, offsets, other, other_offsets, component;
+    for (I s0 = 0; s0 < m_n; ++s0) {
+      if (numbered[s0]) {
+        continue;
+      }
+      I u, v;
+      diameter(s0, marks, u, v);
+      levels(u, vertices, offsets, marks);
+      levels(v, other, other_offsets, marks);
+      I depth = offsets.size() - 1;
+      for (I l = 0; l < depth; ++l) {
+        for (I q = offsets[l]; q < offsets[l + 1]; ++q) {
+          lu[vertices[q]] = l;
+        }
+        for (I q = other_offsets[l]; q < other_offsets[l + 1]; ++q) {
+          lv[other[q]] = depth - 1 - l;
+        }
+      }
+      // Vertices on which the two structures agree are placed, the rest are placed a connected
+      // piece at a time, biggest first, whichever way keeps the widest level narrowest
+      V<I> width(depth);
+      for (I l = 0; l < depth; ++l) {
+        width[l] = 0;
+      }
+      for (I i : vertices) {
+        if (lu[i] == lv[i]) {
+          level[i] = lu[i];
+          ++width[lu[i]];
+        } else {
+          level[i] = none;
+        }
+      }
+      V<V<I>> unplaced;
+      for (I i : vertices) {
+        if (level[i] != none || marks.mark[i] == marks.stamp + 1) {
+          continue;
+        }
+        // Collect the piece with a search through the unplaced vertices
+        I stamp = marks.stamp + 1;
+        component.clear();
+        component.push_back(i);
+        marks.mark[i] = stamp;
+        for (I q = 0; q < component.size(); ++q) {
+          I x = component[q];
+          for (I r = m_xadj[x]; r < m_xadj[x + 1]; ++r) {
+            I y = m_adj[r];
+            if (level[y] == none && marks.mark[y] != stamp) {
+              marks.mark[y] = stamp;
+              component.push_back(y);
+            }
+          }
+        }
+        unplaced.push_back(component);
+      }
+      ++marks.stamp;
+      std::stable_sort(unplaced.begin(), unplaced.end(), [](const V<I> &a, const V<I> &b) { return a.size() > b.size(); });
+      V<I> wu(depth), wv(depth);
+      for (auto &piece : unplaced) {
+        wu = width;
+        wv = width;
+        for (I x : piece) {
+          ++wu[lu[x]];
+          ++wv[lv[x]];
+        }
+        I hu = 0;
+        I hv = 0;
+        for (I x : piece) {
+          hu = std::max(hu, wu[lu[x]]);
+          hv = std::max(hv, wv[lv[x]]);
+        }
+        bool use_u = hu <= hv;
+        for (I x : piece) {
+          level[x] = use_u ? lu[x] : lv[x];
+        }
+        width = use_u ? wu : wv;
+      }
+      // Number from the end with the smaller degree
+      I start = u;
+      if (degree(v) < degree(u)) {
+        start = v;
+        for (I x : vertices) {
+          level[x] = depth - 1 - level[x];
+        }
+      }
+      V<I> level_offsets(depth + 1);
+      for (I l = 0; l <= depth; ++l) {
+        level_offsets[l] = 0;
+      }
+      for (I x : vertices) {
+        ++level_offsets[level[x] + 1];
+      }
+      for (I l = 0; l < depth; ++l) {
+        level_offsets[l + 1] += level_offsets[l];
+      }
+      V<I> by_level(vertices.size());
+      V<I> next(level_offsets.begin(), level_offsets.end() - 1);
+      for (I x : vertices) {
+        by_level[next[level[x]]++] = x;
+      }
+      // Number the unnumbered neighbors of x in level l, in order of increasing degree
+      V<I> neighbors;
+      auto number_neighbors = [&](I x, I l) {
+        neighbors.clear();
+        for (I r = m_xadj[x]; r < m_xadj[x + 1]; ++r) {
+          I y = m_adj[r];
+          if (!numbered[y] && level[y] == l) {
+            numbered[y] = 1;
+            neighbors.push_back(y);
+          }
+        }
+        std::stable_sort(neighbors.begin(), neighbors.end(), [this](I a, I b) { return degree(a) < degree(b); });
+        permutation.insert(permutation.end(), neighbors.begin(), neighbors.end());
+      };
+      I first = permutation.size();
+      I previous_begin = first;
+      I previous_end = first;
+      for (I l = 0; l < depth; ++l) {
+        I begin = permutation.size();
+        if (l == 0) {
+          permutation.push_back(start);
+          numbered[start] = 1;
+        }
+        for (I q = previous_begin; q < previous_end; ++q) {
+          number_neighbors(permutation[q], l);
+        }
+        I q = begin;
+        while (true) {
+          for (; q < permutation.size(); ++q) {
+            number_neighbors(permutation[q], l);
+          }
+          if (permutation.size() - begin == level_offsets[l + 1] - level_offsets[l]) {
+            break;
+          }
+          // Nothing numbered leads to the rest of the level, start again from its least degree
+          I pick = none;
+          for (I t = level_offsets[l]; t < level_offsets[l + 1]; ++t) {
+            I x = by_level[t];
+            if (!numbered[x] && (pick == none || degree(x) < degree(pick))) {
+              pick = x;
+            }
+          }
+          numbered[pick] = 1;
+          permutation.push_back(pick);
+        }
+        previous_begin = begin;
+        previous_end = permutation.size();
+      }
+    }
+    std::reverse(permutation.begin(), permutation.end());
+    return permutation;
+  }
+
+  V<I> identity() const
+  {
+    V<I> permutation(m_n);
+    std::iota(permutation.begin(), permutation.end(), (I)0);
+    return permutation;
+  }
+
+  static V<I> invert(const V<I> &permutation)
+  {
+    V<I> inverse(permutation.size());
+    for (I k = 0; k < permutation.size(); ++k) {
+      inverse[permutation[k]] = k;
+    }
+    return inverse;
+  }
+
+protected:
+
+  I m_n;        // Number of vertices
+  V<I> m_xadj;  // Offsets into m_adj for each vertex, n + 1 entries
+  V<I> m_adj;   // Neighbors of each vertex, in increasing order
+
+  // Marks for the breadth first searches, each search marks with a new number so that the
+  // marks never have to be cleared
+  struct Marks
+  {
+    Marks(I n) : mark(n)
+    {
+      for (I i = 0; i < n; ++i) {
+        mark[i] = 0;
+      }
+    }
+    V<I> mark;
+    I stamp{ 0 };
+  };
+
+  // The rooted level structure of the component containing root: the vertices in breadth first
+  // order and the offsets into them where each level starts, with one more at the end
+  void levels(I root, V<I> &vertices, V<I> &offsets, Marks &marks) const
+  {
+    I stamp = ++marks.stamp;
+    vertices.clear();
+    offsets.clear();
+    vertices.push_back(root);
+    offsets.push_back(0);
+    marks.mark[root] = stamp;
+    for (I begin = 0; begin < vertices.size();) {
+      I end = vertices.size();
+      offsets.push_back(end);
+      for (I q = begin; q < end; ++q) {
+        I i = vertices[q];
+        for (I r = m_xadj[i]; r < m_xadj[i + 1]; ++r) {
+          if (marks.mark[m_adj[r]] != stamp) {
+            marks.mark[m_adj[r]] = stamp;
+            vertices.push_back(m_adj[r]);
+          }
+        }
+      }
+      begin = end;
+    }
+  }
+
+  // The ends u and v of a pseudo diameter of the component containing start, in the way of
+  // Gibbs, Poole and Stockmeyer: u is as far out as it gets, and v is the vertex at the far
+  // end from u whose level structure is narrowest
+  void diameter(I start, Marks &marks, I &u, I &v) const
+  {
+    V<I> vertices, offsets, trial_vertices, trial_offsets, last;
+    levels(start, vertices, offsets, marks);
+    u = start;
+    for (I x : vertices) {
+      if (degree(x) < degree(u)) {
+        u = x;
+      }
+    }
+    levels(u, vertices, offsets, marks);
+    while (true) {
+      I depth = offsets.size() - 1;
+      last.assign(vertices.begin() + offsets[depth - 1], vertices.begin() + offsets[depth]);
+      std::stable_sort(last.begin(), last.end(), [this](I a, I b) { return degree(a) < degree(b); });
+      bool deeper = false;
+      I narrowest = m_n + 1;
+      v = u;
+      for (I c = 0; c < last.size(); ++c) {
+        // Only one candidate of each degree
+        if (c > 0 && degree(last[c]) == degree(last[c - 1])) {
+          continue;
+        }
+        levels(last[c], trial_vertices, trial_offsets, marks);
+        if (trial_offsets.size() - 1 > depth) {
+          u = last[c];
+          vertices.swap(trial_vertices);
+          offsets.swap(trial_offsets);
+          deeper = true;
+          break;
+        }
+        I width = 0;
+        for (I l = 0; l + 1 < trial_offsets.size(); ++l) {
+          width = std::max(width, trial_offsets[l + 1] - trial_offsets[l]);
+        }
+        if (width < narrowest) {
+          narrowest = width;
+          v = last[c];
+        }
+      }
+      if (!deeper) {
+        return;
+      }
+    }
+  }
+
+  // A pseudo peripheral vertex in the component containing start, one whose level structure is
+  // about as deep as any (George and Liu)
+  I peripheral(I start, Marks &marks) const
+  {
+    V<I> vertices, offsets;
+    I root = start;
+    levels(root, vertices, offsets, marks);
+    while (true) {
+      I depth = offsets.size() - 1;
+      // Try the vertex of least degree in the last level
+      I best = vertices[offsets[depth - 1]];
+      for (I q = offsets[depth - 1]; q < offsets[depth]; ++q) {
+        if (degree(vertices[q]) < degree(best)) {
+          best = vertices[q];
+        }
+      }
+      V<I> trial_vertices, trial_offsets;
+      levels(best, trial_vertices, trial_offsets, marks);
+      if (trial_offsets.size() - 1 <= depth) {
+        return root;
+      }
+      root = best;
+      vertices.swap(trial_vertices);
+      offsets.swap(trial_offsets);
+    }
+  }
+};
+
+}
+
+#endif // !ORDERING_HPP
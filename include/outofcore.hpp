@@ -0,0 +1,296 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef OUTOFCORE_HPP
+#define OUTOFCORE_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <string>
+#include "kernels.hpp"
+
+// Factorization of skylines too big to keep in memory. The upper triangle is kept in a file,
+// in the same order as in memory, and split into blocks of whole columns. Only three blocks
+// are in memory at a time: the block being factored or solved with, the earlier block that
+// is being applied to it, and the next block, which is read in the background while the
+// others are worked on. The diagonal, the heights and the offsets stay in memory, so the
+// memory needed grows with the size of the system but not with the profile.
+
+namespace skyline {
+
+template <typename I, typename R, template <typename ...> typename V> class OutOfCoreMatrix
+{
+public:
+
+  // A matrix of zeros with the given heights, kept in the file at path with at most window
+  // bytes of it in memory. A column taller than a third of the window gets a block of its own.
+  OutOfCoreMatrix(const V<I> &heights, const std::string &path, std::size_t window) : m_n(heights.size()),
+    m_path(path), m_ik(heights.size() + 1), m_im(heights.size()), m_ad(heights.size(), 0.0)
+  {
+    m_ik[0] = 0;
+    for (I k = 0; k < m_n; ++k) {
+      m_im[k] = k - heights[k];
+      m_ik[k + 1] = m_ik[k] + heights[k];
+    }
+    // Blocks of whole columns, each at most a third of the window if it can be
+    std::size_t most = std::max(window / (3 * sizeof(R)), (std::size_t)1);
+    m_bc.push_back(0);
+    for (I k = 0; k < m_n; ++k) {
+      if (k > m_bc.back() && m_ik[k + 1] - m_ik[m_bc.back()] > most) {
+        m_bc.push_back(k);
+      }
+    }
+    m_bc.push_back(m_n);
+    I largest = 0;
+    for (I b = 0; b + 1 < m_bc.size(); ++b) {
+      largest = std::max(largest, m_ik[m_bc[b + 1]] - m_ik[m_bc[b]]);
+    }
+    m_block.resize(largest);
+    m_current.resize(largest);
+    m_next.resize(largest);
+    // A file of zeros, without writing them. The streams are unbuffered, the blocks are read
+    // and written whole.
+    std::ofstream(path, std::ios::binary | std::ios::trunc);
+    m_file.rdbuf()->pubsetbuf(nullptr, 0);
+    m_reader.rdbuf()->pubsetbuf(nullptr, 0);
+    m_file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+    m_reader.open(path, std::ios::binary | std::ios::in);
+    if (m_ik[m_n] > 0) {
+      m_file.seekp(m_ik[m_n] * sizeof(R) - 1);
+      m_file.put(0);
+      m_file.flush();
+    }
+    m_good = m_file.good() && m_reader.good();
+  }
+
+  // False once a read or write of the file has failed
+  bool good() const
+  {
+    return m_good;
+  }
+
+  // The number of blocks the upper triangle is split into
+  I blocks() const
+  {
+    return m_bc.size() - 1;
+  }
+
+  // Replace the values with those of a matrix in compressed sparse row form, as for
+  // SymmetricMatrix::assign_compressed(). Each block is filled and written out in turn.
+  bool assign_compressed(const V<I> &offsets, const V<I> &indices, const V<R> &values)
+  {
+    if (offsets.size() != m_n + 1 || offsets[m_n] > indices.size() || offsets[m_n] > values.size()) {
+      return false;
+    }
+    for (I b = 0; b < blocks(); ++b) {
+      R *au = m_block.data() - m_ik[m_bc[b]];
+      std::fill(m_block.begin(), m_block.end(), R(0));
+      for (I i = m_bc[b]; i < m_bc[b + 1]; ++i) {
+        m_ad[i] = 0.0;
+        for (I r = offsets[i]; r < offsets[i + 1]; ++r) {
+          I j = indices[r];
+          if (j == i) {
+            m_ad[i] += values[r];
+          } else if (j < i) {
+            au[m_ik[i] + j - m_im[i]] += values[r];
+          }
+        }
+      }
+      write(b, m_block.data());
+    }
+    m_factored = false;
+    return m_good;
+  }
+
+  // The left looking factorization, a block at a time. Each earlier block that the block
+  // reaches is streamed past it, and then the block is finished on its own. Column j holds
+  // D times the factor until it is done, and row i of it is reduced by the dot product of
+  // column i with column j. Nothing is done if the matrix is already factored.
+  bool utdu()
+  {
+    if (m_factored) {
+      return m_good;
+    }
+    for (I b = 0; b < blocks(); ++b) {
+      I c0 = m_bc[b];
+      I c1 = m_bc[b + 1];
+      read(b, m_block.data());
+      R *gb = m_block.data() - m_ik[c0];
+      I top = c0;
+      for (I j = c0; j < c1; ++j) {
+        top = std::min(top, m_im[j]);
+      }
+      I first = std::upper_bound(m_bc.begin(), m_bc.end(), top) - m_bc.begin() - 1;
+      stream(first, b, +1, [&](I a, const R *ua) {
+        for (I j = c0; j < c1; ++j) {
+          for (I i = std::max(m_bc[a], m_im[j] + 1); i < m_bc[a + 1]; ++i) {
+            reduce(ua + m_ik[i] - m_ik[m_bc[a]], i, gb + m_ik[j], j);
+          }
+        }
+      });
+      for (I j = c0; j < c1; ++j) {
+        for (I i = std::max(c0, m_im[j] + 1); i < j; ++i) {
+          reduce(gb + m_ik[i], i, gb + m_ik[j], j);
+        }
+        R *g = gb + m_ik[j];
+        for (I i = m_im[j]; i < j; ++i) {
+          R u = g[i - m_im[j]] / m_ad[i];
+          m_ad[j] -= u * g[i - m_im[j]];
+          g[i - m_im[j]] = u;
+        }
+      }
+      write(b, m_block.data());
+    }
+    m_factored = true;
+    return m_good;
+  }
+
+  // Solve with the factors a block at a time, front to back
+  bool forward_substitution(V<R> &b)
+  {
+    stream(0, blocks(), +1, [&](I a, const R *ua) {
+      for (I i = std::max(m_bc[a], (I)1); i < m_bc[a + 1]; ++i) {
+        b[i] -= kernels::dot(ua + m_ik[i] - m_ik[m_bc[a]], b.data() + m_im[i], i - m_im[i]);
+      }
+    });
+    return m_good;
+  }
+
+  // And back to front
+  bool back_substitution(V<R> &z)
+  {
+    for (I j = 0; j < m_n; ++j) {
+      z[j] /= m_ad[j];
+    }
+    stream(0, blocks(), -1, [&](I a, const R *ua) {
+      for (I j = m_bc[a + 1]; j-- > m_bc[a];) {
+        kernels::axpy(-z[j], ua + m_ik[j] - m_ik[m_bc[a]], z.data() + m_im[j], j - m_im[j]);
+      }
+    });
+    return m_good;
+  }
+
+  bool ldlt_solve(V<R> &b)
+  {
+    return utdu() && forward_substitution(b) && back_substitution(b);
+  }
+
+  bool factored() const
+  {
+    return m_factored;
+  }
+
+  const std::string &path() const
+  {
+    return m_path;
+  }
+
+  V<R> diagonal() const
+  {
+    return m_ad;
+  }
+
+  I rows() const
+  {
+    return m_n;
+  }
+
+  I cols() const
+  {
+    return m_n;
+  }
+
+private:
+
+  // g[i] of column j less the dot product of column i, which is done, with column j
+  void reduce(const R *ui, I i, R *gj, I j)
+  {
+    I m = std::max(m_im[i], m_im[j]);
+    gj[i - m_im[j]] -= kernels::dot(ui + m - m_im[i], gj + m - m_im[j], i - m);
+  }
+
+  // Call f(a, values) for blocks first through last - 1, in increasing order if step is
+  // positive and in decreasing order if not. Each block is read in the background while f
+  // works on the one before it.
+  template <typename F> void stream(I first, I last, int step, F f)
+  {
+    if (first >= last) {
+      return;
+    }
+    I a = step > 0 ? first : last - 1;
+    I end = step > 0 ? last : first - 1;
+    std::future<void> next = std::async(std::launch::async, [this, a]() { read(a, m_next.data()); });
+    for (; a != end; a += step) {
+      next.get();
+      std::swap(m_current, m_next);
+      I following = a + step;
+      if (following != end) {
+        next = std::async(std::launch::async, [this, following]() { read(following, m_next.data()); });
+      }
+      f(a, m_current.data());
+    }
+  }
+
+  void read(I b, R *data)
+  {
+    std::lock_guard<std::mutex> lock(m_io);
+    m_reader.seekg(m_ik[m_bc[b]] * sizeof(R));
+    m_reader.read(reinterpret_cast<char *>(data), (m_ik[m_bc[b + 1]] - m_ik[m_bc[b]]) * sizeof(R));
+    m_good = m_good && m_reader.good();
+  }
+
+  void write(I b, const R *data)
+  {
+    std::lock_guard<std::mutex> lock(m_io);
+    m_file.seekp(m_ik[m_bc[b]] * sizeof(R));
+    m_file.write(reinterpret_cast<const char *>(data), (m_ik[m_bc[b + 1]] - m_ik[m_bc[b]]) * sizeof(R));
+    m_file.flush();
+    m_good = m_good && m_file.good();
+  }
+
+  I m_n;            // System size
+  std::string m_path; // The file that holds the upper triangle
+  V<I> m_ik;        // Index offsets to top of skylines, n + 1 entries
+  V<I> m_im;        // Minimum row, or top of skyline
+  V<R> m_ad;        // Diagonal of matrix
+  V<I> m_bc;        // First column of each block, and n
+  V<R> m_block;     // The block being factored
+  V<R> m_current;   // The block being applied or solved with
+  V<R> m_next;      // The block being read in the background
+  std::fstream m_file;   // Writes, and reads of the block being factored
+  std::ifstream m_reader; // Reads of the blocks streamed past
+  std::mutex m_io;  // One read or write at a time
+  bool m_factored{ false };
+  bool m_good{ true };
+};
+
+}
+
+#endif
@@ -29,115 +29,385 @@
 #ifndef SKYLINE_HPP
 #define SKYLINE_HPP
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <numeric>
 #include <optional>
+#include <type_traits>
+#include <utility>
+#include "allocator.hpp"
+#include "kernels.hpp"
+#include "ordering.hpp"
+#include "threadpool.hpp"
 
 namespace skyline {
 
-template <typename I, typename R, template <typename ...> typename V> class SymmetricMatrix
+#ifdef SKYLINE_COMPACT_INDEX
+// An array of nonnegative indices kept in 32 bits, or in I if that is narrower. Each run of
+// 2^shift entries is relative to a base of type I, the smallest entry of the run, and the runs
+// are as long as they can be with every entry fitting. The tops of the skylines and the offsets
+// of a profile with fewer than 2^32 entries fit in one run.
+template <typename I, template <typename ...> typename V> class CompactIndex
 {
 public:
+  typedef std::conditional_t<(sizeof(I) > sizeof(std::uint32_t)), std::uint32_t, I> Compact;
+
+  CompactIndex() = default;
 
-  SymmetricMatrix(V<V<R>> &M)
+  CompactIndex(const V<I> &indices) : m_compact(indices.size())
   {
-    I n = M.size();
-    for (auto &v : M) {
-      n = std::min(n, v.size());
+    I n = indices.size();
+    while (m_shift + 1 < (unsigned)std::numeric_limits<I>::digits && (I(1) << m_shift) < n) {
+      ++m_shift;
     }
-    m_ih.resize(n);
-    for (I i = 0; i < n; i++) {
-      m_ih[i] = i;
-      for (I j = 0; j < i; j++) {
-        if (M[i][j] != 0.0) {
-          break;
-        }
-        --m_ih[i];
+    while (m_shift > 0 && !fits(indices, m_shift)) {
+      --m_shift;
+    }
+    m_base.resize((n >> m_shift) + 1);
+    for (I r = 0; r < m_base.size(); ++r) {
+      I first = r << m_shift;
+      I last = std::min(n, first + (I(1) << m_shift));
+      m_base[r] = first < last ? *std::min_element(indices.begin() + first, indices.begin() + last) : 0;
+      for (I i = first; i < last; ++i) {
+        m_compact[i] = indices[i] - m_base[r];
       }
     }
-    auto sum = std::accumulate(m_ih.begin(), m_ih.end(), (I)0);
+  }
 
-    m_ik.resize(n);
-    m_im.resize(n);
-    // Convert heights to column offsets.
-    m_ik[0] = 0;
-    m_im[0] = 0;
-    for (I k = 1; k < n; ++k) {
-      m_ik[k] = m_ik[k - 1] + m_ih[k - 1];
-      m_im[k] = k - m_ih[k];
+  I operator[](I i) const
+  {
+    return m_base[i >> m_shift] + m_compact[i];
+  }
+
+  I size() const
+  {
+    return m_compact.size();
+  }
+
+  // The indices at full width
+  V<I> expand() const
+  {
+    V<I> indices(size());
+    for (I i = 0; i < size(); ++i) {
+      indices[i] = (*this)[i];
     }
+    return indices;
+  }
 
-#ifndef SKYLINE_MULTIPLE_ARRAY
-    // Copy into the am array
-    m_am.resize(n + sum);
-#else
-    // Copy into the au/d arrays
-    m_ad.resize(n);
-    m_au.resize(sum);
+  // Number of runs with their own base, one unless the indices need more than 32 bits
+  I runs() const
+  {
+    return m_base.size();
+  }
+
+private:
+  static bool fits(const V<I> &indices, unsigned shift)
+  {
+    for (I first = 0; first < indices.size(); first += I(1) << shift) {
+      I last = std::min((I)indices.size(), first + (I(1) << shift));
+      auto range = std::minmax_element(indices.begin() + first, indices.begin() + last);
+      if (*range.second - *range.first > std::numeric_limits<Compact>::max()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  V<Compact> m_compact; // The indices less the base of their run
+  V<I> m_base;          // The smallest index of each run
+  unsigned m_shift{ 0 }; // Each run has 2^shift indices
+};
 #endif
-    I count = 0;
-    for (I i = 0; i < n; i++) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-      m_am[i] = M[i][i];
+
+// The symbolic structure of a skyline matrix: where each column starts and which columns reach
+// each row. This depends only on the heights of the columns, so any number of matrices with the
+// same pattern can share one.
+template <typename I, template <typename ...> typename V> class Structure
+{
+public:
+
+#ifndef SKYLINE_COMPACT_INDEX
+  typedef V<I> Indices;
 #else
-      m_ad[i] = M[i][i];
+  // The offsets and tops, the row-reach index and the levels are kept in 32 bits, see
+  // CompactIndex
+  typedef CompactIndex<I, V> Indices;
 #endif
-      I j;
-      for (j = 0; j < i; j++) {
-        if (M[i][j] != 0.0) {
-          break;
-        }
-      }
-      for (; j < i; j++) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-        m_am[n + count] = M[i][j];
+
+  Structure(const V<I> &heights) : m_n(heights.size())
+  {
+    V<I> ik(m_n);
+    V<I> im(m_n);
+    // Convert heights to column offsets.
+    for (I k = 1; k < m_n; ++k) {
+      ik[k] = ik[k - 1] + heights[k - 1];
+      im[k] = k - heights[k];
+    }
+    m_ik = Indices(std::move(ik));
+    m_im = Indices(std::move(im));
+    m_profile = std::accumulate(heights.begin(), heights.end(), (I)0);
+    reach();
+    find_panels();
+    find_levels();
+  }
+
+  I size() const
+  {
+    return m_n;
+  }
+
+  // Number of elements in the upper triangle
+  I profile() const
+  {
+    return m_profile;
+  }
+
+  V<I> offsets() const
+  {
+    return expand(m_ik);
+  }
+
+  // The heights are not kept, they are the differences of the offsets
+  V<I> heights() const
+  {
+    V<I> ih(m_n);
+    for (I k = 0; k + 1 < m_n; ++k) {
+      ih[k] = m_ik[k + 1] - m_ik[k];
+    }
+    if (m_n > 0) {
+      ih[m_n - 1] = m_profile - m_ik[m_n - 1];
+    }
+    return ih;
+  }
+
+  V<I> minima() const
+  {
+    return expand(m_im);
+  }
+
+  V<I> panels() const
+  {
+    return m_pb;
+  }
+
+  // Number of levels in the forward and back substitutions. The rows of a level depend only
+  // on rows in earlier levels, so they can be solved at the same time.
+  I forward_levels() const
+  {
+    return m_fl.size() - 1;
+  }
+
+  I back_levels() const
+  {
+    return m_bl.size() - 1;
+  }
+
+  // Size of the temporaries a factorization needs, v and four more for the blocked steps
+  I workspace() const
+  {
+    return m_pb.empty() ? m_n : 5 * m_n;
+  }
+
+protected:
+  template <typename, typename, template <typename ...> typename> friend class SymmetricMatrix;
+  template <typename, typename, template <typename ...> typename> friend class NonsymmetricMatrix;
+  template <typename, typename, template <typename ...> typename, std::size_t> friend class BatchedSymmetricMatrix;
+
+  I m_n;       // System size
+  I m_profile; // Size of the upper triangle
+  Indices m_ik; // Index offsets to top of skylines
+  Indices m_im; // Minimum row, or top of skyline
+  Indices m_ir; // Offsets into m_kr for each row, n + 1 entries
+  Indices m_kr; // Columns whose skyline reaches each row, in increasing order by row
+  Indices m_et; // Elimination tree, the first column that reaches each row or n if there is none
+  V<I> m_pb;    // Beginning and end of each panel
+  Indices m_fl; // Offsets into m_fr for each forward substitution level, levels + 1 entries
+  Indices m_fr; // Rows in order by forward substitution level
+  Indices m_bl; // Offsets into m_br for each back substitution level, levels + 1 entries
+  Indices m_br; // Rows in order by back substitution level
+
+  // Panels are runs of at least four columns with this height or more
+  static constexpr I panel_height = 32;
+
+  static V<I> expand(const Indices &indices)
+  {
+#ifndef SKYLINE_COMPACT_INDEX
+    return indices;
 #else
-        m_au[count] = M[i][j];
+    return indices.expand();
 #endif
-        ++count;
+  }
+
+  // Build the row-reach index, the symbolic phase of the factorization. Column k reaches
+  // row j if m_im[k] <= j < k, so the index is the same size as the upper profile.
+  void reach()
+  {
+    V<I> ir(m_n + 1);
+    for (I j = 0; j <= m_n; ++j) {
+      ir[j] = 0;
+    }
+    // Count the columns reaching each row, then convert to offsets
+    for (I k = 1; k < m_n; ++k) {
+      for (I j = m_im[k]; j < k; ++j) {
+        ++ir[j + 1];
       }
     }
-
-    m_v.resize(n);
-    m_n = n;
+    for (I j = 0; j < m_n; ++j) {
+      ir[j + 1] += ir[j];
+    }
+    V<I> kr(ir[m_n]);
+    V<I> next(ir.begin(), ir.end() - 1);
+    for (I k = 1; k < m_n; ++k) {
+      for (I j = m_im[k]; j < k; ++j) {
+        kr[next[j]] = k;
+        ++next[j];
+      }
+    }
+    V<I> et(m_n);
+    for (I j = 0; j < m_n; ++j) {
+      et[j] = ir[j] < ir[j + 1] ? kr[ir[j]] : m_n;
+    }
+    m_ir = Indices(std::move(ir));
+    m_kr = Indices(std::move(kr));
+    m_et = Indices(std::move(et));
   }
 
-  SymmetricMatrix(V<I> &heights) : m_ih(heights)
+  // Find the panels, runs of adjacent columns that are tall and whose tops are the same or
+  // step down by one row per column, the shape of a band. These are factored in blocks.
+  void find_panels()
   {
-    I n = m_ih.size();
-    auto sum = std::accumulate(m_ih.begin(), m_ih.end(), (I)0);
+    m_pb.clear();
+    I k = 0;
+    while (k < m_n) {
+      if (k - m_im[k] < panel_height) {
+        ++k;
+        continue;
+      }
+      I e = k + 1;
+      while (e < m_n && e - m_im[e] >= panel_height && m_im[e - 1] <= m_im[e] && m_im[e] <= m_im[e - 1] + 1) {
+        ++e;
+      }
+      if (e - k >= 4) {
+        m_pb.push_back(k);
+        m_pb.push_back(e);
+      }
+      k = e;
+    }
+  }
 
-    m_ik.resize(n);
-    m_im.resize(n);
-    // Convert heights to column offsets.
-    m_ik[0] = 0;
-    m_im[0] = 0;
-    for (I k = 1; k < n; ++k) {
-      m_ik[k] = m_ik[k - 1] + m_ih[k - 1];
-      m_im[k] = k - m_ih[k];
+  // Sort the rows into levels for the substitutions. In the forward substitution a row needs
+  // the rows in its skyline, in the back substitution it needs the columns that reach it.
+  void find_levels()
+  {
+    V<I> level(m_n);
+    for (I i = 0; i < m_n; ++i) {
+      level[i] = 0;
+      for (I k = m_im[i]; k < i; ++k) {
+        level[i] = std::max(level[i], level[k] + 1);
+      }
+    }
+    sort_levels(level, m_fl, m_fr);
+    for (I i = m_n; i-- > 0;) {
+      level[i] = 0;
+      for (I r = m_ir[i]; r < m_ir[i + 1]; ++r) {
+        level[i] = std::max(level[i], level[m_kr[r]] + 1);
+      }
     }
+    sort_levels(level, m_bl, m_br);
+  }
 
-#ifndef SKYLINE_MULTIPLE_ARRAY
-    // Size the am array
-    I total{ n + sum };
-    m_am.resize(total);
-    for (I i = 0; i < total; i++) {
-      m_am[i] = 0.0;
+  void sort_levels(const V<I> &level, Indices &level_offsets, Indices &level_rows)
+  {
+    V<I> offsets;
+    V<I> rows;
+    I count = 0;
+    for (I i = 0; i < m_n; ++i) {
+      count = std::max(count, level[i] + 1);
     }
-#else
-    // Size the au/d array
-    m_ad.resize(n);
-    for (I i = 0; i < n; i++) {
-      m_ad[i] = 0.0;
+    offsets.resize(count + 1);
+    for (I l = 0; l <= count; ++l) {
+      offsets[l] = 0;
+    }
+    for (I i = 0; i < m_n; ++i) {
+      ++offsets[level[i] + 1];
+    }
+    for (I l = 0; l < count; ++l) {
+      offsets[l + 1] += offsets[l];
+    }
+    rows.resize(m_n);
+    V<I> next(offsets.begin(), offsets.end() - 1);
+    for (I i = 0; i < m_n; ++i) {
+      rows[next[level[i]]] = i;
+      ++next[level[i]];
     }
+    level_offsets = Indices(std::move(offsets));
+    level_rows = Indices(std::move(rows));
+  }
+};
+
+template <typename I, typename R, template <typename ...> typename V> class SymmetricMatrix
+{
+public:
+  typedef typename V<R>::allocator_type allocator_type;
 
-    m_au.resize(sum);
-    for (I i = 0; i < sum; i++) {
-      m_au[i] = 0.0;
+  SymmetricMatrix(V<V<R>> &M) : SymmetricMatrix(std::make_shared<const Structure<I, V>>(dense_heights(M)))
+  {
+    // Copy the dense matrix into the skyline
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    for (I k = 0; k < m_n; k++) {
+      ad[k] = M[k][k];
+      for (I i = m_im[k]; i < k; i++) {
+        au[m_ik[k] + i - m_im[k]] = M[k][i];
+      }
     }
-#endif
+  }
+
+  SymmetricMatrix(V<I> &heights) : SymmetricMatrix(std::make_shared<const Structure<I, V>>(heights))
+  {}
+
+  // A matrix in compressed sparse row form, see assign_compressed()
+  SymmetricMatrix(const V<I> &offsets, const V<I> &indices, const V<R> &values) :
+    SymmetricMatrix(std::make_shared<const Structure<I, V>>(compressed_heights(offsets, indices)))
+  {
+    assign_compressed(offsets, indices, values);
+  }
 
-    m_v.resize(n);
-    m_n = n;
+  // A matrix of zeros with the given structure, which may be shared with any number of other
+  // matrices. No symbolic work is done.
+  SymmetricMatrix(std::shared_ptr<const Structure<I, V>> structure) : SymmetricMatrix(structure, allocator_type())
+  {}
+
+  // The same, with the values and the workspace taken from the given allocator. With
+  // std::pmr::vector as V this can be an arena, such as a std::pmr::monotonic_buffer_resource
+  // that is released once the matrices built from it are gone, so that building many matrices
+  // with a shared structure does not go back to the heap for each of them.
+  SymmetricMatrix(std::shared_ptr<const Structure<I, V>> structure, const allocator_type &allocator) :
+    m_structure(structure), m_n(structure->m_n), m_ik(structure->m_ik), m_im(structure->m_im),
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    m_am(allocator),
+#else
+    m_au(allocator), m_ad(allocator),
+#endif
+    m_v(allocator), m_ir(structure->m_ir), m_kr(structure->m_kr), m_et(structure->m_et), m_pb(structure->m_pb),
+    m_fl(structure->m_fl), m_fr(structure->m_fr), m_bl(structure->m_bl), m_br(structure->m_br), m_vb(allocator),
+    m_tp(rebind_alloc<I>(allocator)), m_sf(rebind_alloc<I>(allocator)), m_sb(rebind_alloc<I>(allocator)),
+    m_tm(rebind_alloc<I>(allocator)), m_ts(rebind_alloc<I>(allocator)), m_so(rebind_alloc<I>(allocator)),
+    m_original(allocator)
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    m_am.resize(m_n + structure->profile());
+#else
+    m_ad.resize(m_n);
+    m_au.resize(structure->profile());
+#endif
+    fill(0.0);
+    m_v.resize(m_n);
+    m_vb.resize(structure->workspace() - m_n);
   }
 
   void fill(R v = 0.0)
@@ -148,21 +418,33 @@ public:
     std::fill(m_ad.begin(), m_ad.end(), v);
     std::fill(m_au.begin(), m_au.end(), v);
 #endif
+    m_factored = false;
+    m_dirty = 0;
+  }
+
+  std::shared_ptr<const Structure<I, V>> structure() const
+  {
+    return m_structure;
+  }
+
+  allocator_type get_allocator() const
+  {
+    return m_v.get_allocator();
   }
 
   V<I> offsets() const
   {
-    return m_ik;
+    return m_structure->offsets();
   }
 
   V<I> heights() const
   {
-    return m_ih;
+    return m_structure->heights();
   }
 
   V<I> minima() const
   {
-    return m_im;
+    return m_structure->minima();
   }
 
   V<R> diagonal() const
@@ -192,8 +474,22 @@ public:
 #endif
   }
 
+  // Entry i of the storage. With tracking, its column counts as changed, as for operator()(i, j).
   R &operator()(I i)
   {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    I ij = i;
+#else
+    I ij = m_n + i;
+#endif
+    if (ij < m_n) {
+      changed(ij);
+    } else {
+      changed(column(ij - m_n));
+    }
+    if (m_track && m_factored) {
+      return m_original[ij];
+    }
 #ifndef SKYLINE_MULTIPLE_ARRAY
     return m_am[i];
 #else
@@ -201,8 +497,13 @@ public:
 #endif
   }
 
+  // Diagonal element i. With tracking, column i counts as changed, as for operator()(i, j).
   R &diagonal(I i)
   {
+    changed(i);
+    if (m_track && m_factored) {
+      return m_original[i];
+    }
 #ifndef SKYLINE_MULTIPLE_ARRAY
     return m_am[i]; // This ends up being the same as operator()
 #else
@@ -210,374 +511,3164 @@ public:
 #endif
   }
 
+  // Index of element (i, j) in the combined storage: the diagonal comes first, then the upper
+  // triangle column by column. Elements outside the skyline have no index.
   std::optional<I> index(I i, I j) const
   {
-    if (m_im[j] <= i) {
-      return m_n + m_ik[j] + i - m_im[j];
-    } else if (m_im[j] == i) {
+    if (i > j) {
+      std::swap(i, j);
+    }
+    if (i == j) {
       return i;
+    } else if (m_im[j] <= i) {
+      return m_n + m_ik[j] + i - m_im[j];
     }
     return {};
   }
 
-  virtual void utdu()
+  // Element (i, j), which must be inside the skyline. With tracking, the reference may be
+  // written through, so column max(i, j) counts as changed even if it is only read; value()
+  // and set() read and write without that.
+  R &operator()(I i, I j)
   {
-    // j = 0, nothing much to do
-    for (I k = 1; k < m_n; ++k) {
-      if (m_im[k] == 0) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-        I ij = m_n + m_ik[k];
-        m_am[ij] /= m_am[0];
-#else
-        I ij = m_ik[k];
-        m_au[ij] /= m_ad[0];
-#endif
-      }
+    I ij = *index(i, j);
+    changed(std::max(i, j));
+    if (m_track && m_factored) {
+      return m_original[ij];
     }
-    // Now for the rest
-    for (I j = 1; j < m_n; ++j) {
-      // Compute v
-      for (I i = 0; i < m_im[j]; ++i) {
-        m_v[i] = 0.0;
-      }
-      for (I i = m_im[j]; i < j; ++i) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-        m_v[i] = m_am[m_n + m_ik[j] + i - m_im[j]] * m_am[i]; // OK, i >= m_im[j]
-#else
-        m_v[i] = m_au[m_ik[j] + i - m_im[j]] * m_ad[i]; // OK, i >= m_im[j]
-#endif
-      }
-      // Compute the diagonal term
-      R value = 0.0;
-      for (I i = m_im[j]; i < j; ++i) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-        value += m_am[m_n + m_ik[j] + i - m_im[j]] * m_v[i];  // OK, i >= m_im[j]
-#else
-        value += m_au[m_ik[j] + i - m_im[j]] * m_v[i];  // OK, i >= m_im[j]
-#endif
-      }
-#ifndef SKYLINE_MULTIPLE_ARRAY
-      m_am[j] -= value;
-#else
-      m_ad[j] -= value;
-#endif
-      // Compute the rest of the row
-      for (I k = j + 1; k < m_n; ++k) {
-        if (m_im[k] <= j) {
-          value = 0.0;
-#ifndef SKYLINE_MULTIPLE_ARRAY
-          for (I i = m_im[k]; i < j; ++i) {
-            I ij = m_n + m_ik[k] + i - m_im[k]; // OK, i >= m_im[k]
-            value += m_am[ij] * m_v[i];
-          }
-          I ij = m_n + m_ik[k] + j - m_im[k]; // OK, j >= m_im[k]
-          m_am[ij] = (m_am[ij] - value) / m_am[j];
-#else
-          for (I i = m_im[k]; i < j; ++i) {
-            I ij = m_ik[k] + i - m_im[k]; // OK, i >= m_im[k]
-            value += m_au[ij] * m_v[i];
-          }
-          I ij = m_ik[k] + j - m_im[k]; // OK, j >= m_im[k]
-          m_au[ij] = (m_au[ij] - value) / m_ad[j];
-#endif
-        }
-      }
+    if (ij < m_n) {
+      return diagonal_data()[ij];
     }
+    return upper_data()[ij - m_n];
   }
 
-  virtual void forward_substitution(V<R> &b) const
+  // Element (i, j), zero outside the skyline. With tracking, this is the value rather than the
+  // factor, and nothing is marked as changed.
+  R value(I i, I j) const
   {
-    // Solve Lz=b (Dy=z, Ux=y)
-    for (I i = 1; i < m_n; ++i) {
-      R value = 0.0;
-      for (I k = m_im[i]; k < i; ++k) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-        I ij = m_n + m_ik[i] + k - m_im[i];
-        value += m_am[ij] * b[k];
-#else
-        I ij = m_ik[i] + k - m_im[i];
-        value += m_au[ij] * b[k];
-#endif
+    std::optional<I> ij = index(i, j);
+    if (!ij) {
+      return R(0);
+    }
+    if (m_track && m_factored) {
+      return m_original[*ij];
+    }
+    return *ij < m_n ? diagonal_data()[*ij] : upper_data()[*ij - m_n];
+  }
+
+  // Set element (i, j), which must be inside the skyline
+  void set(I i, I j, R value)
+  {
+    (*this)(i, j) = value;
+  }
+
+  // Factor the matrix in place. Returns false if a pivot is zero or not finite, in which case
+  // the factors can't be used to solve.
+  virtual bool utdu()
+  {
+    if (m_track) {
+      if (m_factored) {
+        // Put back the values of the changed columns and pick up from the first of them
+        if (m_dirty < m_n) {
+          std::copy(m_original.begin() + m_dirty, m_original.begin() + m_n, diagonal_data() + m_dirty);
+          std::copy(m_original.begin() + m_n + m_ik[m_dirty], m_original.end(), upper_data() + m_ik[m_dirty]);
+          resume(m_dirty);
+        }
+      } else {
+        m_original.resize(m_n + m_structure->profile());
+        std::copy(diagonal_data(), diagonal_data() + m_n, m_original.begin());
+        std::copy(upper_data(), upper_data() + m_structure->profile(), m_original.begin() + m_n);
+        m_pool ? utdu_parallel() : factor(0);
       }
-      b[i] -= value;
+    } else {
+      m_pool ? utdu_parallel() : factor(0);
     }
+    m_factored = true;
+    m_dirty = m_n;
+    return finite_pivots();
   }
 
-  virtual void back_substitution(V<R> &z) const
+  // Keep a copy of the values when factoring, so that changes made afterwards only cost the
+  // refactorization of the columns from the first changed one on. While the factors are in
+  // place, element access goes to the copy. Tracking can't start once the matrix is factored.
+  bool track(bool track)
   {
-    // Account for the diagonal first (invert Dy=z)
-    for (I j = 0; j < m_n; ++j) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-      z[j] /= m_am[j];
-#else
-      z[j] /= m_ad[j];
-#endif
+    if (track && !m_track && m_factored) {
+      return false;
     }
-    // Solve Ux=y
-    for (I j = m_n - 1; j > 0; --j) {
-      for (I k = m_im[j]; k < j; ++k) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-        I ij = m_n + m_ik[j] + k - m_im[j];
-        z[k] -= z[j] * m_am[ij];
-#else
-        I ij = m_ik[j] + k - m_im[j];
-        z[k] -= z[j] * m_au[ij];
-#endif
-      }
+    m_track = track;
+    if (!track) {
+      m_original.clear();
     }
+    return true;
   }
 
-  virtual void ldlt_solve(V<R> &b)
+  bool track() const
   {
-    utdu();
-    forward_substitution(b);
-    back_substitution(b);
+    return m_track;
   }
 
-  virtual void utdu_solve(V<R>& b)
+  // The first column changed since the last factorization, rows() if there are none
+  I dirty() const
   {
-    utdu();
-    forward_substitution(b);
-    back_substitution(b);
+    return m_dirty;
   }
 
-  I rows() const
+  // Turn the blocked factorization of panels on or off, mainly for comparison
+  void blocked(bool blocked)
   {
-    return m_n;
+    m_blocked = blocked;
+    schedule();
   }
 
-  I cols() const
+  bool blocked() const
   {
-    return m_n;
+    return m_blocked;
   }
 
-protected:
+  // Factor with n threads, the calling thread and n - 1 others. One thread, the default, is the
+  // plain serial factorization. Copies of the matrix share the threads, so they should not be
+  // factored at the same time. The pool runs one call at a time, so with threads the const
+  // solves and products of a matrix and its copies shouldn't overlap either; without threads
+  // they can run at the same time on the same factors.
+  void threads(unsigned n)
+  {
+    m_pool = n > 1 ? std::make_shared<ThreadPool>(n) : nullptr;
+    schedule();
+  }
 
-  I m_n;     // System size
-  V<I> m_ik; // Index offsets to top of skylines
-  V<I> m_ih; // Height of each skyline (not used, should probably be removed)
-  V<I> m_im; // Minimum row, or top of skyline
-#ifndef SKYLINE_MULTIPLE_ARRAY
-  V<R> m_am; // The entire matrix in one vector, first the diagonal, then the rest
-#else
-  V<R> m_au; // Upper triangular part of matrix
-  V<R> m_ad; // Diagonal of matrix
-#endif
-  V<R> m_v;  // Temporary used in solution
-};
+  unsigned threads() const
+  {
+    return m_pool ? m_pool->size() : 1;
+  }
 
-template <typename I, typename R, template <typename ...> typename V> class SymmetricSkipMatrix : public SymmetricMatrix<I, R, V>
-{
-public:
+  // The panels, column ranges with wide skylines and tops that line up, that are factored four
+  // pivots at a time
+  V<I> panels() const
+  {
+    return m_pb;
+  }
 
-  SymmetricSkipMatrix(V<V<R>>& M) : SymmetricMatrix<I, R, V>(M)
+  // Factor new values with the same structure, in the order of index(): the diagonal, then the
+  // upper triangle column by column. Nothing is allocated and no symbolic work is done.
+  // Returns false, leaving the matrix alone, unless there is a value for every element, and
+  // otherwise what utdu() returns.
+  bool refactor(const V<R> &values)
   {
-    m_skip.resize(this->m_n);
-    m_ip.resize(this->m_n);
+    if (values.size() != m_n + m_structure->profile()) {
+      return false;
+    }
+    std::copy(values.begin(), values.begin() + m_n, diagonal_data());
+    std::copy(values.begin() + m_n, values.end(), upper_data());
+    m_factored = false;
+    m_dirty = 0;
+    return utdu();
+  }
+
+  // The product y = Ax. Each column is read once for both triangles: its dot product with x
+  // is the part of y[k] above the diagonal, and x[k] times the column is added to the rows
+  // above. With tracking, the product is with the values rather than the factors; without it,
+  // the matrix should not have been factored. With threads, each thread takes a range of
+  // columns.
+  void multiply(const V<R> &x, V<R> &y) const
+  {
+    std::fill(y.begin(), y.begin() + m_n, R(0));
+    multiply_add(x, y);
+  }
+
+  // The heights of the skyline of a matrix in compressed sparse row form: row i has the column
+  // indices indices[offsets[i]] through indices[offsets[i + 1] - 1]. Only the entries on and
+  // below the diagonal are used, so the rows may hold the whole matrix or its lower triangle.
+  // Compressed sparse columns of the whole matrix or its upper triangle are the same arrays.
+  // There are no heights if the offsets are empty or run past the indices.
+  static V<I> compressed_heights(const V<I> &offsets, const V<I> &indices)
+  {
+    if (offsets.empty() || offsets.back() > indices.size()) {
+      return V<I>();
+    }
+    I n = offsets.size() - 1;
+    V<I> heights(n);
+    for (I i = 0; i < n; ++i) {
+      I top = i;
+      for (I r = offsets[i]; r < offsets[i + 1]; ++r) {
+        top = std::min(top, indices[r]);
+      }
+      heights[i] = i - top;
+    }
+    return heights;
+  }
+
+  // Replace the values with those of a matrix in compressed sparse row form, as for
+  // compressed_heights(). Row i below the diagonal is column i of the skyline, so with threads
+  // each thread takes a range of rows and writes only its own columns. Every entry used must
+  // be inside the skyline. Nothing is changed unless there is an offset for each row and one
+  // past the last, and the indices and values reach the last offset.
+  bool assign_compressed(const V<I> &offsets, const V<I> &indices, const V<R> &values)
+  {
+    if (!fits_compressed(offsets, indices, values)) {
+      return false;
+    }
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    each_row(offsets, [&](I first, I last) {
+      for (I i = first; i < last; ++i) {
+        ad[i] = 0.0;
+        std::fill(au + m_ik[i], au + m_ik[i] + i - m_im[i], R(0));
+        for (I r = offsets[i]; r < offsets[i + 1]; ++r) {
+          I j = indices[r];
+          if (j == i) {
+            ad[i] += values[r];
+          } else if (j < i) {
+            au[m_ik[i] + j - m_im[i]] += values[r];
+          }
+        }
+      }
+    });
+    m_factored = false;
+    m_dirty = 0;
+    return true;
+  }
+
+  // The pattern of the skyline in compressed sparse row form, both triangles with the columns
+  // of each row in order. Being symmetric, it is also the compressed sparse column form.
+  void compressed(V<I> &offsets, V<I> &indices) const
+  {
+    offsets.resize(m_n + 1);
+    offsets[0] = 0;
+    for (I i = 0; i < m_n; ++i) {
+      offsets[i + 1] = offsets[i] + i - m_im[i] + 1 + m_ir[i + 1] - m_ir[i];
+    }
+    indices.resize(offsets[m_n]);
+    for (I i = 0; i < m_n; ++i) {
+      I *p = indices.data() + offsets[i];
+      for (I j = m_im[i]; j <= i; ++j) {
+        *p++ = j;
+      }
+      for (I r = m_ir[i]; r < m_ir[i + 1]; ++r) {
+        *p++ = m_kr[r];
+      }
+    }
+  }
+
+  // The values of the matrix for a compressed sparse row pattern, which need not be the one
+  // that compressed() gives, written into values as it is. Entries outside the skyline are
+  // zero. With threads, each thread takes a range of rows. The arrays must fit as for
+  // assign_compressed().
+  bool compressed_values(const V<I> &offsets, const V<I> &indices, V<R> &values) const
+  {
+    if (!fits_compressed(offsets, indices, values)) {
+      return false;
+    }
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    if (m_track && m_factored) {
+      ad = m_original.data();
+      au = ad + m_n;
+    }
+    each_row(offsets, [&](I first, I last) {
+      for (I i = first; i < last; ++i) {
+        for (I r = offsets[i]; r < offsets[i + 1]; ++r) {
+          std::optional<I> ij = index(i, indices[r]);
+          values[r] = !ij ? R(0) : *ij < m_n ? ad[*ij] : au[*ij - m_n];
+        }
+      }
+    });
+    return true;
+  }
+
+  // y += alpha*Ax, as for multiply()
+  virtual void multiply_add(const V<R> &x, V<R> &y, R alpha = 1.0) const
+  {
+    multiply_add(x.data(), y.data(), alpha);
+  }
+
+  virtual void forward_substitution(V<R> &b) const
+  {
+    if (m_split_forward) {
+      forward_levels(b);
+      return;
+    }
+    // Solve Lz=b (Dy=z, Ux=y)
+    const R *au = upper_data();
+    for (I i = 1; i < m_n; ++i) {
+      b[i] -= kernels::dot(au + m_ik[i], b.data() + m_im[i], i - m_im[i]);
+    }
+  }
+
+  virtual void back_substitution(V<R> &z) const
+  {
+    if (m_split_back) {
+      back_levels(z);
+      return;
+    }
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    // Account for the diagonal first (invert Dy=z)
+    for (I j = 0; j < m_n; ++j) {
+      z[j] /= ad[j];
+    }
+    // Solve Ux=y
+    for (I j = m_n - 1; j > 0; --j) {
+      kernels::axpy(-z[j], au + m_ik[j], z.data() + m_im[j], j - m_im[j]);
+    }
+  }
+
+  // Solve for several right hand sides at once. They are interleaved, b[nrhs*i + r] is row i
+  // of right hand side r, so each row of the factor is read once for all of them and the
+  // kernels work across the right hand sides. With threads, each thread takes a slice of the
+  // right hand sides.
+  virtual void forward_substitution(V<R> &b, I nrhs) const
+  {
+    each_slice(nrhs, [&](I first, I last) {
+      const R *au = upper_data();
+      for (I i = 1; i < m_n; ++i) {
+        kernels::dot_rows(au + m_ik[i], b.data() + nrhs * m_im[i] + first, nrhs, i - m_im[i],
+          b.data() + nrhs * i + first, last - first);
+      }
+    });
+  }
+
+  virtual void back_substitution(V<R> &z, I nrhs) const
+  {
+    each_slice(nrhs, [&](I first, I last) {
+      const R *ad = diagonal_data();
+      const R *au = upper_data();
+      for (I j = 0; j < m_n; ++j) {
+        for (I r = first; r < last; ++r) {
+          z[nrhs * j + r] /= ad[j];
+        }
+      }
+      for (I j = m_n - 1; j > 0; --j) {
+        kernels::axpy_rows(au + m_ik[j], z.data() + nrhs * j + first, j - m_im[j], z.data() + nrhs * m_im[j] + first,
+          nrhs, last - first);
+      }
+    });
+  }
+
+  // The rows reached from the given rows through the factor, in increasing order. Row k is
+  // reached from row j if the skyline of column k reaches j. Every column that reaches j also
+  // reaches the first of them, so it is enough to follow the first column from each row, the
+  // path up the elimination tree. A single path never comes back to a row, so the marks that
+  // stop the paths from several rows at rows already reached are only needed for more than one.
+  // They are local, so that solves on the same factors can run at the same time.
+  V<I> reach(const V<I> &rows) const
+  {
+    V<I> reached;
+    if (rows.size() == 1) {
+      for (I j = rows[0]; j < m_n; j = m_et[j]) {
+        reached.push_back(j);
+      }
+      return reached;
+    }
+    V<bool> mark(m_n, false);
+    for (I j : rows) {
+      for (; j < m_n && !mark[j]; j = m_et[j]) {
+        mark[j] = true;
+        reached.push_back(j);
+      }
+    }
+    std::sort(reached.begin(), reached.end());
+    return reached;
+  }
+
+  // Forward substitution for a right hand side that is zero outside of the given rows. Only
+  // the rows they reach are visited, so the cost depends on the reach rather than the size of
+  // the system. The rows reached are returned, everything else in b stays zero.
+  virtual V<I> sparse_forward_substitution(V<R> &b, const V<I> &nonzeros) const
+  {
+    V<I> reached = reach(nonzeros);
+    const R *au = upper_data();
+    for (I i : reached) {
+      b[i] -= kernels::dot(au + m_ik[i], b.data() + m_im[i], i - m_im[i]);
+    }
+    return reached;
+  }
+
+  // Back substitution for only some of the unknowns. The unknowns that a row depends on are
+  // the ones it reaches, so only those columns are applied. The entries of z for the requested
+  // rows are the solution, the others are left part way.
+  virtual void partial_back_substitution(V<R> &z, const V<I> &rows) const
+  {
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    V<I> reached = reach(rows);
+    for (I i : reached) {
+      z[i] /= ad[i];
+    }
+    for (I p = reached.size(); p-- > 0;) {
+      I j = reached[p];
+      kernels::axpy(-z[j], au + m_ik[j], z.data() + m_im[j], j - m_im[j]);
+    }
+  }
+
+  // Solve for the requested unknowns only, returned in the same order. The forward
+  // substitution is done in full, b is left part way.
+  V<R> partial_solve(V<R> &b, const V<I> &rows)
+  {
+    utdu();
+    forward_substitution(b);
+    partial_back_substitution(b, rows);
+    V<R> x(rows.size());
+    for (I p = 0; p < rows.size(); ++p) {
+      x[p] = b[rows[p]];
+    }
+    return x;
+  }
+
+  // Factor and solve, b is replaced by the solution. Returns false, leaving b alone, if the
+  // factorization breaks down.
+  virtual bool ldlt_solve(V<R> &b)
+  {
+    if (!utdu()) {
+      return false;
+    }
+    forward_substitution(b);
+    back_substitution(b);
+    return true;
+  }
+
+  virtual bool utdu_solve(V<R>& b)
+  {
+    if (!utdu()) {
+      return false;
+    }
+    forward_substitution(b);
+    back_substitution(b);
+    return true;
+  }
+
+  virtual bool ldlt_solve(V<R> &b, I nrhs)
+  {
+    if (!utdu()) {
+      return false;
+    }
+    forward_substitution(b, nrhs);
+    back_substitution(b, nrhs);
+    return true;
+  }
+
+  I rows() const
+  {
+    return m_n;
+  }
+
+  I cols() const
+  {
+    return m_n;
+  }
+
+protected:
+  template <typename, template <typename ...> typename> friend class MixedPrecisionMatrix;
+  template <typename, typename, template <typename ...> typename> friend class TripletAssembler;
+  template <typename, typename, template <typename ...> typename> friend class ScatterAssembler;
+  template <typename, typename, template <typename ...> typename> friend class MappedSymmetricMatrix;
+
+  std::shared_ptr<const Structure<I, V>> m_structure; // The symbolic structure, possibly shared
+  I m_n;     // System size
+  const typename Structure<I, V>::Indices &m_ik; // Index offsets to top of skylines
+  const typename Structure<I, V>::Indices &m_im; // Minimum row, or top of skyline
+#ifndef SKYLINE_MULTIPLE_ARRAY
+  V<R> m_am; // The entire matrix in one vector, first the diagonal, then the rest
+#else
+  V<R> m_au; // Upper triangular part of matrix
+  V<R> m_ad; // Diagonal of matrix
+#endif
+  V<R> m_v;  // Temporary used in solution
+  const typename Structure<I, V>::Indices &m_ir; // Offsets into m_kr for each row, n + 1 entries
+  const typename Structure<I, V>::Indices &m_kr; // Columns whose skyline reaches each row, in increasing order by row
+  const typename Structure<I, V>::Indices &m_et; // Elimination tree, the first column that reaches each row or n
+  const V<I> &m_pb; // Beginning and end of each panel
+  const typename Structure<I, V>::Indices &m_fl; // Offsets into m_fr for each forward substitution level
+  const typename Structure<I, V>::Indices &m_fr; // Rows in order by forward substitution level
+  const typename Structure<I, V>::Indices &m_bl; // Offsets into m_br for each back substitution level
+  const typename Structure<I, V>::Indices &m_br; // Rows in order by back substitution level
+  V<R> m_vb; // Temporary used in the blocked factorization, one v for each of the four pivots
+  bool m_blocked{ true }; // Factor panels four pivots at a time
+  std::shared_ptr<ThreadPool> m_pool; // Threads for the factorization, none if it is serial
+  V<I> m_tp; // Split of each step's column updates among the threads, threads + 1 entries per step
+  V<I> m_sf; // Split of each forward substitution level among the threads, threads + 1 entries each
+  V<I> m_sb; // Split of each back substitution level among the threads, threads + 1 entries each
+  V<I> m_tm; // Split of the columns of a product among the threads, threads + 1 entries
+  V<I> m_ts; // Top row reached by the columns of each thread
+  V<I> m_so; // Offsets into the spills of a product for each thread
+  bool m_split_forward{ false }; // Some forward substitution level is split among the threads
+  bool m_split_back{ false };    // Some back substitution level is split among the threads
+  bool m_factored{ false }; // The factors are in place of the values
+  I m_dirty{ 0 }; // First column changed since the last factorization
+  bool m_track{ false }; // Keep the values to refactor only the changed columns
+  V<R> m_original; // The values when tracking, in the order of index()
+  // Steps with fewer flops than this are not split among threads
+  static constexpr double parallel_work = 4096.0;
+
+  // The allocator for the vectors of other types that are kept with the values
+  template <typename T> using rebind_alloc = typename std::allocator_traits<allocator_type>::template rebind_alloc<T>;
+
+  // The height of each skyline of a dense matrix, which must be symmetric
+  static V<I> dense_heights(const V<V<R>> &M)
+  {
+    I n = M.size();
+    for (auto &v : M) {
+      n = std::min(n, (I)v.size());
+    }
+    V<I> heights(n);
+    for (I i = 0; i < n; i++) {
+      heights[i] = i;
+      for (I j = 0; j < i; j++) {
+        if (M[i][j] != 0.0) {
+          break;
+        }
+        --heights[i];
+      }
+    }
+    return heights;
+  }
+
+  // Storage of the diagonal and upper triangle, independent of the layout. The solver
+  // kernels work on contiguous segments, so V must store its elements contiguously.
+  R *diagonal_data()
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data();
+#else
+    return m_ad.data();
+#endif
+  }
+
+  const R *diagonal_data() const
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data();
+#else
+    return m_ad.data();
+#endif
+  }
+
+  R *upper_data()
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data() + m_n;
+#else
+    return m_au.data();
+#endif
+  }
+
+  const R *upper_data() const
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data() + m_n;
+#else
+    return m_au.data();
+#endif
+  }
+
+  // Apply a one vector operation to each right hand side of an interleaved block in turn, for
+  // the matrices that have no block version
+  template <typename F> static void each_rhs(V<R> &b, I n, I nrhs, F f)
+  {
+    V<R> x(n);
+    for (I r = 0; r < nrhs; ++r) {
+      for (I i = 0; i < n; ++i) {
+        x[i] = b[nrhs * i + r];
+      }
+      f(x);
+      for (I i = 0; i < n; ++i) {
+        b[nrhs * i + r] = x[i];
+      }
+    }
+  }
+
+  // Record a change to column k
+  void changed(I k)
+  {
+    m_dirty = std::min(m_dirty, k);
+  }
+
+  // Whether every pivot of the factors is finite and not zero
+  bool finite_pivots() const
+  {
+    const R *ad = diagonal_data();
+    return std::all_of(ad, ad + m_n, [](R d) { return std::isfinite(d) && d != 0.0; });
+  }
+
+  // The column that holds the given offset into the upper triangle, the last one that starts
+  // at or before it
+  I column(I offset) const
+  {
+    I first = 0;
+    I count = m_n;
+    while (count > 0) {
+      I half = count / 2;
+      if (m_ik[first + half] <= offset) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return first - 1;
+  }
+
+  // Call step(j, block) for the pivots from c on, block being true for the first of four
+  // pivots of a panel that are done together
+  template <typename F> void each_pivot(I c, F step) const
+  {
+    I j = c;
+    if (m_blocked) {
+      for (I p = 0; p < m_pb.size(); p += 2) {
+        if (m_pb[p + 1] <= j) {
+          continue;
+        }
+        // Blocks keep to the same four columns whatever pivot the factorization starts from
+        I b = j > m_pb[p] ? std::min(m_pb[p + 1], m_pb[p] + (j - m_pb[p] + 3) / 4 * 4) : m_pb[p];
+        for (; j < b; ++j) {
+          step(j, false);
+        }
+        for (; j + 4 <= m_pb[p + 1]; j += 4) {
+          step(j, true);
+        }
+      }
+    }
+    for (; j < m_n; ++j) {
+      step(j, false);
+    }
+  }
+
+  // The serial factorization from pivot c on, the pivots before c have already been done
+  void factor(I c)
+  {
+    each_pivot(c, [&](I j, bool block) { block ? pivot_block(j) : pivot(j); });
+  }
+
+  // Finish the factorization when only the columns from c on have their original values. The
+  // rows above c that these columns reach still have to be applied to them, then the rest is
+  // the usual factorization from pivot c. With threads, the columns of each row that has
+  // enough work are split evenly, and the rest is done by utdu_parallel().
+  void resume(I c)
+  {
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    R *v = m_v.data();
+    I top = c;
+    for (I k = c; k < m_n; ++k) {
+      top = std::min(top, m_im[k]);
+    }
+    // Fill v from the factored column j and find the first entry of row j's reach list at c
+    auto row = [&](I j) {
+      for (I i = m_im[j]; i < j; ++i) {
+        v[i] = au[m_ik[j] + i - m_im[j]] * ad[i]; // OK, i >= m_im[j]
+      }
+    };
+    auto first = [&](I j) -> I {
+      I r = m_ir[j];
+      I count = m_ir[j + 1] - r;
+      while (count > 0) {
+        I half = count / 2;
+        if (m_kr[r + half] < c) {
+          r += half + 1;
+          count -= half + 1;
+        } else {
+          count = half;
+        }
+      }
+      return r;
+    };
+    if (!m_pool) {
+      for (I j = top; j < c; ++j) {
+        row(j);
+        pivot_row(j, first(j), m_ir[j + 1]);
+      }
+      factor(c);
+      return;
+    }
+    unsigned nt = m_pool->size();
+    m_pool->run([&](unsigned t) {
+      for (I j = top; j < c; ++j) {
+        I r = first(j);
+        I count = m_ir[j + 1] - r;
+        if (2.0 * count * (j - m_im[j]) < parallel_work) {
+          if (t == 0) {
+            row(j);
+            pivot_row(j, r, m_ir[j + 1]);
+          }
+          continue;
+        }
+        if (t == 0) {
+          row(j);
+        }
+        m_pool->barrier();
+        pivot_row(j, r + count * t / nt, r + count * (t + 1) / nt);
+        m_pool->barrier();
+      }
+    });
+    utdu_parallel(c);
+  }
+
+  // The pivot step for row j: compute v and the diagonal, then the rest of the row
+  void pivot(I j)
+  {
+    pivot_diagonal(j);
+    pivot_row(j, m_ir[j], m_ir[j + 1]);
+  }
+
+  // Compute v and the diagonal term for pivot j
+  void pivot_diagonal(I j)
+  {
+    R *ad = diagonal_data();
+    const R *au = upper_data();
+    R *v = m_v.data();
+    const R *aj = au + m_ik[j]; // Column j, starting at row m_im[j]
+    for (I i = m_im[j]; i < j; ++i) {
+      v[i] = aj[i - m_im[j]] * ad[i]; // OK, i >= m_im[j]
+    }
+    ad[j] -= kernels::dot(aj, v + m_im[j], j - m_im[j]);
+  }
+
+  // Compute row j of the columns in entries first through last - 1 of its reach list. Each
+  // column is written once, so separate ranges can be done at the same time.
+  void pivot_row(I j, I first, I last)
+  {
+    const R *ad = diagonal_data();
+    R *au = upper_data();
+    const R *v = m_v.data();
+    for (I r = first; r < last; ++r) {
+      I k = m_kr[r];
+      // Only the overlap of the two skylines contributes, m_v is not defined above m_im[j]
+      I i0 = std::max(m_im[k], m_im[j]);
+      R *ak = au + m_ik[k] + i0 - m_im[k]; // OK, i0 >= m_im[k]
+      ak[j - i0] = (ak[j - i0] - kernels::dot(ak, v + i0, j - i0)) / ad[j];
+    }
+  }
+
+  // The pivot steps for rows j0 through j0 + 3. The contributions of the rows above j0 to
+  // every element the four rows touch are done first, four columns at a time with the
+  // register blocked kernel. The rows are then finished one by one with what is left, the
+  // contributions of the rows inside the block.
+  void pivot_block(I j0)
+  {
+    pivot_block_head(j0);
+    pivot_block_columns(j0, m_ir[j0 + 3], m_ir[j0 + 4]);
+  }
+
+  // The part of a block step that has to be done first and in order: v for each pivot, then
+  // the block's own four columns, which gives the four diagonal terms
+  void pivot_block_head(I j0)
+  {
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    I j1 = j0 + 4;
+    I lowest = j0;
+    for (I k = j0; k < j1; ++k) {
+      lowest = std::min(lowest, m_im[k]);
+    }
+    for (I r = m_ir[j1 - 1]; r < m_ir[j1]; ++r) {
+      lowest = std::min(lowest, m_im[m_kr[r]]);
+    }
+    // Compute v for each pivot, padded with zeros up to the highest row any column reaches
+    for (I p = 0; p < 4; ++p) {
+      I j = j0 + p;
+      R *w = m_vb.data() + p * m_n;
+      for (I i = lowest; i < m_im[j]; ++i) {
+        w[i] = 0.0;
+      }
+      for (I i = m_im[j]; i < j0; ++i) {
+        w[i] = au[m_ik[j] + i - m_im[j]] * ad[i]; // OK, i >= m_im[j]
+      }
+    }
+    I kq[4] = { j0, j0 + 1, j0 + 2, j0 + 3 };
+    block_update(j0, kq, 4);
+    // Finish the rows in order, at most three rows inside the block remain in each product
+    for (I p = 0; p < 4; ++p) {
+      I j = j0 + p;
+      R *w = m_vb.data() + p * m_n;
+      for (I i = std::max(m_im[j], j0); i < j; ++i) {
+        w[i] = au[m_ik[j] + i - m_im[j]] * ad[i]; // OK, i >= m_im[j]
+        ad[j] -= au[m_ik[j] + i - m_im[j]] * w[i];
+      }
+      for (I k = j + 1; k < j1; ++k) {
+        if (m_im[k] <= j) {
+          block_finish(j0, p, k);
+        }
+      }
+    }
+  }
+
+  // The rest of a block step for the columns in entries first through last - 1 of the reach
+  // list of the block's last row. Each column is written once, so separate ranges can be done
+  // at the same time, but the groups of four should line up with the start of the list.
+  void pivot_block_columns(I j0, I first, I last)
+  {
+    for (I r = first; r < last; r += 4) {
+      I nq = std::min((I)4, last - r);
+      I kq[4];
+      for (I q = 0; q < nq; ++q) {
+        kq[q] = m_kr[r + q];
+      }
+      block_update(j0, kq, nq);
+      for (I q = 0; q < nq; ++q) {
+        for (I p = 0; p < 4; ++p) {
+          if (m_im[kq[q]] <= j0 + p) {
+            block_finish(j0, p, kq[q]);
+          }
+        }
+      }
+    }
+  }
+
+  // Subtract the contributions of the rows above j0 from rows j0 through j0 + 3 of the nq
+  // columns in kq, using the register blocked kernel for the rows all of them reach
+  void block_update(I j0, const I *kq, I nq)
+  {
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    const R *w[4] = { m_vb.data(), m_vb.data() + m_n, m_vb.data() + 2 * m_n, m_vb.data() + 3 * m_n };
+    I common = 0;
+    for (I q = 0; q < nq; ++q) {
+      common = std::max(common, m_im[kq[q]]);
+    }
+    R out[16];
+    if (nq == 4 && common + kernels::minimum_length <= j0) {
+      const R *aq[4];
+      for (I q = 0; q < 4; ++q) {
+        aq[q] = au + m_ik[kq[q]] + common - m_im[kq[q]]; // OK, common >= m_im[k]
+      }
+      const R *wq[4] = { w[0] + common, w[1] + common, w[2] + common, w[3] + common };
+      kernels::dot4x4(wq, aq, j0 - common, out);
+    } else {
+      std::fill(out, out + 16, (R)0.0);
+      common = j0;
+    }
+    for (I q = 0; q < nq; ++q) {
+      I k = kq[q];
+      // Whatever the tile did not cover
+      const R *ak = au + m_ik[k] - m_im[k]; // Only dereferenced at rows >= m_im[k]
+      for (I i = m_im[k]; i < std::min(common, j0); ++i) {
+        for (I p = 0; p < 4; ++p) {
+          out[4 * p + q] += w[p][i] * ak[i];
+        }
+      }
+      for (I p = 0; p < 4; ++p) {
+        I j = j0 + p;
+        if (k == j) {
+          ad[j] -= out[4 * p + q];
+        } else if (k > j && m_im[k] <= j) {
+          au[m_ik[k] + j - m_im[k]] -= out[4 * p + q];
+        }
+      }
+    }
+  }
+
+  // Finish element (j0 + p, k) with the contributions of the rows inside the block
+  void block_finish(I j0, I p, I k)
+  {
+    const R *ad = diagonal_data();
+    R *ak = upper_data() + m_ik[k] - m_im[k]; // Only dereferenced at rows >= m_im[k]
+    const R *w = m_vb.data() + p * m_n;
+    I j = j0 + p;
+    R value = ak[j];
+    for (I i = std::max(m_im[k], j0); i < j; ++i) {
+      value -= ak[i] * w[i];
+    }
+    ak[j] = value / ad[j];
+  }
+
+  // The forward substitution a level at a time, with the rows of the wide levels split among
+  // the threads. The narrow levels are done by thread 0 alone, and the threads only wait for
+  // each other around the levels that are split.
+  void forward_levels(V<R> &b) const
+  {
+    const R *au = upper_data();
+    unsigned nt = m_pool->size();
+    m_pool->run([&](unsigned t) {
+      auto rows = [&](I first, I last) {
+        for (I r = first; r < last; ++r) {
+          I i = m_fr[r];
+          b[i] -= kernels::dot(au + m_ik[i], b.data() + m_im[i], i - m_im[i]);
+        }
+      };
+      bool alone = false; // Thread 0 has done levels alone since the last wait
+      for (I l = 0; l + 1 < m_fl.size(); ++l) {
+        const I *part = m_sf.data() + l * (nt + 1);
+        if (part[1] == part[nt]) {
+          if (t == 0) {
+            rows(part[0], part[nt]);
+          }
+          alone = true;
+          continue;
+        }
+        if (alone) {
+          m_pool->barrier();
+          alone = false;
+        }
+        rows(part[t], part[t + 1]);
+        m_pool->barrier();
+      }
+    });
+  }
+
+  // The back substitution a level at a time. Two columns in the same level never update the
+  // same row: if the lower one reached into the other it would be in a later level.
+  void back_levels(V<R> &z) const
+  {
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    for (I j = 0; j < m_n; ++j) {
+      z[j] /= ad[j];
+    }
+    unsigned nt = m_pool->size();
+    m_pool->run([&](unsigned t) {
+      auto rows = [&](I first, I last) {
+        for (I r = first; r < last; ++r) {
+          I j = m_br[r];
+          kernels::axpy(-z[j], au + m_ik[j], z.data() + m_im[j], j - m_im[j]);
+        }
+      };
+      bool alone = false;
+      for (I l = 0; l + 1 < m_bl.size(); ++l) {
+        const I *part = m_sb.data() + l * (nt + 1);
+        if (part[1] == part[nt]) {
+          if (t == 0) {
+            rows(part[0], part[nt]);
+          }
+          alone = true;
+          continue;
+        }
+        if (alone) {
+          m_pool->barrier();
+          alone = false;
+        }
+        rows(part[t], part[t + 1]);
+        m_pool->barrier();
+      }
+    });
+  }
+
+  // y += alpha*Ax for columns first through last - 1. Rows above first go to spill instead,
+  // which holds rows top through first - 1.
+  void multiply_columns(const R *x, R *y, R alpha, I first, I last, R *spill, I top) const
+  {
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    if (m_track && m_factored) {
+      ad = m_original.data();
+      au = ad + m_n;
+    }
+    for (I k = first; k < last; ++k) {
+      const R *ak = au + m_ik[k];
+      I m = m_im[k];
+      R ax = alpha * x[k];
+      R sum = ad[k] * x[k];
+      if (m < first) {
+        sum += kernels::dot_axpy(ak, x + m, ax, spill + m - top, first - m);
+        ak += first - m;
+        m = first;
+      }
+      sum += kernels::dot_axpy(ak, x + m, ax, y + m, k - m);
+      y[k] += alpha * sum;
+    }
+  }
+
+  void multiply_add(const R *x, R *y, R alpha) const
+  {
+    if (m_tm.empty()) {
+      multiply_columns(x, y, alpha, 0, m_n, nullptr, 0);
+      return;
+    }
+    // Each thread writes the rows of its own columns and spills the rest, then adds up the
+    // spills that land in its rows. The spills are made for each product, so that the matrix
+    // isn't written.
+    unsigned nt = m_pool->size();
+    V<R> spills(m_so[nt], R(0), get_allocator());
+    m_pool->run([&](unsigned t) {
+      I top = m_ts[t];
+      R *spill = spills.data() + m_so[t];
+      multiply_columns(x, y, alpha, m_tm[t], m_tm[t + 1], spill, top);
+      m_pool->barrier();
+      for (unsigned s = t + 1; s < nt; ++s) {
+        I first = std::max(m_tm[t], m_ts[s]);
+        I last = std::min(m_tm[t + 1], m_tm[s]);
+        const R *other = spills.data() + m_so[s] - m_ts[s];
+        for (I i = first; i < last; ++i) {
+          y[i] += other[i];
+        }
+      }
+    });
+  }
+
+  // Whether compressed sparse row arrays have a row for each column and enough indices and
+  // values for their last offset
+  bool fits_compressed(const V<I> &offsets, const V<I> &indices, const V<R> &values) const
+  {
+    return offsets.size() == m_n + 1 && offsets[m_n] <= indices.size() && offsets[m_n] <= values.size();
+  }
+
+  // Call f(first, last) for ranges of the rows of a compressed sparse row matrix, one per
+  // thread with about the same number of entries
+  template <typename F> void each_row(const V<I> &offsets, F f) const
+  {
+    I n = offsets.size() - 1;
+    if (!m_pool || offsets[n] < parallel_work) {
+      f(0, n);
+      return;
+    }
+    I nt = m_pool->size();
+    m_pool->run([&](unsigned t) {
+      I first = std::lower_bound(offsets.begin(), offsets.end(), offsets[n] / nt * t) - offsets.begin();
+      I last = t + 1 == nt ? n : std::lower_bound(offsets.begin(), offsets.end(), offsets[n] / nt * (t + 1)) - offsets.begin();
+      f(std::min(first, n), std::min(last, n));
+    });
+  }
+
+  // Call f(first, last) for slices of the right hand sides, one per thread. The slices are a
+  // multiple of eight wide to keep the threads off each other's cache lines. Without threads,
+  // or with too few right hand sides to go around, there is one slice.
+  template <typename F> void each_slice(I nrhs, F f) const
+  {
+    if (!m_pool || nrhs < 16) {
+      f(0, nrhs);
+      return;
+    }
+    I nt = m_pool->size();
+    I width = ((nrhs + nt - 1) / nt + 7) / 8 * 8;
+    m_pool->run([&](unsigned t) {
+      I first = std::min(nrhs, t * width);
+      I last = std::min(nrhs, first + width);
+      if (first < last) {
+        f(first, last);
+      }
+    });
+  }
+
+  // The factorization on all threads of the pool. Each step that is big enough has a serial
+  // part on thread 0, then the columns it updates are split up according to the schedule.
+  // The threads wait for each other after both parts. Small steps are done by thread 0 alone,
+  // the other threads skip ahead and wait for it at the next shared step. The pivots before c
+  // have already been done.
+  void utdu_parallel(I c = 0)
+  {
+    unsigned nt = m_pool->size();
+    m_pool->run([&](unsigned t) {
+      auto step = [&](I j, bool block) {
+        const I *part = m_tp.data() + j * (nt + 1);
+        if (part[1] == part[nt]) {
+          if (t == 0) {
+            block ? pivot_block(j) : pivot(j);
+          }
+          return;
+        }
+        if (t == 0) {
+          block ? pivot_block_head(j) : pivot_diagonal(j);
+        }
+        m_pool->barrier();
+        block ? pivot_block_columns(j, part[t], part[t + 1]) : pivot_row(j, part[t], part[t + 1]);
+        m_pool->barrier();
+      };
+      each_pivot(c, step);
+    });
+  }
+
+  // Split the column updates of each step among the threads so that each gets about the same
+  // number of flops. Steps with too little work to be worth a wait go to thread 0.
+  void schedule()
+  {
+    m_tp.clear();
+    m_sf.clear();
+    m_sb.clear();
+    m_tm.clear();
+    m_ts.clear();
+    m_so.clear();
+    m_split_forward = false;
+    m_split_back = false;
+    if (!m_pool) {
+      return;
+    }
+    unsigned nt = m_pool->size();
+    m_tp.resize(m_n * (nt + 1));
+    // Split entries first through last - 1 of a list, true if more than one thread gets some
+    auto split = [&](I *part, I first, I last, I group, auto work) {
+      double total = 0.0;
+      for (I r = first; r < last; ++r) {
+        total += work(r);
+      }
+      part[0] = first;
+      I r = first;
+      double sum = 0.0;
+      for (unsigned t = 1; t < nt; ++t) {
+        while (total >= parallel_work && r < last && sum < total * t / nt) {
+          for (I e = std::min(last, r + group); r < e; ++r) {
+            sum += work(r);
+          }
+        }
+        part[t] = total >= parallel_work ? r : last;
+      }
+      part[nt] = last;
+      return part[1] != part[nt];
+    };
+    for (I j = 0; j < m_n; ++j) {
+      split(m_tp.data() + j * (nt + 1), m_ir[j], m_ir[j + 1], 1,
+        [&](I r) { return 2.0 * (j - std::max(m_im[m_kr[r]], m_im[j])) + 1.0; });
+    }
+    if (m_blocked) {
+      for (I p = 0; p < m_pb.size(); p += 2) {
+        for (I j = m_pb[p]; j + 4 <= m_pb[p + 1]; j += 4) {
+          split(m_tp.data() + j * (nt + 1), m_ir[j + 3], m_ir[j + 4], 4,
+            [&](I r) { return 8.0 * (j - std::min(j, m_im[m_kr[r]])) + 16.0; });
+        }
+      }
+    }
+    // The rows of each level of the substitutions
+    I levels = m_fl.size() - 1;
+    m_sf.resize(levels * (nt + 1));
+    for (I l = 0; l < levels; ++l) {
+      m_split_forward |= split(m_sf.data() + l * (nt + 1), m_fl[l], m_fl[l + 1], 1,
+        [&](I r) { return 2.0 * (m_fr[r] - m_im[m_fr[r]]) + 1.0; });
+    }
+    levels = m_bl.size() - 1;
+    m_sb.resize(levels * (nt + 1));
+    for (I l = 0; l < levels; ++l) {
+      m_split_back |= split(m_sb.data() + l * (nt + 1), m_bl[l], m_bl[l + 1], 1,
+        [&](I r) { return 2.0 * (m_br[r] - m_im[m_br[r]]) + 1.0; });
+    }
+    // The columns of a product
+    m_tm.resize(nt + 1);
+    if (!split(m_tm.data(), 0, m_n, 1, [&](I k) { return 4.0 * (k - m_im[k]) + 1.0; })) {
+      m_tm.clear();
+      return;
+    }
+    m_ts.resize(nt);
+    m_so.resize(nt + 1);
+    m_so[0] = 0;
+    for (unsigned t = 0; t < nt; ++t) {
+      m_ts[t] = m_tm[t];
+      for (I k = m_tm[t]; k < m_tm[t + 1]; ++k) {
+        m_ts[t] = std::min(m_ts[t], m_im[k]);
+      }
+      m_so[t + 1] = m_so[t] + m_tm[t] - m_ts[t];
+    }
+  }
+};
+
+template <typename I, typename R, template <typename ...> typename V> class SymmetricSkipMatrix : public SymmetricMatrix<I, R, V>
+{
+public:
+
+  SymmetricSkipMatrix(V<V<R>>& M) : SymmetricMatrix<I, R, V>(M)
+  {
+    m_skip.resize(this->m_n);
+    m_ip.resize(this->m_n);
+    for (I k = 0; k < this->m_n; ++k) {
+      m_skip[k] = false;
+      m_ip[k] = k;
+    }
+    m_locked = false;
+    m_n_actual = this->m_n;
+  }
+
+  SymmetricSkipMatrix(V<I>& heights) : SymmetricMatrix<I, R, V>(heights)
+  {
+    m_skip.resize(this->m_n);
+    m_ip.resize(this->m_n);
+    I current = 0;
+    for (I k = 0; k < this->m_n; ++k) {
+      m_skip[k] = false;
+      m_ip[k] = k;
+    }
+    m_locked = false;
+    m_n_actual = this->m_n;
+  }
+
+  bool utdu()
+  {
+    // Work in the original numbering, pivoting only on the rows and columns that are not skipped
+    for (I jj = 0; jj < m_n_actual; ++jj) {
+      I j = m_ip[jj];
+      // Compute v and the diagonal term, skipped rows contribute nothing
+      R value = 0.0;
+      for (I i = this->m_im[j]; i < j; ++i) {
+        if (m_skip[i]) {
+          this->m_v[i] = 0.0;
+          continue;
+        }
+#ifndef SKYLINE_MULTIPLE_ARRAY
+        R aij = this->m_am[this->m_n + this->m_ik[j] + i - this->m_im[j]]; // OK, i >= m_im[j]
+        this->m_v[i] = aij * this->m_am[i];
+#else
+        R aij = this->m_au[this->m_ik[j] + i - this->m_im[j]]; // OK, i >= m_im[j]
+        this->m_v[i] = aij * this->m_ad[i];
+#endif
+        value += aij * this->m_v[i];
+      }
+#ifndef SKYLINE_MULTIPLE_ARRAY
+      this->m_am[j] -= value;
+#else
+      this->m_ad[j] -= value;
+#endif
+      // Compute the rest of the row, visiting only the columns that reach it
+      for (I r = this->m_ir[j]; r < this->m_ir[j + 1]; ++r) {
+        I k = this->m_kr[r];
+        if (m_skip[k]) {
+          continue;
+        }
+        value = 0.0;
+#ifndef SKYLINE_MULTIPLE_ARRAY
+        for (I i = std::max(this->m_im[k], this->m_im[j]); i < j; ++i) {
+          I ij = this->m_n + this->m_ik[k] + i - this->m_im[k]; // OK, i >= m_im[k]
+          value += this->m_am[ij] * this->m_v[i];
+        }
+        I ij = this->m_n + this->m_ik[k] + j - this->m_im[k]; // OK, j >= m_im[k]
+        this->m_am[ij] = (this->m_am[ij] - value) / this->m_am[j];
+#else
+        for (I i = std::max(this->m_im[k], this->m_im[j]); i < j; ++i) {
+          I ij = this->m_ik[k] + i - this->m_im[k]; // OK, i >= m_im[k]
+          value += this->m_au[ij] * this->m_v[i];
+        }
+        I ij = this->m_ik[k] + j - this->m_im[k]; // OK, j >= m_im[k]
+        this->m_au[ij] = (this->m_au[ij] - value) / this->m_ad[j];
+#endif
+      }
+    }
+    const R *ad = this->diagonal_data();
+    for (I jj = 0; jj < m_n_actual; ++jj) {
+      if (!std::isfinite(ad[m_ip[jj]]) || ad[m_ip[jj]] == 0.0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void forward_substitution(V<R>& b) const
+  {
+    // Solve Lz=b (Dy=z, Ux=y)
+    for (I ii = 1; ii < m_n_actual; ++ii) {
+      I i = m_ip[ii];
+      R value = 0.0;
+      for (I k = this->m_im[i]; k < i; ++k) {
+        if (m_skip[k]) {
+          continue;
+        }
+#ifndef SKYLINE_MULTIPLE_ARRAY
+        I ij = this->m_n + this->m_ik[i] + k - this->m_im[i];
+        value += this->m_am[ij] * b[k];
+#else
+        I ij = this->m_ik[i] + k - this->m_im[i];
+        value += this->m_au[ij] * b[k];
+#endif
+      }
+      b[i] -= value;
+    }
+  }
+
+  void back_substitution(V<R>& z) const
+  {
+    // Account for the diagonal first (invert Dy=z)
+    for (I jj = 0; jj < m_n_actual; ++jj) {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+      z[m_ip[jj]] /= this->m_am[m_ip[jj]];
+#else
+      z[m_ip[jj]] /= this->m_ad[m_ip[jj]];
+#endif
+    }
+    // Solve Ux=y
+    for (I jj = m_n_actual - 1; jj > 0; --jj) {
+      I j = m_ip[jj];
+      for (I k = this->m_im[j]; k < j; ++k) {
+        if (m_skip[k]) {
+          continue;
+        }
+#ifndef SKYLINE_MULTIPLE_ARRAY
+        I ij = this->m_n + this->m_ik[j] + k - this->m_im[j];
+        z[k] -= z[j] * this->m_am[ij];
+#else
+        I ij = this->m_ik[j] + k - this->m_im[j];
+        z[k] -= z[j] * this->m_au[ij];
+#endif
+      }
+    }
+  }
+
+  // The skipped rows are not accounted for in the reach, so this is the full substitution
+  V<I> sparse_forward_substitution(V<R> &b, const V<I> &) const
+  {
+    forward_substitution(b);
+    V<I> rows(this->m_n);
+    std::iota(rows.begin(), rows.end(), (I)0);
+    return rows;
+  }
+
+  void partial_back_substitution(V<R> &z, const V<I> &) const
+  {
+    back_substitution(z);
+  }
+
+  void forward_substitution(V<R>& b, I nrhs) const
+  {
+    this->each_rhs(b, this->m_n, nrhs, [this](V<R>& x) { forward_substitution(x); });
+  }
+
+  void back_substitution(V<R>& z, I nrhs) const
+  {
+    this->each_rhs(z, this->m_n, nrhs, [this](V<R>& x) { back_substitution(x); });
+  }
+
+  virtual bool ldlt_solve(V<R>& b)
+  {
+    lock();
+    bool good = utdu();
+    if (good) {
+      forward_substitution(b);
+      back_substitution(b);
+    }
+    unlock();
+    return good;
+  }
+
+  virtual bool ldlt_solve(V<R>& b, I nrhs)
+  {
+    lock();
+    bool good = utdu();
+    if (good) {
+      forward_substitution(b, nrhs);
+      back_substitution(b, nrhs);
+    }
+    unlock();
+    return good;
+  }
+
+  virtual bool utdu_solve(V<R>& b)
+  {
+    lock();
+    bool good = utdu();
+    if (good) {
+      forward_substitution(b);
+      back_substitution(b);
+    }
+    unlock();
+    return good;
+  }
+
+  bool skip(I i)
+  {
+    if (m_locked) {
+      return false;
+    }
+    m_skip[i] = !m_skip[i];
+    return true;
+  }
+
+  bool &skip(I i) const
+  {
+    return m_skip[i];
+  }
+
+  V<bool> skip()
+  {
+    return m_skip;
+  }
+
+  void unskip()
+  {
+    for (I i = 0; i < this->m_n; ++i) {
+      m_skip[i] = false;
+    }
+  }
+
+  V<I> ip()
+  {
+    return m_ip;
+  }
+
+  void lock()
+  {
+    if (m_locked) {
+      return;
+    }
+    I current = 0;
+    for (I i = 0; i < this->m_n; ++i) {
+      if (!m_skip[i]) {
+        m_ip[current] = i;
+        ++current;
+      }
+    }
+    m_n_actual = current;
+  }
+
+  void unlock()
+  {
+    m_locked = false;
+  }
+
+private:
+  bool m_locked;
+  V<bool> m_skip;
+  V<I> m_ip;
+  I m_n_actual;
+};
+
+// A matrix that is stored and factored with its rows and columns renumbered to reduce the
+// profile. Element access and the solves use the original numbering, the permutation is
+// applied on the way into the forward substitution and undone on the way out of the back
+// substitution, so the vector in between is in the new numbering.
+template <typename I, typename R, template <typename ...> typename V> class PermutedMatrix : public SymmetricMatrix<I, R, V>
+{
+public:
+
+  PermutedMatrix(const Graph<I, V> &graph, Ordering ordering = Ordering::RCM) : PermutedMatrix(graph, graph.order(ordering))
+  {}
+
+  PermutedMatrix(const Graph<I, V> &graph, const V<I> &permutation) :
+    SymmetricMatrix<I, R, V>(std::make_shared<const Structure<I, V>>(graph.heights(permutation))),
+    m_p(permutation), m_ip(Graph<I, V>::invert(permutation))
+  {}
+
+  PermutedMatrix(V<V<R>> &M, Ordering ordering = Ordering::RCM) : PermutedMatrix(Graph<I, V>::dense(M), ordering)
+  {
+    for (I i = 0; i < this->m_n; ++i) {
+      for (I j = 0; j <= i; ++j) {
+        if (i == j || M[i][j] != 0.0) {
+          (*this)(i, j) = M[i][j];
+        }
+      }
+    }
+  }
+
+  using SymmetricMatrix<I, R, V>::diagonal;
+
+  std::optional<I> index(I i, I j) const
+  {
+    return SymmetricMatrix<I, R, V>::index(m_ip[i], m_ip[j]);
+  }
+
+  R &operator()(I i, I j)
+  {
+    return SymmetricMatrix<I, R, V>::operator()(m_ip[i], m_ip[j]);
+  }
+
+  R &diagonal(I i)
+  {
+    return SymmetricMatrix<I, R, V>::diagonal(m_ip[i]);
+  }
+
+  // The new numbering, permutation()[new] = old
+  V<I> permutation() const
+  {
+    return m_p;
+  }
+
+  // The vectors are permuted through a local temporary, so that solves on the same factors can
+  // run at the same time
+  void forward_substitution(V<R> &b) const
+  {
+    V<R> w(this->m_n);
+    for (I k = 0; k < this->m_n; ++k) {
+      w[k] = b[m_p[k]];
+    }
+    std::copy(w.begin(), w.end(), b.begin());
+    SymmetricMatrix<I, R, V>::forward_substitution(b);
+  }
+
+  void back_substitution(V<R> &z) const
+  {
+    SymmetricMatrix<I, R, V>::back_substitution(z);
+    V<R> w(this->m_n);
+    for (I k = 0; k < this->m_n; ++k) {
+      w[m_p[k]] = z[k];
+    }
+    std::copy(w.begin(), w.end(), z.begin());
+  }
+
+  // The right hand side is given in the original numbering, the result and the rows reached
+  // are in the new numbering like the other forward substitution. Only the nonzeros are moved.
+  V<I> sparse_forward_substitution(V<R> &b, const V<I> &nonzeros) const
+  {
+    V<I> rows(nonzeros.size());
+    V<R> values(nonzeros.size());
+    for (I p = 0; p < nonzeros.size(); ++p) {
+      rows[p] = m_ip[nonzeros[p]];
+      values[p] = b[nonzeros[p]];
+      b[nonzeros[p]] = 0.0;
+    }
+    for (I p = 0; p < rows.size(); ++p) {
+      b[rows[p]] = values[p];
+    }
+    return SymmetricMatrix<I, R, V>::sparse_forward_substitution(b, rows);
+  }
+
+  // The rows are in the original numbering, and so is the result for them
+  void partial_back_substitution(V<R> &z, const V<I> &rows) const
+  {
+    V<I> permuted(rows.size());
+    for (I p = 0; p < rows.size(); ++p) {
+      permuted[p] = m_ip[rows[p]];
+    }
+    SymmetricMatrix<I, R, V>::partial_back_substitution(z, permuted);
+    V<R> values(rows.size());
+    for (I p = 0; p < rows.size(); ++p) {
+      values[p] = z[permuted[p]];
+    }
+    for (I p = 0; p < rows.size(); ++p) {
+      z[rows[p]] = values[p];
+    }
+  }
+
+  // x and y are in the original numbering
+  void multiply_add(const V<R> &x, V<R> &y, R alpha = 1.0) const
+  {
+    I n = this->m_n;
+    V<R> w(2 * n);
+    for (I k = 0; k < n; ++k) {
+      w[k] = x[m_p[k]];
+    }
+    SymmetricMatrix<I, R, V>::multiply_add(w.data(), w.data() + n, alpha);
+    for (I k = 0; k < n; ++k) {
+      y[m_p[k]] += w[n + k];
+    }
+  }
+
+  void forward_substitution(V<R> &b, I nrhs) const
+  {
+    V<R> w(b.size());
+    for (I k = 0; k < this->m_n; ++k) {
+      std::copy_n(b.begin() + nrhs * m_p[k], nrhs, w.begin() + nrhs * k);
+    }
+    std::copy(w.begin(), w.end(), b.begin());
+    SymmetricMatrix<I, R, V>::forward_substitution(b, nrhs);
+  }
+
+  void back_substitution(V<R> &z, I nrhs) const
+  {
+    SymmetricMatrix<I, R, V>::back_substitution(z, nrhs);
+    V<R> w(z.size());
+    for (I k = 0; k < this->m_n; ++k) {
+      std::copy_n(z.begin() + nrhs * k, nrhs, w.begin() + nrhs * m_p[k]);
+    }
+    std::copy(w.begin(), w.end(), z.begin());
+  }
+
+private:
+  V<I> m_p;          // Old number of each row and column
+  V<I> m_ip;         // New number of each row and column
+};
+
+// Builds matrices from (i, j, value) triplets given in any order, without ever forming a dense
+// matrix. (i, j) and (j, i) are the same entry, and repeats are summed, so the contributions of
+// the elements of a finite element mesh can be added as they come. The heights are found in
+// one pass over the triplets and the values go straight into the skyline storage.
+template <typename I, typename R, template <typename ...> typename V> class TripletAssembler
+{
+public:
+
+  // An assembler for at least n unknowns, more if larger indices are added
+  TripletAssembler(I n = 0) : m_n(n)
+  {}
+
+  void reserve(I count)
+  {
+    m_i.reserve(count);
+    m_j.reserve(count);
+    m_v.reserve(count);
+  }
+
+  void add(I i, I j, R value)
+  {
+    if (i > j) {
+      std::swap(i, j);
+    }
+    m_i.push_back(i);
+    m_j.push_back(j);
+    m_v.push_back(value);
+    m_n = std::max(m_n, j + 1);
+  }
+
+  void clear()
+  {
+    m_i.clear();
+    m_j.clear();
+    m_v.clear();
+  }
+
+  // The number of unknowns
+  I size() const
+  {
+    return m_n;
+  }
+
+  // The number of triplets, counting repeats
+  I count() const
+  {
+    return m_v.size();
+  }
+
+  V<I> heights() const
+  {
+    V<I> top(m_n);
+    std::iota(top.begin(), top.end(), (I)0);
+    for (I t = 0; t < m_v.size(); ++t) {
+      top[m_j[t]] = std::min(top[m_j[t]], m_i[t]);
+    }
+    for (I k = 0; k < m_n; ++k) {
+      top[k] = k - top[k];
+    }
+    return top;
+  }
+
+  std::shared_ptr<const Structure<I, V>> structure() const
+  {
+    return std::make_shared<const Structure<I, V>>(heights());
+  }
+
+  // The graph of the entries off the diagonal, for a PermutedMatrix or a
+  // ConjugateGradientMatrix
+  Graph<I, V> graph() const
+  {
+    V<V<I>> adjacency(m_n);
+    for (I t = 0; t < m_v.size(); ++t) {
+      if (m_i[t] != m_j[t]) {
+        adjacency[m_j[t]].push_back(m_i[t]);
+      }
+    }
+    return Graph<I, V>(adjacency);
+  }
+
+  SymmetricMatrix<I, R, V> matrix() const
+  {
+    SymmetricMatrix<I, R, V> matrix(structure());
+    assemble(matrix);
+    return matrix;
+  }
+
+  // Replace the values of a matrix with the sum of the triplets. The skyline must hold all
+  // of them, as it does if the matrix was built with structure() or has the same heights. A
+  // PermutedMatrix is filled in its own numbering.
+  template <typename M> void assemble(M &matrix) const
+  {
+    SymmetricMatrix<I, R, V> &base = matrix;
+    base.fill(0.0);
+    R *ad = base.diagonal_data();
+    R *au = base.upper_data();
+    for (I t = 0; t < m_v.size(); ++t) {
+      I ij = *matrix.index(m_i[t], m_j[t]);
+      if (ij < base.m_n) {
+        ad[ij] += m_v[t];
+      } else {
+        au[ij - base.m_n] += m_v[t];
+      }
+    }
+  }
+
+private:
+  I m_n;      // The number of unknowns
+  V<I> m_i;   // Row of each triplet, in the upper triangle
+  V<I> m_j;   // Column of each triplet
+  V<R> m_v;   // Value of each triplet
+};
+
+// How ScatterAssembler keeps the threads from adding to the same entry at the same time
+enum class Scatter { Colored, Private };
+
+// Adds the contributions of elements into a matrix from the matrix's threads. Each element is
+// given by the unknowns it touches, and contribution(e, add) calls add(i, j, value) for the
+// entries of element e, which go straight to storage through index(i, j). There are two ways
+// to keep the threads apart:
+//
+//   Colored: the elements are colored so that no two of the same color share an unknown, and
+//   the elements of each color are split among the threads with a barrier between colors.
+//
+//   Private: each thread takes a block of elements and keeps what they add in private
+//   buffers, one for the slice of the storage that each thread owns. After one barrier each
+//   thread adds up the buffers for its slice. The buffers hold the contributions rather than
+//   a copy of the storage, so they take no more memory than the elements give.
+//
+// The values are added to what is there. The matrix should not be factored unless it is
+// tracked, and then the values are added to the copy as element access would. For a
+// PermutedMatrix the unknowns are in its own numbering.
+template <typename I, typename R, template <typename ...> typename V> class ScatterAssembler
+{
+public:
+
+  // Adds to the storage of the matrix, or to the buffers of a thread
+  class Adder
+  {
+  public:
+    Adder(const SymmetricMatrix<I, R, V> &matrix, R *diagonal, R *upper) : m_matrix(matrix), m_diagonal(diagonal),
+      m_upper(upper)
+    {}
+
+    Adder(const SymmetricMatrix<I, R, V> &matrix, V<I> *slots, V<R> *values, I slice) : m_matrix(matrix),
+      m_slots(slots), m_values(values), m_slice(slice)
+    {}
+
+    void operator()(I i, I j, R value) const
+    {
+      I ij = *m_matrix.index(i, j);
+      if (m_slots) {
+        m_slots[ij / m_slice].push_back(ij);
+        m_values[ij / m_slice].push_back(value);
+      } else if (ij < m_matrix.rows()) {
+        m_diagonal[ij] += value;
+      } else {
+        m_upper[ij - m_matrix.rows()] += value;
+      }
+    }
+
+  private:
+    const SymmetricMatrix<I, R, V> &m_matrix;
+    R *m_diagonal{ nullptr };
+    R *m_upper{ nullptr };
+    V<I> *m_slots{ nullptr }; // For each owner, the entries to add to
+    V<R> *m_values{ nullptr }; // For each owner, the values to add
+    I m_slice{ 0 }; // Size of the slice of the storage each thread owns
+  };
+
+  // Color the elements greedily, each gets the first color not used by an element it shares
+  // an unknown with
+  ScatterAssembler(SymmetricMatrix<I, R, V> &matrix, const V<V<I>> &elements) : m_matrix(matrix),
+    m_count(elements.size()), m_first(matrix.rows())
+  {
+    V<I> color(m_count);
+    V<V<I>> used(matrix.rows()); // Colors of the elements that touch each unknown
+    V<bool> taken;
+    I colors = 0;
+    for (I e = 0; e < m_count; ++e) {
+      for (I i : elements[e]) {
+        for (I c : used[i]) {
+          taken[c] = true;
+        }
+      }
+      I c = std::find(taken.begin(), taken.end(), false) - taken.begin();
+      if (c == colors) {
+        ++colors;
+        taken.push_back(false);
+      }
+      color[e] = c;
+      std::fill(taken.begin(), taken.end(), false);
+      for (I i : elements[e]) {
+        used[i].push_back(c);
+        m_first = std::min(m_first, i);
+      }
+    }
+    // The elements in order by color
+    m_co.assign(colors + 1, 0);
+    for (I e = 0; e < m_count; ++e) {
+      ++m_co[color[e] + 1];
+    }
+    std::partial_sum(m_co.begin(), m_co.end(), m_co.begin());
+    m_ce.resize(m_count);
+    V<I> next(m_co.begin(), m_co.end() - 1);
+    for (I e = 0; e < m_count; ++e) {
+      m_ce[next[color[e]]++] = e;
+    }
+  }
+
+  I colors() const
+  {
+    return m_co.size() - 1;
+  }
+
+  template <typename F> void add(F contribution, Scatter scatter = Scatter::Colored)
+  {
+    SymmetricMatrix<I, R, V> &matrix = m_matrix;
+    I n = matrix.m_n;
+    R *ad = matrix.diagonal_data();
+    R *au = matrix.upper_data();
+    if (matrix.m_track && matrix.m_factored) {
+      ad = matrix.m_original.data();
+      au = ad + n;
+    }
+    matrix.changed(m_first);
+    Adder direct(matrix, ad, au);
+    if (!matrix.m_pool) {
+      for (I e = 0; e < m_count; ++e) {
+        contribution(e, direct);
+      }
+      return;
+    }
+    unsigned nt = matrix.m_pool->size();
+    if (scatter == Scatter::Colored) {
+      matrix.m_pool->run([&](unsigned t) {
+        for (I c = 0; c + 1 < m_co.size(); ++c) {
+          I size = m_co[c + 1] - m_co[c];
+          for (I p = m_co[c] + size * t / nt; p < m_co[c] + size * (t + 1) / nt; ++p) {
+            contribution(m_ce[p], direct);
+          }
+          matrix.m_pool->barrier();
+        }
+      });
+      return;
+    }
+    // Buffer nt*s + t holds what thread s adds to the slice of thread t
+    I slice = (n + matrix.m_structure->profile() + nt - 1) / nt;
+    m_slots.resize(nt * nt);
+    m_values.resize(nt * nt);
+    matrix.m_pool->run([&](unsigned t) {
+      for (unsigned s = 0; s < nt; ++s) {
+        m_slots[nt * t + s].clear();
+        m_values[nt * t + s].clear();
+      }
+      Adder adder(matrix, m_slots.data() + nt * t, m_values.data() + nt * t, slice);
+      for (I e = m_count * t / nt; e < m_count * (t + 1) / nt; ++e) {
+        contribution(e, adder);
+      }
+      matrix.m_pool->barrier();
+      for (unsigned s = 0; s < nt; ++s) {
+        const V<I> &slots = m_slots[nt * s + t];
+        const V<R> &values = m_values[nt * s + t];
+        for (I p = 0; p < slots.size(); ++p) {
+          if (slots[p] < n) {
+            ad[slots[p]] += values[p];
+          } else {
+            au[slots[p] - n] += values[p];
+          }
+        }
+      }
+    });
+  }
+
+private:
+  SymmetricMatrix<I, R, V> &m_matrix;
+  I m_count;  // The number of elements
+  I m_first;  // The first unknown any element touches
+  V<I> m_co;  // Offsets into m_ce for each color
+  V<I> m_ce;  // Elements in order by color
+  V<V<I>> m_slots;  // The entries each thread adds to in each slice in the private mode
+  V<V<R>> m_values; // The values each thread adds in each slice in the private mode
+};
+
+// A matrix with a symmetric skyline but values that need not be symmetric, factored as LDU with
+// L and U unit triangular. The lower triangle is stored row by row in the same way that the
+// upper triangle is stored column by column, so row k of L lines up with column k of U. There
+// is no pivoting, a zero pivot stops the factorization.
+template <typename I, typename R, template <typename ...> typename V> class NonsymmetricMatrix
+{
+public:
+
+  NonsymmetricMatrix(V<V<R>> &M) : NonsymmetricMatrix(std::make_shared<const Structure<I, V>>(dense_heights(M)))
+  {
+    // Copy the dense matrix into the skyline
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    R *al = lower_data();
+    for (I k = 0; k < m_n; k++) {
+      ad[k] = M[k][k];
+      for (I i = m_im[k]; i < k; i++) {
+        au[m_ik[k] + i - m_im[k]] = M[i][k];
+        al[m_ik[k] + i - m_im[k]] = M[k][i];
+      }
+    }
+  }
+
+  NonsymmetricMatrix(V<I> &heights) : NonsymmetricMatrix(std::make_shared<const Structure<I, V>>(heights))
+  {}
+
+  // A matrix of zeros with the given structure, which may be shared with other matrices
+  NonsymmetricMatrix(std::shared_ptr<const Structure<I, V>> structure) : m_structure(structure), m_n(structure->m_n),
+    m_ik(structure->m_ik), m_im(structure->m_im)
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    m_am.resize(m_n + 2 * structure->profile());
+#else
+    m_ad.resize(m_n);
+    m_au.resize(structure->profile());
+    m_al.resize(structure->profile());
+#endif
+    fill(0.0);
+  }
+
+  void fill(R v = 0.0)
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    std::fill(m_am.begin(), m_am.end(), v);
+#else
+    std::fill(m_ad.begin(), m_ad.end(), v);
+    std::fill(m_au.begin(), m_au.end(), v);
+    std::fill(m_al.begin(), m_al.end(), v);
+#endif
+  }
+
+  std::shared_ptr<const Structure<I, V>> structure() const
+  {
+    return m_structure;
+  }
+
+  V<I> offsets() const
+  {
+    return m_structure->offsets();
+  }
+
+  V<I> heights() const
+  {
+    return m_structure->heights();
+  }
+
+  V<I> minima() const
+  {
+    return m_structure->minima();
+  }
+
+  V<R> diagonal() const
+  {
+    return V<R>(diagonal_data(), diagonal_data() + m_n);
+  }
+
+  V<R> upper() const
+  {
+    return V<R>(upper_data(), upper_data() + m_structure->profile());
+  }
+
+  V<R> lower() const
+  {
+    return V<R>(lower_data(), lower_data() + m_structure->profile());
+  }
+
+  R &diagonal(I i)
+  {
+    return diagonal_data()[i];
+  }
+
+  // Index of element (i, j) in the combined storage: the diagonal comes first, then the upper
+  // triangle column by column, then the lower triangle row by row. Elements outside the
+  // skyline have no index.
+  std::optional<I> index(I i, I j) const
+  {
+    if (i == j) {
+      return i;
+    } else if (i < j) {
+      if (m_im[j] <= i) {
+        return m_n + m_ik[j] + i - m_im[j];
+      }
+    } else if (m_im[i] <= j) {
+      return m_n + m_structure->profile() + m_ik[i] + j - m_im[i];
+    }
+    return {};
+  }
+
+  // Element (i, j), which must be inside the skyline
+  R &operator()(I i, I j)
+  {
+    I ij = *index(i, j);
+    if (ij < m_n) {
+      return diagonal_data()[ij];
+    } else if (ij < m_n + m_structure->profile()) {
+      return upper_data()[ij - m_n];
+    }
+    return lower_data()[ij - m_n - m_structure->profile()];
+  }
+
+  // Factor the matrix in place. Column k of U and row k of L are computed together from the
+  // columns and rows before them, each element with one inner product. This stops and returns
+  // false if a pivot is zero or not finite, the factorization is then incomplete and can't be
+  // used.
+  bool ldu()
+  {
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    R *al = lower_data();
+    for (I k = 0; k < m_n; ++k) {
+      R *uk = au + m_ik[k] - m_im[k]; // Only dereferenced at rows >= m_im[k]
+      R *lk = al + m_ik[k] - m_im[k];
+      // Column k of DU and row k of LD, in place
+      for (I j = m_im[k] + 1; j < k; ++j) {
+        I i0 = std::max(m_im[j], m_im[k]);
+        const R *uj = au + m_ik[j] - m_im[j]; // Only dereferenced at rows >= m_im[j]
+        const R *lj = al + m_ik[j] - m_im[j];
+        uk[j] -= kernels::dot(lj + i0, uk + i0, j - i0);
+        lk[j] -= kernels::dot(uj + i0, lk + i0, j - i0);
+      }
+      // Scale by the diagonal and compute the pivot
+      R sum = 0.0;
+      for (I i = m_im[k]; i < k; ++i) {
+        R g = uk[i];
+        uk[i] = g / ad[i];
+        sum += uk[i] * lk[i];
+        lk[i] /= ad[i];
+      }
+      ad[k] -= sum;
+      if (!std::isfinite(ad[k]) || ad[k] == 0.0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  virtual void forward_substitution(V<R> &b) const
+  {
+    // Solve Lz=b (Dy=z, Ux=y)
+    const R *al = lower_data();
+    for (I i = 1; i < m_n; ++i) {
+      b[i] -= kernels::dot(al + m_ik[i], b.data() + m_im[i], i - m_im[i]);
+    }
+  }
+
+  virtual void back_substitution(V<R> &z) const
+  {
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    // Account for the diagonal first (invert Dy=z)
+    for (I j = 0; j < m_n; ++j) {
+      z[j] /= ad[j];
+    }
+    // Solve Ux=y
+    for (I j = m_n - 1; j > 0; --j) {
+      kernels::axpy(-z[j], au + m_ik[j], z.data() + m_im[j], j - m_im[j]);
+    }
+  }
+
+  // Factor and solve, b is only changed if the factorization succeeds
+  virtual bool ldu_solve(V<R> &b)
+  {
+    if (!ldu()) {
+      return false;
+    }
+    forward_substitution(b);
+    back_substitution(b);
+    return true;
+  }
+
+  I rows() const
+  {
+    return m_n;
+  }
+
+  I cols() const
+  {
+    return m_n;
+  }
+
+protected:
+
+  std::shared_ptr<const Structure<I, V>> m_structure; // The symbolic structure, possibly shared
+  I m_n;     // System size
+  const typename Structure<I, V>::Indices &m_ik; // Index offsets to top of skylines
+  const typename Structure<I, V>::Indices &m_im; // Minimum row, or top of skyline
+#ifndef SKYLINE_MULTIPLE_ARRAY
+  V<R> m_am; // The entire matrix in one vector, first the diagonal, then the upper, then the lower
+#else
+  V<R> m_au; // Upper triangular part of matrix
+  V<R> m_ad; // Diagonal of matrix
+  V<R> m_al; // Lower triangular part of matrix
+#endif
+
+  // The height of each skyline of a dense matrix, the larger of the row's and the column's
+  static V<I> dense_heights(const V<V<R>> &M)
+  {
+    I n = M.size();
+    for (auto &v : M) {
+      n = std::min(n, (I)v.size());
+    }
+    V<I> heights(n);
+    for (I i = 0; i < n; i++) {
+      I j = 0;
+      while (j < i && M[i][j] == 0.0 && M[j][i] == 0.0) {
+        ++j;
+      }
+      heights[i] = i - j;
+    }
+    return heights;
+  }
+
+  R *diagonal_data()
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data();
+#else
+    return m_ad.data();
+#endif
+  }
+
+  const R *diagonal_data() const
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data();
+#else
+    return m_ad.data();
+#endif
+  }
+
+  R *upper_data()
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data() + m_n;
+#else
+    return m_au.data();
+#endif
+  }
+
+  const R *upper_data() const
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data() + m_n;
+#else
+    return m_au.data();
+#endif
+  }
+
+  R *lower_data()
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data() + m_n + m_structure->profile();
+#else
+    return m_al.data();
+#endif
+  }
+
+  const R *lower_data() const
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data() + m_n + m_structure->profile();
+#else
+    return m_al.data();
+#endif
+  }
+};
+
+// A double precision matrix that is solved with a single precision factorization and iterative
+// refinement. The factors take half the memory and half the memory traffic, which is what the
+// factorization and the substitutions are limited by when the profile is large. The residual
+// is computed in double precision with the values, which are left as they are, and the
+// corrections are solved for with the single precision factors until the solution is as good
+// as a double precision solve would give. If that doesn't happen quickly, or the values don't
+// fit in single precision, the solve falls back to a double precision factorization.
+template <typename I, template <typename ...> typename V> class MixedPrecisionMatrix : public SymmetricMatrix<I, double, V>
+{
+public:
+
+  MixedPrecisionMatrix(V<V<double>> &M) : SymmetricMatrix<I, double, V>(M), m_low(this->m_structure)
+  {
+    allocate();
+  }
+
+  MixedPrecisionMatrix(V<I> &heights) : SymmetricMatrix<I, double, V>(heights), m_low(this->m_structure)
+  {
+    allocate();
+  }
+
+  MixedPrecisionMatrix(std::shared_ptr<const Structure<I, V>> structure) : SymmetricMatrix<I, double, V>(structure),
+    m_low(structure)
+  {
+    allocate();
+  }
+
+  // Factor a single precision copy, the values are kept for the residuals. If that fails, the
+  // values are factored in double precision and the result is whether that worked.
+  bool utdu()
+  {
+    const double *ad = this->diagonal_data();
+    const double *au = this->upper_data();
+    float *fd = m_low.diagonal_data();
+    float *fu = m_low.upper_data();
+    I profile = this->m_structure->profile();
+    for (I i = 0; i < this->m_n; ++i) {
+      fd[i] = (float)ad[i];
+    }
+    for (I i = 0; i < profile; ++i) {
+      fu[i] = (float)au[i];
+    }
+    // The infinity norm, for the stopping test
+    for (I i = 0; i < this->m_n; ++i) {
+      m_r[i] = std::abs(ad[i]);
+    }
+    for (I k = 1; k < this->m_n; ++k) {
+      for (I i = this->m_im[k]; i < k; ++i) {
+        double a = std::abs(au[this->m_ik[k] + i - this->m_im[k]]); // OK, i >= m_im[k]
+        m_r[i] += a;
+        m_r[k] += a;
+      }
+    }
+    m_norm = 0.0;
+    for (I i = 0; i < this->m_n; ++i) {
+      m_norm = std::max(m_norm, m_r[i]);
+    }
+    m_high.reset();
+    if (!m_low.utdu()) {
+      return fall_back();
+    }
+    return true;
+  }
+
+  // Solve with the factors from utdu, b is replaced by the solution. Returns false, leaving b
+  // alone, if the double precision factorization is needed and failed.
+  bool solve(V<double> &b)
+  {
+    m_iterations = 0;
+    if (m_high) {
+      if (!m_high_good) {
+        return false;
+      }
+      m_high->forward_substitution(b);
+      m_high->back_substitution(b);
+      return true;
+    }
+    I n = this->m_n;
+    double bnorm = 0.0;
+    for (I i = 0; i < n; ++i) {
+      m_x[i] = 0.0;
+      m_r[i] = b[i];
+      bnorm = std::max(bnorm, std::abs(b[i]));
+    }
+    double tolerance = std::numeric_limits<double>::epsilon() * std::sqrt((double)n);
+    double last = std::numeric_limits<double>::infinity();
+    while (m_iterations < maximum_iterations) {
+      ++m_iterations;
+      // Correct the solution with the single precision factors
+      for (I i = 0; i < n; ++i) {
+        m_f[i] = (float)m_r[i];
+      }
+      m_low.forward_substitution(m_f);
+      m_low.back_substitution(m_f);
+      double xnorm = 0.0;
+      for (I i = 0; i < n; ++i) {
+        m_x[i] += m_f[i];
+        xnorm = std::max(xnorm, std::abs(m_x[i]));
+      }
+      double rnorm = residual(b);
+      if (rnorm <= tolerance * (m_norm * xnorm + bnorm)) {
+        std::copy(m_x.begin(), m_x.end(), b.begin());
+        return true;
+      }
+      // Each step should cut the residual down by a good amount, if not give up
+      if (!std::isfinite(rnorm) || rnorm > 0.5 * last) {
+        break;
+      }
+      last = rnorm;
+    }
+    if (!fall_back()) {
+      return false;
+    }
+    m_high->forward_substitution(b);
+    m_high->back_substitution(b);
+    return true;
+  }
+
+  // Factor and solve, returning false and leaving b alone if neither precision works
+  bool ldlt_solve(V<double> &b)
+  {
+    return utdu() && solve(b);
+  }
+
+  bool utdu_solve(V<double> &b)
+  {
+    return ldlt_solve(b);
+  }
+
+  // Each right hand side is refined on its own, into a copy so that b is left alone if one of
+  // them needs the double precision factorization and it fails
+  bool ldlt_solve(V<double> &b, I nrhs)
+  {
+    if (!utdu()) {
+      return false;
+    }
+    V<double> x(b);
+    bool good = true;
+    this->each_rhs(x, this->m_n, nrhs, [&](V<double> &y) { good = good && solve(y); });
+    if (good) {
+      std::copy(x.begin(), x.end(), b.begin());
+    }
+    return good;
+  }
+
+  // The number of refinement steps the last solve took
+  I iterations() const
+  {
+    return m_iterations;
+  }
+
+  // True if the last factorization had to be done in double precision
+  bool fell_back() const
+  {
+    return (bool)m_high;
+  }
+
+  // Refinement steps before falling back to a double precision factorization
+  static constexpr I maximum_iterations = 30;
+
+private:
+
+  void allocate()
+  {
+    m_x.resize(this->m_n);
+    m_r.resize(this->m_n);
+    m_f.resize(this->m_n);
+  }
+
+  // Factor a double precision copy of the values
+  bool fall_back()
+  {
+    m_high = std::make_unique<SymmetricMatrix<I, double, V>>(this->m_structure);
+    std::copy(this->diagonal_data(), this->diagonal_data() + this->m_n, m_high->diagonal_data());
+    std::copy(this->upper_data(), this->upper_data() + this->m_structure->profile(), m_high->upper_data());
+    m_high->blocked(this->m_blocked);
+    m_high_good = m_high->utdu();
+    return m_high_good;
+  }
+
+  // Compute r = b - Ax and return the infinity norm of r
+  double residual(const V<double> &b)
+  {
+    std::copy(b.begin(), b.begin() + this->m_n, m_r.begin());
+    this->multiply_add(m_x, m_r, -1.0);
+    double norm = 0.0;
     for (I k = 0; k < this->m_n; ++k) {
-      m_skip[k] = false;
-      m_ip[k] = k;
+      norm = std::max(norm, std::abs(m_r[k]));
     }
-    m_locked = false;
-    m_n_actual = this->m_n;
+    return norm;
+  }
+
+  SymmetricMatrix<I, float, V> m_low;                  // The single precision factors
+  std::unique_ptr<SymmetricMatrix<I, double, V>> m_high; // The double precision factors, if needed
+  bool m_high_good{ false }; // Whether the double precision factorization worked
+  V<double> m_x;     // The solution as it is refined
+  V<double> m_r;     // The residual
+  V<float> m_f;      // The correction
+  double m_norm{ 0.0 }; // Infinity norm of the matrix
+  I m_iterations{ 0 };
+};
+
+// A matrix that is solved by preconditioned conjugate gradients rather than factored, for
+// systems where the fill of the full skyline would take too much memory. Only the nonzeros are
+// stored, row by row below the diagonal in the order of the graph. The preconditioner is an
+// incomplete factorization: the skyline is cut down to a band and to the entries that are not
+// small next to the diagonal, and the matrix restricted to that is factored with utdu. The
+// band and the drop tolerance trade memory for iterations; by default the band is one, so the
+// preconditioner is tridiagonal and nothing is dropped from it. The matrix must be positive
+// definite. If the cut down matrix is not, the diagonal of the preconditioner is shifted up
+// until it factors.
+template <typename I, typename R, template <typename ...> typename V> class ConjugateGradientMatrix
+{
+public:
+
+  // A matrix of zeros with room for the edges of the graph
+  ConjugateGradientMatrix(const Graph<I, V> &graph) : m_n(graph.size())
+  {
+    m_xl.resize(m_n + 1);
+    m_xl[0] = 0;
+    for (I i = 0; i < m_n; ++i) {
+      for (I j : graph.neighbors(i)) {
+        if (j < i) {
+          m_jl.push_back(j);
+        }
+      }
+      m_xl[i + 1] = m_jl.size();
+    }
+    m_ad.resize(m_n);
+    m_al.resize(m_jl.size());
+    fill(0.0);
+    m_r.resize(m_n);
+    m_z.resize(m_n);
+    m_p.resize(m_n);
+    m_q.resize(m_n);
+  }
+
+  ConjugateGradientMatrix(V<V<R>> &M) : ConjugateGradientMatrix(Graph<I, V>::dense(M))
+  {
+    for (I i = 0; i < m_n; ++i) {
+      m_ad[i] = M[i][i];
+      for (I r = m_xl[i]; r < m_xl[i + 1]; ++r) {
+        m_al[r] = M[i][m_jl[r]];
+      }
+    }
+  }
+
+  void fill(R v = 0.0)
+  {
+    std::fill(m_ad.begin(), m_ad.end(), v);
+    std::fill(m_al.begin(), m_al.end(), v);
+    m_factor.reset();
+  }
+
+  // Index of element (i, j) in the combined storage: the diagonal comes first, then the
+  // entries below it row by row. Elements that are not in the graph have no index.
+  std::optional<I> index(I i, I j) const
+  {
+    if (i < j) {
+      std::swap(i, j);
+    }
+    if (i == j) {
+      return i;
+    }
+    auto begin = m_jl.begin() + m_xl[i];
+    auto end = m_jl.begin() + m_xl[i + 1];
+    auto it = std::lower_bound(begin, end, j);
+    if (it == end || *it != j) {
+      return {};
+    }
+    return m_n + (it - m_jl.begin());
+  }
+
+  // Element (i, j), which must be in the graph
+  R &operator()(I i, I j)
+  {
+    I ij = *index(i, j);
+    m_factor.reset();
+    if (ij < m_n) {
+      return m_ad[ij];
+    }
+    return m_al[ij - m_n];
+  }
+
+  // Keep only entries of the preconditioner within this many rows of the diagonal, one by
+  // default. A band as wide as the matrix keeps the whole skyline and its fill.
+  void band(I band)
+  {
+    m_band = band;
+    m_factor.reset();
+  }
+
+  I band() const
+  {
+    return m_band;
+  }
+
+  // Drop entries of the preconditioner with |a(i, j)| < tolerance*sqrt(|a(i, i)*a(j, j)|)
+  void drop_tolerance(R tolerance)
+  {
+    m_drop = tolerance;
+    m_factor.reset();
+  }
+
+  R drop_tolerance() const
+  {
+    return m_drop;
+  }
+
+  // Stop when the 2-norm of the residual is this much smaller than that of the right hand side
+  void tolerance(R tolerance)
+  {
+    m_tolerance = tolerance;
+  }
+
+  R tolerance() const
+  {
+    return m_tolerance;
+  }
+
+  void maximum_iterations(I iterations)
+  {
+    m_maximum = iterations;
+  }
+
+  I maximum_iterations() const
+  {
+    return m_maximum;
+  }
+
+  // The product y = Ax
+  void multiply(const V<R> &x, V<R> &y) const
+  {
+    for (I i = 0; i < m_n; ++i) {
+      y[i] = m_ad[i] * x[i];
+    }
+    for (I i = 0; i < m_n; ++i) {
+      R sum = 0.0;
+      for (I r = m_xl[i]; r < m_xl[i + 1]; ++r) {
+        sum += m_al[r] * x[m_jl[r]];
+        y[m_jl[r]] += m_al[r] * x[i];
+      }
+      y[i] += sum;
+    }
+  }
+
+  // Build and factor the preconditioner. This is done by solve() if the values, band or drop
+  // tolerance have changed since the last time. Returns false if no shift of the diagonal up to
+  // maximum_shift gives a factor with positive pivots, and then there is no preconditioner.
+  bool precondition()
+  {
+    // Each column of the skyline goes up to the highest entry that is kept
+    V<I> heights(m_n);
+    for (I i = 0; i < m_n; ++i) {
+      heights[i] = 0;
+      for (I r = m_xl[i]; r < m_xl[i + 1]; ++r) {
+        if (keep(i, r)) {
+          heights[i] = i - m_jl[r];
+          break;
+        }
+      }
+    }
+    m_factor = std::make_unique<SymmetricMatrix<I, R, V>>(std::make_shared<const Structure<I, V>>(heights));
+    m_factor->threads(m_threads);
+    // Entries that were dropped but are inside the skyline anyway cost nothing to keep. A shift
+    // large enough makes the diagonal dominant, unless the diagonal itself is not positive.
+    m_shift = 0.0;
+    while (true) {
+      m_factor->fill(0.0);
+      for (I i = 0; i < m_n; ++i) {
+        m_factor->diagonal(i) = m_ad[i] * (1.0 + m_shift);
+        for (I r = m_xl[i]; r < m_xl[i + 1]; ++r) {
+          if (m_factor->index(m_jl[r], i)) {
+            (*m_factor)(m_jl[r], i) = m_al[r];
+          }
+        }
+      }
+      if (m_factor->utdu()) {
+        V<R> d = m_factor->diagonal();
+        if (std::all_of(d.begin(), d.end(), [](R v) { return v > 0.0; })) {
+          return true;
+        }
+      }
+      if (m_shift >= maximum_shift) {
+        m_factor.reset();
+        return false;
+      }
+      m_shift = m_shift == 0.0 ? 1.0e-3 : std::min<R>(2 * m_shift, maximum_shift);
+    }
+  }
+
+  // Solve Ax = b starting from zero, b is replaced by the solution. Returns true if the
+  // residual met the tolerance within the maximum number of iterations, and false without
+  // changing b if there is no preconditioner, see precondition().
+  bool solve(V<R> &b)
+  {
+    m_history.clear();
+    m_iterations = 0;
+    if (!m_factor && !precondition()) {
+      return false;
+    }
+    V<R> &x = b;
+    std::copy(b.begin(), b.begin() + m_n, m_r.begin());
+    std::fill(x.begin(), x.begin() + m_n, R(0));
+    R bnorm = std::sqrt(kernels::dot(m_r.data(), m_r.data(), m_n));
+    m_history.push_back(1.0);
+    if (bnorm == 0.0) {
+      return true;
+    }
+    apply(m_r, m_z);
+    std::copy(m_z.begin(), m_z.end(), m_p.begin());
+    R rz = kernels::dot(m_r.data(), m_z.data(), m_n);
+    while (m_iterations < m_maximum) {
+      ++m_iterations;
+      multiply(m_p, m_q);
+      R alpha = rz / kernels::dot(m_p.data(), m_q.data(), m_n);
+      kernels::axpy(alpha, m_p.data(), x.data(), m_n);
+      kernels::axpy(-alpha, m_q.data(), m_r.data(), m_n);
+      R rnorm = std::sqrt(kernels::dot(m_r.data(), m_r.data(), m_n)) / bnorm;
+      m_history.push_back(rnorm);
+      if (rnorm <= m_tolerance) {
+        return true;
+      }
+      if (!std::isfinite(rnorm)) {
+        return false;
+      }
+      apply(m_r, m_z);
+      R next = kernels::dot(m_r.data(), m_z.data(), m_n);
+      R beta = next / rz;
+      rz = next;
+      for (I i = 0; i < m_n; ++i) {
+        m_p[i] = m_z[i] + beta * m_p[i];
+      }
+    }
+    return false;
+  }
+
+  // The number of iterations the last solve took
+  I iterations() const
+  {
+    return m_iterations;
+  }
+
+  // The 2-norm of the residual before each iteration and after the last, relative to the
+  // right hand side
+  const V<R> &history() const
+  {
+    return m_history;
+  }
+
+  // The factored preconditioner, null before the first solve or precondition() and if that
+  // failed
+  const SymmetricMatrix<I, R, V> *preconditioner() const
+  {
+    return m_factor.get();
+  }
+
+  // The relative amount added to the diagonal of the preconditioner to make it factor
+  R shift() const
+  {
+    return m_shift;
+  }
+
+  // Factor the preconditioner and apply it with n threads
+  void threads(unsigned n)
+  {
+    m_threads = n;
+    if (m_factor) {
+      m_factor->threads(n);
+    }
+  }
+
+  unsigned threads() const
+  {
+    return m_threads;
+  }
+
+  I rows() const
+  {
+    return m_n;
+  }
+
+  I cols() const
+  {
+    return m_n;
+  }
+
+  // Largest relative shift of the diagonal that is tried
+  static constexpr double maximum_shift = 1.0e6;
+
+private:
+
+  // Whether entry r, in row i, sets the height of the preconditioner's skyline
+  bool keep(I i, I r) const
+  {
+    I j = m_jl[r];
+    return i - j <= m_band && std::abs(m_al[r]) >= m_drop * std::sqrt(std::abs(m_ad[i] * m_ad[j]));
+  }
+
+  // z = M^-1 r with the preconditioner
+  void apply(const V<R> &r, V<R> &z) const
+  {
+    std::copy(r.begin(), r.end(), z.begin());
+    m_factor->forward_substitution(z);
+    m_factor->back_substitution(z);
+  }
+
+  I m_n;      // System size
+  V<I> m_xl;  // Offsets into m_jl and m_al for each row, n + 1 entries
+  V<I> m_jl;  // Columns of the entries below the diagonal, in increasing order in each row
+  V<R> m_al;  // Values below the diagonal
+  V<R> m_ad;  // Diagonal of matrix
+  I m_band{ 1 }; // Largest distance from the diagonal of an entry in the preconditioner
+  R m_drop{ 0.0 };  // Relative size of the entries dropped from the preconditioner
+  R m_tolerance{ 1.0e-8 }; // Relative residual to stop at
+  I m_maximum{ 1000 }; // Most iterations in a solve
+  unsigned m_threads{ 1 }; // Threads for the preconditioner
+  R m_shift{ 0.0 }; // Relative shift of the diagonal of the preconditioner
+  std::unique_ptr<SymmetricMatrix<I, R, V>> m_factor; // The incomplete factors, null if out of date
+  V<R> m_r;   // The residual
+  V<R> m_z;   // The preconditioned residual
+  V<R> m_p;   // The search direction
+  V<R> m_q;   // The product of the matrix and the search direction
+  V<R> m_history; // Relative residual norms of the last solve
+  I m_iterations{ 0 };
+};
+
+// A batch of W matrices with the same skyline, stored interleaved so that element e of matrix
+// s is at W*e + s in the order of SymmetricMatrix::index. They are factored and solved in
+// lockstep, each operation of the factorization is done for all W of them at once. This is
+// meant for many small systems, where the overhead of working through them one by one would
+// cost more than the arithmetic. The default W fills a 64 byte cache line, which is also the
+// width of an AVX-512 register.
+template <typename I, typename R, template <typename ...> typename V, std::size_t W = 64 / sizeof(R)> class BatchedSymmetricMatrix
+{
+public:
+
+  BatchedSymmetricMatrix(V<I> &heights) : BatchedSymmetricMatrix(std::make_shared<const Structure<I, V>>(heights))
+  {}
+
+  BatchedSymmetricMatrix(std::shared_ptr<const Structure<I, V>> structure) : m_structure(structure),
+    m_n(structure->m_n), m_ik(structure->m_ik), m_im(structure->m_im), m_ir(structure->m_ir), m_kr(structure->m_kr)
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    m_am.resize(W * (m_n + structure->profile()));
+#else
+    m_ad.resize(W * m_n);
+    m_au.resize(W * structure->profile());
+#endif
+    fill(0.0);
+    m_v.resize(W * m_n);
   }
 
-  SymmetricSkipMatrix(V<I>& heights) : SymmetricMatrix<I, R, V>(heights)
+  static constexpr std::size_t width()
   {
-    m_skip.resize(this->m_n);
-    m_ip.resize(this->m_n);
-    I current = 0;
-    for (I k = 0; k < this->m_n; ++k) {
-      m_skip[k] = false;
-      m_ip[k] = k;
-    }
-    m_locked = false;
-    m_n_actual = this->m_n;
+    return W;
   }
 
-  void utdu()
+  void fill(R v = 0.0)
   {
-    // j = 0, nothing much to do
-    for (I k = 1; k < m_n_actual; ++k) {
-      if (this->m_im[m_ip[k]] <= m_ip[0]) {
 #ifndef SKYLINE_MULTIPLE_ARRAY
-        I ij = this->m_n + this->m_ik[m_ip[k]];
-        this->m_am[ij] /= this->m_am[0];
+    std::fill(m_am.begin(), m_am.end(), v);
 #else
-        I ij = this->m_ik[m_ip[k]];
-        this->m_au[ij] /= this->m_ad[m_ip[0]];
+    std::fill(m_ad.begin(), m_ad.end(), v);
+    std::fill(m_au.begin(), m_au.end(), v);
 #endif
-      }
+  }
+
+  std::shared_ptr<const Structure<I, V>> structure() const
+  {
+    return m_structure;
+  }
+
+  // Index of element (i, j) in one matrix, the same as SymmetricMatrix::index
+  std::optional<I> index(I i, I j) const
+  {
+    if (i > j) {
+      std::swap(i, j);
+    }
+    if (i == j) {
+      return i;
+    } else if (m_im[j] <= i) {
+      return m_n + m_ik[j] + i - m_im[j];
+    }
+    return {};
+  }
+
+  // Element (i, j) of matrix s, which must be inside the skyline
+  R &operator()(I i, I j, I s)
+  {
+    I ij = *index(i, j);
+    if (ij < m_n) {
+      return diagonal_data()[W * ij + s];
+    }
+    return upper_data()[W * (ij - m_n) + s];
+  }
+
+  R &diagonal(I i, I s)
+  {
+    return diagonal_data()[W * i + s];
+  }
+
+  // Set the values of matrix s, given in the order of index(i, j)
+  void set(I s, const V<R> &values)
+  {
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    I profile = m_structure->profile();
+    for (I i = 0; i < m_n; ++i) {
+      ad[W * i + s] = values[i];
+    }
+    for (I i = 0; i < profile; ++i) {
+      au[W * i + s] = values[m_n + i];
+    }
+  }
+
+  // The values of matrix s in the order of index(i, j), the factors once utdu has been called
+  V<R> values(I s) const
+  {
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    I profile = m_structure->profile();
+    V<R> values(m_n + profile);
+    for (I i = 0; i < m_n; ++i) {
+      values[i] = ad[W * i + s];
     }
-    // Now for the rest
-    for (I j = 1; j < m_n_actual; ++j) {
-      // Compute v
-      for (I i = 0; i < this->m_im[m_ip[j]]; ++i) {
-        this->m_v[m_ip[i]] = 0.0;
+    for (I i = 0; i < profile; ++i) {
+      values[m_n + i] = au[W * i + s];
+    }
+    return values;
+  }
+
+  // The same row oriented UTDU factorization as SymmetricMatrix, one pivot at a time
+  void utdu()
+  {
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    R *v = m_v.data();
+    for (I j = 0; j < m_n; ++j) {
+      // Compute v and the diagonal term
+      const R *aj = au + W * m_ik[j];
+      R *vj = v + W * m_im[j];
+      const R *dj = ad + W * m_im[j];
+      for (std::size_t e = 0; e < W * (j - m_im[j]); ++e) {
+        vj[e] = aj[e] * dj[e];
       }
-      for (I i = this->m_im[m_ip[j]]; i < j; ++i) {
+      kernels::dot_lanes(aj, vj, W, j - m_im[j], ad + W * j, W);
+      // Compute the rest of the row
+      for (I r = m_ir[j]; r < m_ir[j + 1]; ++r) {
+        I k = m_kr[r];
+        I i0 = std::max(m_im[k], m_im[j]);
+        R *ak = au + W * (m_ik[k] + i0 - m_im[k]); // OK, i0 >= m_im[k]
+        R *akj = ak + W * (j - i0);
+        kernels::dot_lanes(ak, v + W * i0, W, j - i0, akj, W);
+        for (std::size_t s = 0; s < W; ++s) {
+          akj[s] /= ad[W * j + s];
+        }
+      }
+    }
+  }
+
+  // Solve with the factors from utdu for one right hand side per matrix, interleaved in the
+  // same way as the matrices, b[W*i + s] is row i of the right hand side of matrix s
+  void forward_substitution(V<R> &b) const
+  {
+    const R *au = upper_data();
+    for (I i = 1; i < m_n; ++i) {
+      kernels::dot_lanes(au + W * m_ik[i], b.data() + W * m_im[i], W, i - m_im[i], b.data() + W * i, W);
+    }
+  }
+
+  void back_substitution(V<R> &z) const
+  {
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    for (std::size_t e = 0; e < W * m_n; ++e) {
+      z[e] /= ad[e];
+    }
+    for (I j = m_n - 1; j > 0; --j) {
+      kernels::axpy_lanes(au + W * m_ik[j], z.data() + W * j, W, j - m_im[j], z.data() + W * m_im[j], W);
+    }
+  }
+
+  void ldlt_solve(V<R> &b)
+  {
+    utdu();
+    forward_substitution(b);
+    back_substitution(b);
+  }
+
+  I rows() const
+  {
+    return m_n;
+  }
+
+  I cols() const
+  {
+    return m_n;
+  }
+
+private:
+
+  R *diagonal_data()
+  {
 #ifndef SKYLINE_MULTIPLE_ARRAY
-        this->m_v[m_ip[i]] = this->m_am[this->m_n + this->m_ik[m_ip[j]] + i - this->m_im[m_ip[j]]] * this->m_am[m_ip[i]]; // OK, i >= m_im[j]
+    return m_am.data();
 #else
-        this->m_v[m_ip[i]] = this->m_au[this->m_ik[m_ip[j]] + i - this->m_im[m_ip[j]]] * this->m_ad[m_ip[i]]; // OK, i >= m_im[j]
+    return m_ad.data();
 #endif
-      }
-      // Compute the diagonal term
-      R value = 0.0;
-      for (I i = this->m_im[m_ip[j]]; i < j; ++i) {
+  }
+
+  const R *diagonal_data() const
+  {
 #ifndef SKYLINE_MULTIPLE_ARRAY
-        value += this->m_am[this->m_n + this->m_ik[m_ip[j]] + i - this->m_im[m_ip[j]]] * this->m_v[m_ip[i]];  // OK, i >= m_im[j]
+    return m_am.data();
 #else
-        value += this->m_au[this->m_ik[m_ip[j]] + i - this->m_im[m_ip[j]]] * this->m_v[this->m_ip[i]];  // OK, i >= m_im[j]
+    return m_ad.data();
 #endif
-      }
+  }
+
+  R *upper_data()
+  {
 #ifndef SKYLINE_MULTIPLE_ARRAY
-      this->m_am[m_ip[j]] -= value;
+    return m_am.data() + W * m_n;
 #else
-      this->m_ad[m_ip[j]] -= value;
+    return m_au.data();
 #endif
-      // Compute the rest of the row
-      for (I k = j + 1; k < m_n_actual; ++k) {
-        if (this->m_im[m_ip[k]] <= j) {
-          value = 0.0;
+  }
+
+  const R *upper_data() const
+  {
 #ifndef SKYLINE_MULTIPLE_ARRAY
-          for (I i = this->m_im[k]; i < j; ++i) {
-            I ij = this->m_n + this->m_ik[k] + i - this->m_im[k]; // OK, i >= m_im[k]
-            value += this->m_am[ij] * this->m_v[i];
-          }
-          I ij = this->m_n + this->m_ik[k] + j - this->m_im[k]; // OK, j >= m_im[k]
-          this->m_am[ij] = (this->m_am[ij] - value) / this->m_am[j];
+    return m_am.data() + W * m_n;
 #else
-          for (I i = this->m_im[m_ip[k]]; i < j; ++i) {
-            I ij = this->m_ik[m_ip[k]] + i - this->m_im[m_ip[k]]; // OK, i >= m_im[k]
-            value += this->m_au[ij] * this->m_v[m_ip[i]];
-          }
-          I ij = this->m_ik[m_ip[k]] + j - this->m_im[m_ip[k]]; // OK, j >= m_im[k]
-          this->m_au[ij] = (this->m_au[ij] - value) / this->m_ad[m_ip[j]];
+    return m_au.data();
 #endif
-        }
-      }
-    }
   }
 
-  void forward_substitution(V<R>& b) const
-  {
-    // Solve Lz=b (Dy=z, Ux=y)
-    for (I i = 1; i < m_n_actual; ++i) {
-      R value = 0.0;
-      for (I k = this->m_im[m_ip[i]]; k < i; ++k) {
+  std::shared_ptr<const Structure<I, V>> m_structure; // The symbolic structure, possibly shared
+  I m_n;     // System size
+  const typename Structure<I, V>::Indices &m_ik; // Index offsets to top of skylines
+  const typename Structure<I, V>::Indices &m_im; // Minimum row, or top of skyline
+  const typename Structure<I, V>::Indices &m_ir; // Offsets into m_kr for each row, n + 1 entries
+  const typename Structure<I, V>::Indices &m_kr; // Columns whose skyline reaches each row, in increasing order by row
 #ifndef SKYLINE_MULTIPLE_ARRAY
-        I ij = this->m_n + this->m_ik[m_ip[i]] + k - this->m_im[m_ip[i]];
-        value += this->m_am[ij] * b[m_ip[k]];
+  V<R> m_am; // All of the matrices in one vector, first the diagonals, then the rest
 #else
-        I ij = this->m_ik[m_ip[i]] + k - this->m_im[m_ip[i]];
-        value += this->m_au[ij] * b[m_ip[k]];
+  V<R> m_au; // Upper triangular parts of the matrices
+  V<R> m_ad; // Diagonals of the matrices
 #endif
+  V<R> m_v;  // Temporary used in the factorization
+};
+
+
+// The skyline of a FixedSymmetricMatrix, fixed when the program is compiled. The heights of the
+// columns are the template arguments, and the offsets and tops are worked out from them the
+// same way as in Structure, by the compiler.
+template <typename I, I... H> class FixedStructure
+{
+public:
+
+  static constexpr I size()
+  {
+    return sizeof...(H);
+  }
+
+  // Number of elements in the upper triangle
+  static constexpr I profile()
+  {
+    return (I(0) + ... + H);
+  }
+
+  static constexpr std::array<I, sizeof...(H)> heights()
+  {
+    return { { H... } };
+  }
+
+  static constexpr std::array<I, sizeof...(H)> offsets()
+  {
+    std::array<I, sizeof...(H)> ih{ { H... } };
+    std::array<I, sizeof...(H)> ik{};
+    for (I k = 1; k < size(); ++k) {
+      ik[k] = ik[k - 1] + ih[k - 1];
+    }
+    return ik;
+  }
+
+  static constexpr std::array<I, sizeof...(H)> minima()
+  {
+    std::array<I, sizeof...(H)> ih{ { H... } };
+    std::array<I, sizeof...(H)> im{};
+    for (I k = 1; k < size(); ++k) {
+      im[k] = k - ih[k];
+    }
+    return im;
+  }
+
+  // No column may reach above the first row
+  static constexpr bool valid()
+  {
+    std::array<I, sizeof...(H)> ih{ { H... } };
+    for (I k = 0; k < size(); ++k) {
+      if (ih[k] > k) {
+        return false;
       }
-      b[m_ip[i]] -= value;
     }
+    return true;
   }
+};
 
-  void back_substitution(V<R>& z) const
+// A matrix with a skyline that is known when the program is compiled, for small systems with a
+// fixed topology that are solved many times over. Every loop of the factorization and the
+// solves has bounds that are constants, so the loops are unrolled completely and the offsets
+// into the storage are all worked out by the compiler. What is left is straight line
+// arithmetic on values held in std::array, with no allocation. The code grows with the
+// product of the profile and the heights, so this is only meant for a few dozen unknowns.
+template <typename I, typename R, I... H> class FixedSymmetricMatrix
+{
+public:
+  static_assert(sizeof...(H) > 0, "A fixed matrix needs at least one unknown");
+  static_assert(FixedStructure<I, H...>::valid(), "A column of a fixed matrix reaches above the first row");
+
+  FixedSymmetricMatrix()
+  {
+    fill(0.0);
+  }
+
+  void fill(R v = 0.0)
   {
-    // Account for the diagonal first (invert Dy=z)
-    for (I j = 0; j < m_n_actual; ++j) {
 #ifndef SKYLINE_MULTIPLE_ARRAY
-      z[m_ip[j]] /= this->m_am[m_ip[j]];
+    m_am.fill(v);
 #else
-      z[m_ip[j]] /= this->m_ad[m_ip[j]];
+    m_ad.fill(v);
+    m_au.fill(v);
 #endif
+  }
+
+  // Number of elements in the upper triangle
+  static constexpr I profile()
+  {
+    return m_profile;
+  }
+
+  static constexpr std::array<I, sizeof...(H)> offsets()
+  {
+    return m_ik;
+  }
+
+  static constexpr std::array<I, sizeof...(H)> heights()
+  {
+    return FixedStructure<I, H...>::heights();
+  }
+
+  static constexpr std::array<I, sizeof...(H)> minima()
+  {
+    return m_im;
+  }
+
+  // Index of element (i, j), the same as SymmetricMatrix::index
+  static constexpr std::optional<I> index(I i, I j)
+  {
+    if (i > j) {
+      return index(j, i);
     }
-    // Solve Ux=y
-    for (I j = m_n_actual - 1; j > 0; --j) {
-      for (I k = this->m_im[m_ip[j]]; k < j; ++k) {
-#ifndef SKYLINE_MULTIPLE_ARRAY
-        I ij = this->m_n + this->m_ik[m_ip[j]] + k - this->m_im[m_ip[j]];
-        z[m_ip[k]] -= z[m_ip[j]] * this->m_am[ij];
-#else
-        I ij = this->m_ik[m_ip[j]] + k - this->m_im[m_ip[j]];
-        z[m_ip[k]] -= z[m_ip[j]] * this->m_au[ij];
-#endif
-      }
+    if (i == j) {
+      return i;
+    } else if (m_im[j] <= i) {
+      return m_n + m_ik[j] + i - m_im[j];
     }
+    return {};
   }
 
-  virtual void ldlt_solve(V<R>& b)
+  // Element (i, j), which must be inside the skyline
+  R &operator()(I i, I j)
   {
-    lock();
+    I ij = *index(i, j);
+    if (ij < m_n) {
+      return diagonal_data()[ij];
+    }
+    return upper_data()[ij - m_n];
+  }
+
+  std::array<R, sizeof...(H)> diagonal() const
+  {
+    std::array<R, m_n> ad;
+    std::copy(diagonal_data(), diagonal_data() + m_n, ad.begin());
+    return ad;
+  }
+
+  std::array<R, FixedStructure<I, H...>::profile()> upper() const
+  {
+    std::array<R, m_profile> au;
+    std::copy(upper_data(), upper_data() + m_profile, au.begin());
+    return au;
+  }
+
+  // Factor new values, in the order of index(): the diagonal, then the upper triangle column by
+  // column
+  void refactor(const std::array<R, sizeof...(H) + FixedStructure<I, H...>::profile()> &values)
+  {
+    std::copy(values.begin(), values.begin() + m_n, diagonal_data());
+    std::copy(values.begin() + m_n, values.end(), upper_data());
     utdu();
-    forward_substitution(b);
-    back_substitution(b);
-    unlock();
   }
 
-  virtual void utdu_solve(V<R>& b)
+  // The column oriented form of the UTDU factorization. For each column j, the entries above
+  // the diagonal are first reduced by the columns to their left, then scaled by the diagonal,
+  // which is reduced as they are.
+  void utdu()
+  {
+    R *ad = diagonal_data();
+    R *au = upper_data();
+    unroll<0, m_n>([&](auto j) {
+      constexpr I jj = j;
+      unroll<m_im[jj], jj>([&](auto i) {
+        constexpr I ii = i;
+        constexpr I ij = m_ik[jj] + ii - m_im[jj]; // OK, i >= m_im[j]
+        R g = au[ij];
+        unroll<std::max(m_im[ii], m_im[jj]), ii>([&](auto k) {
+          constexpr I kk = k;
+          g -= au[m_ik[ii] + kk - m_im[ii]] * au[m_ik[jj] + kk - m_im[jj]];
+        });
+        au[ij] = g;
+      });
+      R d = ad[jj];
+      unroll<m_im[jj], jj>([&](auto i) {
+        constexpr I ii = i;
+        constexpr I ij = m_ik[jj] + ii - m_im[jj];
+        R g = au[ij];
+        R u = g / ad[ii];
+        au[ij] = u;
+        d -= g * u;
+      });
+      ad[jj] = d;
+    });
+  }
+
+  // The solves take anything that can be indexed with [], std::array or V<R>
+  template <typename B> void forward_substitution(B &b) const
+  {
+    const R *au = upper_data();
+    unroll<1, m_n>([&](auto i) {
+      constexpr I ii = i;
+      R s = b[ii];
+      unroll<m_im[ii], ii>([&](auto k) {
+        constexpr I kk = k;
+        s -= au[m_ik[ii] + kk - m_im[ii]] * b[kk];
+      });
+      b[ii] = s;
+    });
+  }
+
+  template <typename B> void back_substitution(B &z) const
+  {
+    const R *ad = diagonal_data();
+    const R *au = upper_data();
+    unroll<0, m_n>([&](auto j) {
+      constexpr I jj = j;
+      z[jj] /= ad[jj];
+    });
+    unroll<1, m_n>([&](auto r) {
+      constexpr I jj = m_n - r; // Backwards, from the last column to the second
+      R zj = z[jj];
+      unroll<m_im[jj], jj>([&](auto i) {
+        constexpr I ii = i;
+        z[ii] -= au[m_ik[jj] + ii - m_im[jj]] * zj;
+      });
+    });
+  }
+
+  template <typename B> void ldlt_solve(B &b)
   {
-    lock();
     utdu();
     forward_substitution(b);
     back_substitution(b);
-    unlock();
   }
 
-  bool skip(I i)
+  static constexpr I rows()
   {
-    if (m_locked) {
-      return false;
-    }
-    m_skip[i] = !m_skip[i];
-    return true;
+    return m_n;
   }
 
-  bool &skip(I i) const
+  static constexpr I cols()
   {
-    return m_skip[i];
+    return m_n;
   }
 
-  V<bool> skip()
+private:
+
+  // Call f with each of First, ..., Last - 1 as a std::integral_constant, so that it can be
+  // used where a constant is needed
+  template <I First, I Last, typename F> static void unroll(F &&f)
   {
-    return m_skip;
+    if constexpr (First < Last) {
+      unroll<First>(f, std::make_integer_sequence<I, Last - First>{});
+    }
   }
 
-  void unskip()
+  template <I First, typename F, I... K> static void unroll(F &f, std::integer_sequence<I, K...>)
   {
-    for (I i = 0; i < this->m_n; ++i) {
-      m_skip[i] = false;
-    }
+    (f(std::integral_constant<I, First + K>{}), ...);
   }
 
-  V<I> ip()
+  R *diagonal_data()
   {
-    return m_ip;
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data();
+#else
+    return m_ad.data();
+#endif
   }
 
-  void lock()
+  const R *diagonal_data() const
   {
-    if (m_locked) {
-      return;
-    }
-    I current = 0;
-    for (I i = 0; i < this->m_n; ++i) {
-      if (!m_skip[i]) {
-        m_ip[current] = i;
-        ++current;
-      }
-    }
-    m_n_actual = current;
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data();
+#else
+    return m_ad.data();
+#endif
   }
 
-  void unlock()
+  R *upper_data()
   {
-    m_locked = false;
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data() + m_n;
+#else
+    return m_au.data();
+#endif
   }
 
-private:
-  bool m_locked;
-  V<bool> m_skip;
-  V<I> m_ip;
-  I m_n_actual;
-};
+  const R *upper_data() const
+  {
+#ifndef SKYLINE_MULTIPLE_ARRAY
+    return m_am.data() + m_n;
+#else
+    return m_au.data();
+#endif
+  }
 
+  static constexpr I m_n = FixedStructure<I, H...>::size();                     // System size
+  static constexpr I m_profile = FixedStructure<I, H...>::profile();            // Number of elements in the upper triangle
+  static constexpr std::array<I, sizeof...(H)> m_ik = FixedStructure<I, H...>::offsets(); // Index offsets to top of skylines
+  static constexpr std::array<I, sizeof...(H)> m_im = FixedStructure<I, H...>::minima();  // Minimum row, or top of skyline
+#ifndef SKYLINE_MULTIPLE_ARRAY
+  std::array<R, sizeof...(H) + FixedStructure<I, H...>::profile()> m_am; // All of the matrix, first the diagonal, then the rest
+#else
+  std::array<R, FixedStructure<I, H...>::profile()> m_au; // Upper triangular part of matrix
+  std::array<R, sizeof...(H)> m_ad;         // Diagonal of matrix
+#endif
+};
 
 }
 
@@ -0,0 +1,155 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace skyline {
+
+// A fixed set of threads that all run the same task, with a barrier to keep them in step.
+// The calling thread takes part as thread 0, so a pool of size one has no extra threads.
+class ThreadPool
+{
+public:
+
+  explicit ThreadPool(unsigned size) : m_size(size > 0 ? size : 1)
+  {
+    for (unsigned i = 1; i < m_size; ++i) {
+      m_threads.emplace_back([this, i]() { work(i); });
+    }
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_start.notify_all();
+    for (auto &thread : m_threads) {
+      thread.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned size() const
+  {
+    return m_size;
+  }
+
+  // Run task(t) on every thread t = 0, ..., size() - 1 and wait for all of them to finish
+  void run(const std::function<void(unsigned)> &task)
+  {
+    if (m_size == 1) {
+      task(0);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_task = &task;
+      m_running = m_size - 1;
+      ++m_generation;
+    }
+    m_start.notify_all();
+    task(0);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_running == 0; });
+    m_task = nullptr;
+  }
+
+  // Wait until every thread in the running task gets here. This spins for a while and then
+  // yields, the waits in a factorization are usually short.
+  void barrier()
+  {
+    if (m_size == 1) {
+      return;
+    }
+    unsigned phase = m_phase.load(std::memory_order_acquire);
+    if (m_arrived.fetch_add(1, std::memory_order_acq_rel) == m_size - 1) {
+      m_arrived.store(0, std::memory_order_relaxed);
+      m_phase.store(phase + 1, std::memory_order_release);
+      return;
+    }
+    unsigned spins = 0;
+    while (m_phase.load(std::memory_order_acquire) == phase) {
+      if (++spins > 1024) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+
+  void work(unsigned id)
+  {
+    unsigned generation = 0;
+    while (true) {
+      const std::function<void(unsigned)> *task;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_start.wait(lock, [&]() { return m_stop || m_generation != generation; });
+        if (m_stop) {
+          return;
+        }
+        generation = m_generation;
+        task = m_task;
+      }
+      (*task)(id);
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_running;
+      }
+      m_done.notify_one();
+    }
+  }
+
+  unsigned m_size;
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_start;
+  std::condition_variable m_done;
+  const std::function<void(unsigned)> *m_task{ nullptr };
+  unsigned m_generation{ 0 };
+  unsigned m_running{ 0 };
+  bool m_stop{ false };
+  std::atomic<unsigned> m_arrived{ 0 };
+  std::atomic<unsigned> m_phase{ 0 };
+};
+
+}
+
+#endif // !THREADPOOL_HPP
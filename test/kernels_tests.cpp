@@ -0,0 +1,171 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "catch.hpp"
+#include "../include/kernels.hpp"
+#include "../include/poisson2d.hpp"
+#include "../include/skyline.hpp"
+#include <vector>
+
+TEST_CASE("Kernels agree with the scalar loops", "[kernels]")
+{
+  skyline::kernels::Isa best = skyline::kernels::detect();
+  std::vector<double> a(200), b(200);
+  std::vector<float> af(200), bf(200);
+  for (size_t i = 0; i < 200; ++i) {
+    a[i] = 1.0 + 0.01*i;
+    b[i] = 2.0 - 0.005*i;
+    af[i] = (float)a[i];
+    bf[i] = (float)b[i];
+  }
+  for (int isa = 0; isa <= static_cast<int>(best); ++isa) {
+    skyline::kernels::set_isa(static_cast<skyline::kernels::Isa>(isa));
+    INFO("Kernel set " << skyline::kernels::name(skyline::kernels::isa()));
+    for (size_t n : { 0, 1, 7, 15, 16, 17, 31, 33, 64, 65, 127, 200 }) {
+      INFO("Length " << n);
+      CHECK(skyline::kernels::dot(a.data(), b.data(), n) == Approx(skyline::kernels::scalar::dot(a.data(), b.data(), n)));
+      CHECK(skyline::kernels::dot(af.data(), bf.data(), n) == Approx(skyline::kernels::scalar::dot(af.data(), bf.data(), n)).epsilon(1.0e-5));
+      std::vector<double> y(b), z(b);
+      skyline::kernels::axpy(-0.5, a.data(), y.data(), n);
+      skyline::kernels::scalar::axpy(-0.5, a.data(), z.data(), n);
+      for (size_t i = 0; i < 200; ++i) {
+        CHECK(y[i] == Approx(z[i]));
+      }
+      std::vector<float> yf(bf), zf(bf);
+      skyline::kernels::axpy(-0.5f, af.data(), yf.data(), n);
+      skyline::kernels::scalar::axpy(-0.5f, af.data(), zf.data(), n);
+      for (size_t i = 0; i < 200; ++i) {
+        CHECK(yf[i] == Approx(zf[i]));
+      }
+      CHECK(skyline::kernels::dot_axpy(a.data(), b.data(), 0.25, y.data(), n) == Approx(skyline::kernels::scalar::dot_axpy(a.data(), b.data(), 0.25, z.data(), n)));
+      CHECK(skyline::kernels::dot_axpy(af.data(), bf.data(), 0.25f, yf.data(), n) == Approx(skyline::kernels::scalar::dot_axpy(af.data(), bf.data(), 0.25f, zf.data(), n)).epsilon(1.0e-5));
+      for (size_t i = 0; i < 200; ++i) {
+        CHECK(y[i] == Approx(z[i]));
+        CHECK(yf[i] == Approx(zf[i]));
+      }
+    }
+    // The block kernels, across blocks of several widths with a row stride that is wider still
+    for (size_t m : { 1, 5, 8, 17, 33, 64, 71 }) {
+      INFO("Width " << m);
+      size_t ldx = m + 3;
+      std::vector<double> x(20 * ldx), y(m), z(m);
+      std::vector<float> xf(20 * ldx), yf(m), zf(m);
+      for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = 0.5 + 0.003 * i;
+        xf[i] = (float)x[i];
+      }
+      for (size_t r = 0; r < m; ++r) {
+        y[r] = z[r] = 1.0 - 0.01 * r;
+        yf[r] = zf[r] = (float)y[r];
+      }
+      skyline::kernels::dot_rows(a.data(), x.data(), ldx, 20, y.data(), m);
+      skyline::kernels::scalar::dot_rows(a.data(), x.data(), ldx, 20, z.data(), m);
+      skyline::kernels::dot_rows(af.data(), xf.data(), ldx, 20, yf.data(), m);
+      skyline::kernels::scalar::dot_rows(af.data(), xf.data(), ldx, 20, zf.data(), m);
+      for (size_t r = 0; r < m; ++r) {
+        CHECK(y[r] == Approx(z[r]));
+        CHECK(yf[r] == Approx(zf[r]).epsilon(1.0e-5));
+      }
+      std::vector<double> w(x);
+      std::vector<float> wf(xf);
+      skyline::kernels::axpy_rows(a.data(), y.data(), 20, x.data(), ldx, m);
+      skyline::kernels::scalar::axpy_rows(a.data(), y.data(), 20, w.data(), ldx, m);
+      skyline::kernels::axpy_rows(af.data(), yf.data(), 20, xf.data(), ldx, m);
+      skyline::kernels::scalar::axpy_rows(af.data(), yf.data(), 20, wf.data(), ldx, m);
+      for (size_t i = 0; i < x.size(); ++i) {
+        CHECK(x[i] == Approx(w[i]));
+        CHECK(xf[i] == Approx(wf[i]).epsilon(1.0e-5));
+      }
+    }
+    // The interleaved kernels, with widths that are and are not a multiple of the vector length
+    for (size_t m : { 1, 3, 4, 8, 16, 21 }) {
+      INFO("Lanes " << m);
+      size_t ld = m + 2;
+      std::vector<double> x(m), y(m), z(m), w(8 * ld), v(8 * ld);
+      std::vector<float> xf(m), yf(m), zf(m), wf(8 * ld), vf(8 * ld);
+      for (size_t s = 0; s < m; ++s) {
+        x[s] = 0.25 + 0.1 * s;
+        y[s] = z[s] = 3.0 - 0.2 * s;
+        xf[s] = (float)x[s];
+        yf[s] = zf[s] = (float)y[s];
+      }
+      for (size_t i = 0; i < w.size(); ++i) {
+        w[i] = v[i] = 0.1 * (i % 13);
+        wf[i] = vf[i] = (float)w[i];
+      }
+      skyline::kernels::dot_lanes(a.data(), b.data(), ld, 8, y.data(), m);
+      skyline::kernels::scalar::dot_lanes(a.data(), b.data(), ld, 8, z.data(), m);
+      skyline::kernels::dot_lanes(af.data(), bf.data(), ld, 8, yf.data(), m);
+      skyline::kernels::scalar::dot_lanes(af.data(), bf.data(), ld, 8, zf.data(), m);
+      for (size_t s = 0; s < m; ++s) {
+        CHECK(y[s] == Approx(z[s]));
+        CHECK(yf[s] == Approx(zf[s]).epsilon(1.0e-5));
+      }
+      skyline::kernels::axpy_lanes(a.data(), x.data(), ld, 8, w.data(), m);
+      skyline::kernels::scalar::axpy_lanes(a.data(), x.data(), ld, 8, v.data(), m);
+      skyline::kernels::axpy_lanes(af.data(), xf.data(), ld, 8, wf.data(), m);
+      skyline::kernels::scalar::axpy_lanes(af.data(), xf.data(), ld, 8, vf.data(), m);
+      for (size_t i = 0; i < w.size(); ++i) {
+        CHECK(w[i] == Approx(v[i]));
+        CHECK(wf[i] == Approx(vf[i]).epsilon(1.0e-5));
+      }
+    }
+  }
+  skyline::kernels::set_isa(best);
+  CHECK(skyline::kernels::isa() == best);
+}
+
+TEST_CASE("Skyline Solve With Each Kernel Set", "[kernels][SymmetricMatrix]")
+{
+  skyline::kernels::Isa best = skyline::kernels::detect();
+  poisson::Poisson2D<size_t, double, std::vector> p2d(24);
+  p2d.set_east([](double y) { return y * (1.0 - y); });
+  p2d.set_rhs([](double x, double y) { return 6.0*x*y*(1.0 - y) - 2.0*x*x*x; });
+
+  std::vector<std::vector<double>> M;
+  std::vector<double> b;
+  std::vector<size_t> map;
+  p2d.matrix_system(M, map, b);
+
+  skyline::kernels::set_isa(skyline::kernels::Isa::Scalar);
+  skyline::SymmetricMatrix<size_t, double, std::vector> reference(M);
+  std::vector<double> x(b);
+  reference.ldlt_solve(x);
+
+  for (int isa = 1; isa <= static_cast<int>(best); ++isa) {
+    skyline::kernels::set_isa(static_cast<skyline::kernels::Isa>(isa));
+    INFO("Kernel set " << skyline::kernels::name(skyline::kernels::isa()));
+    skyline::SymmetricMatrix<size_t, double, std::vector> skyline(M);
+    std::vector<double> y(b);
+    skyline.ldlt_solve(y);
+    for (size_t i = 0; i < y.size(); ++i) {
+      CHECK(y[i] == Approx(x[i]));
+    }
+  }
+  skyline::kernels::set_isa(best);
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "catch.hpp"
+#include "../include/mapped.hpp"
+#include <cstdio>
+#include <vector>
+
+TEST_CASE("Mapped Factors", "[MappedSymmetricMatrix]")
+{
+  size_t m = 15;
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m);
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> sky(heights);
+  for (size_t k = 0; k < n; ++k) {
+    sky(k, k) = 4.0 + 0.1 * (k % 3);
+    if (k % m != 0) {
+      sky(k - 1, k) = -1.0;
+    }
+    if (k >= m) {
+      sky(k - m, k) = -1.0 + 0.01 * (k % 7);
+    }
+  }
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  // The two builds of the tests may run at the same time
+#ifdef SKYLINE_MULTIPLE_ARRAY
+  const char *path = "mapped_tests_multiple_array.sky";
+#else
+  const char *path = "mapped_tests.sky";
+#endif
+
+  // Not factored yet, so there is nothing to solve with
+  REQUIRE(skyline::MappedSymmetricMatrix<size_t, double, std::vector>::write(sky, path));
+  {
+    skyline::MappedSymmetricMatrix<size_t, double, std::vector> mapped(path);
+    REQUIRE(mapped.is_open());
+    CHECK_FALSE(mapped.factored());
+    std::vector<double> x(b);
+    CHECK_FALSE(mapped.solve(x));
+    CHECK(x == b);
+  }
+
+  std::vector<double> x(b);
+  sky.ldlt_solve(x);
+  REQUIRE(skyline::MappedSymmetricMatrix<size_t, double, std::vector>::write(sky, path));
+  skyline::MappedSymmetricMatrix<size_t, double, std::vector> mapped(path);
+  REQUIRE(mapped.is_open());
+  CHECK(mapped.factored());
+  CHECK(mapped.rows() == n);
+#ifdef SKYLINE_MULTIPLE_ARRAY
+  CHECK(mapped.multiple_array());
+#else
+  CHECK_FALSE(mapped.multiple_array());
+#endif
+  std::vector<double> y(b);
+  CHECK(mapped.solve(y));
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(y[i] == x[i]);
+  }
+
+  // Files written with other types are turned away
+  skyline::MappedSymmetricMatrix<size_t, float, std::vector> single;
+  CHECK_FALSE(single.open(path));
+  CHECK_FALSE(single.is_open());
+  skyline::MappedSymmetricMatrix<unsigned short, double, std::vector> narrow;
+  CHECK_FALSE(narrow.open(path));
+  mapped.close();
+  CHECK_FALSE(mapped.is_open());
+  CHECK_FALSE(mapped.solve(y));
+
+  // And so are files whose headers don't agree with their sections
+  auto corrupted = [&](auto change) {
+    REQUIRE(skyline::MappedSymmetricMatrix<size_t, double, std::vector>::write(sky, path));
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    skyline::MappedHeader header;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    change(header);
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+    bool opened = mapped.open(path);
+    mapped.close();
+    return opened;
+  };
+  CHECK(corrupted([](skyline::MappedHeader &) {}));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.ik = header.upper + 1024 * 1024; }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.im = header.ik; }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.diagonal = header.upper + 64; }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.upper = header.diagonal; }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.ik = 8; }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.n *= 2; }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.n = ~std::uint64_t(0); }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.n -= 1; }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.profile -= 1; }));
+  CHECK_FALSE(corrupted([](skyline::MappedHeader &header) { header.profile = 0; }));
+
+  // And so are files with a column in the middle that doesn't fit with the ones around it
+  auto overwritten = [&](bool tops, size_t k, size_t value) {
+    REQUIRE(skyline::MappedSymmetricMatrix<size_t, double, std::vector>::write(sky, path));
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    skyline::MappedHeader header;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    file.seekp((tops ? header.im : header.ik) + k * sizeof(size_t));
+    file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    file.close();
+    bool opened = mapped.open(path);
+    mapped.close();
+    return opened;
+  };
+  size_t k = n / 2;
+  std::vector<size_t> offsets = sky.offsets(), tops = sky.minima();
+  CHECK(overwritten(false, k, offsets[k]));
+  CHECK_FALSE(overwritten(false, k, offsets[k] + 1));
+  CHECK_FALSE(overwritten(false, k, ~size_t(0)));
+  CHECK_FALSE(overwritten(true, k, tops[k] + 1));
+  CHECK_FALSE(overwritten(true, k, k + 1));
+  CHECK_FALSE(overwritten(true, k, ~size_t(0)));
+
+  // And so are files that are not matrices at all
+  std::remove(path);
+  CHECK_FALSE(mapped.open(path));
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "Not a skyline matrix, but long enough to have a header's worth of bytes in it......";
+  }
+  CHECK_FALSE(mapped.open(path));
+  std::remove(path);
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "catch.hpp"
+#include "../include/skyline.hpp"
+#include "../dependencies/jsl/jsl.hpp"
+
+// A structurally symmetric matrix with an irregular skyline and values that are not symmetric,
+// a little like a network with flows in it. Some skylines are tall enough for the vector kernels.
+static std::vector<std::vector<double>> network(size_t n)
+{
+  std::vector<std::vector<double>> M(n, std::vector<double>(n, 0.0));
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j : { i + 1, i + 5, i + 23 + (i % 7) }) {
+      if (j < n && (j != i + 5 || i % 3 == 0)) {
+        double flow = 0.1 * (double)((i * 7 + j) % 11);
+        M[i][j] = -1.0 - flow;
+        M[j][i] = -1.0 + 0.5 * flow;
+      }
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    double sum = 0.0;
+    for (size_t j = 0; j < n; ++j) {
+      sum += std::abs(M[i][j]) + std::abs(M[j][i]);
+    }
+    M[i][i] = sum + 1.0;
+  }
+  return M;
+}
+
+TEST_CASE("Nonsymmetric Skyline", "[NonsymmetricMatrix]")
+{
+  size_t n = 80;
+  auto M = network(n);
+  skyline::NonsymmetricMatrix<size_t, double, std::vector> skyline(M);
+  auto heights = skyline.heights();
+  CHECK(heights[1] == 1);
+  CHECK(heights[5] == 5);
+  CHECK(heights[6] == 1);
+  CHECK(heights[23] == 23);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      if (skyline.index(i, j)) {
+        CHECK(skyline(i, j) == M[i][j]);
+      } else {
+        CHECK(M[i][j] == 0.0);
+      }
+    }
+  }
+
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  std::vector<std::vector<double>> A(M);
+  std::vector<double> x(n), z(n);
+  std::vector<size_t> ip(n);
+  jsl::GEnxn<size_t, double, std::vector>(n, A, x, b, z, ip);
+
+  REQUIRE(skyline.ldu_solve(b));
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(b[i] == Approx(x[i]));
+  }
+}
+
+TEST_CASE("Nonsymmetric Skyline, Symmetric Values", "[NonsymmetricMatrix]")
+{
+  // With symmetric values the factors should be those of the symmetric matrix
+  std::vector<size_t> heights{ { 0, 1, 2, 1, 3, 2, 5 } };
+  skyline::NonsymmetricMatrix<size_t, double, std::vector> nonsymmetric(heights);
+  skyline::SymmetricMatrix<size_t, double, std::vector> symmetric(heights);
+  for (size_t k = 0; k < heights.size(); ++k) {
+    nonsymmetric(k, k) = symmetric(k, k) = 10.0 + k;
+    for (size_t i = k - heights[k]; i < k; ++i) {
+      nonsymmetric(i, k) = nonsymmetric(k, i) = symmetric(i, k) = -1.0 - 0.25 * i;
+    }
+  }
+  REQUIRE(nonsymmetric.ldu());
+  symmetric.utdu();
+  auto d = nonsymmetric.diagonal();
+  auto dr = symmetric.diagonal();
+  for (size_t i = 0; i < d.size(); ++i) {
+    CHECK(d[i] == Approx(dr[i]));
+  }
+  auto u = nonsymmetric.upper();
+  auto l = nonsymmetric.lower();
+  auto ur = symmetric.upper();
+  for (size_t i = 0; i < u.size(); ++i) {
+    CHECK(u[i] == Approx(ur[i]));
+    CHECK(l[i] == Approx(ur[i]));
+  }
+}
+
+TEST_CASE("Nonsymmetric Skyline, Zero Pivot", "[NonsymmetricMatrix]")
+{
+  // The leading 2x2 block is singular
+  std::vector<std::vector<double>> M{ { 1.0, 2.0, 0.0 }, { 3.0, 6.0, 1.0 }, { 0.0, 1.0, 4.0 } };
+  skyline::NonsymmetricMatrix<size_t, double, std::vector> skyline(M);
+  std::vector<double> b{ { 1.0, 2.0, 3.0 } };
+  CHECK_FALSE(skyline.ldu_solve(b));
+  CHECK(b == std::vector<double>({ 1.0, 2.0, 3.0 }));
+}
+
+TEST_CASE("Nonsymmetric Skyline, Pivot Not Finite", "[NonsymmetricMatrix]")
+{
+  // The second pivot overflows to minus infinity
+  std::vector<std::vector<double>> M{ { 1.0e-300, 1.0e300 }, { 1.0e300, 1.0 } };
+  skyline::NonsymmetricMatrix<size_t, double, std::vector> overflow(M);
+  CHECK_FALSE(overflow.ldu());
+  std::vector<double> b{ { 1.0, 2.0 } };
+  skyline::NonsymmetricMatrix<size_t, double, std::vector> solved(M);
+  CHECK_FALSE(solved.ldu_solve(b));
+  CHECK(b == std::vector<double>({ 1.0, 2.0 }));
+
+  // A value that is not a number carries through to the pivot
+  M[1][0] = std::numeric_limits<double>::quiet_NaN();
+  M[0][0] = 1.0;
+  skyline::NonsymmetricMatrix<size_t, double, std::vector> nan(M);
+  CHECK_FALSE(nan.ldu());
+}
@@ -0,0 +1,285 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "catch.hpp"
+#include "../include/skyline.hpp"
+#include "../dependencies/jsl/jsl.hpp"
+#include <random>
+
+// The graph of the five point Laplacian on an m by m grid, with the vertices numbered at random
+static std::vector<std::vector<size_t>> shuffled_grid(size_t m, std::vector<size_t> &number)
+{
+  size_t n = m * m;
+  number.resize(n);
+  std::iota(number.begin(), number.end(), (size_t)0);
+  std::mt19937 generator(1234);
+  std::shuffle(number.begin(), number.end(), generator);
+  std::vector<std::vector<size_t>> adjacency(n);
+  for (size_t k = 0; k < n; ++k) {
+    if (k % m != 0) {
+      adjacency[number[k]].push_back(number[k - 1]);
+    }
+    if (k >= m) {
+      adjacency[number[k]].push_back(number[k - m]);
+    }
+  }
+  return adjacency;
+}
+
+static bool is_permutation(const std::vector<size_t> &permutation)
+{
+  std::vector<size_t> sorted(permutation);
+  std::sort(sorted.begin(), sorted.end());
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    if (sorted[i] != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST_CASE("Graph Construction", "[Graph]")
+{
+  // One sided, repeated and self edges
+  std::vector<std::vector<size_t>> adjacency{ { 1, 1, 0 }, { 2 }, {}, { 0 } };
+  skyline::Graph<size_t, std::vector> graph(adjacency);
+  REQUIRE(graph.size() == 4);
+  CHECK(graph.neighbors(0) == std::vector<size_t>({ 1, 3 }));
+  CHECK(graph.neighbors(1) == std::vector<size_t>({ 0, 2 }));
+  CHECK(graph.neighbors(2) == std::vector<size_t>({ 1 }));
+  CHECK(graph.neighbors(3) == std::vector<size_t>({ 0 }));
+  CHECK(graph.heights() == std::vector<size_t>({ 0, 1, 1, 3 }));
+  CHECK(graph.profile() == 5);
+}
+
+TEST_CASE("RCM On A Path", "[Graph]")
+{
+  // A path numbered from both ends toward the middle, RCM should find the path again
+  size_t n = 21;
+  std::vector<std::vector<size_t>> adjacency(n);
+  std::vector<size_t> order;
+  for (size_t i = 0; i < n; ++i) {
+    order.push_back(i % 2 == 0 ? i / 2 : n - 1 - i / 2);
+  }
+  for (size_t i = 1; i < n; ++i) {
+    adjacency[order[i]].push_back(order[i - 1]);
+  }
+  skyline::Graph<size_t, std::vector> graph(adjacency);
+  CHECK(graph.profile() > 5 * n);
+  auto permutation = graph.rcm();
+  REQUIRE(is_permutation(permutation));
+  CHECK(graph.profile(permutation) == n - 1);
+}
+
+TEST_CASE("RCM On A Shuffled Grid", "[Graph]")
+{
+  size_t m = 20;
+  std::vector<size_t> number;
+  skyline::Graph<size_t, std::vector> graph(shuffled_grid(m, number));
+  auto permutation = graph.order(skyline::Ordering::RCM);
+  REQUIRE(is_permutation(permutation));
+  // The natural grid ordering has a profile of about m per vertex, a random one far more
+  CHECK(graph.profile() > 5 * m * m * m);
+  CHECK(graph.profile(permutation) < m * m * m);
+  // Separate components are each numbered
+  std::vector<std::vector<size_t>> two(graph.size() + 3);
+  for (size_t i = 0; i < graph.size(); ++i) {
+    two[i] = graph.neighbors(i);
+  }
+  two[graph.size() + 2].push_back(graph.size());
+  skyline::Graph<size_t, std::vector> disconnected(two);
+  CHECK(is_permutation(disconnected.rcm()));
+}
+
+TEST_CASE("Permuted Solve", "[PermutedMatrix]")
+{
+  // The shuffled grid Laplacian, solved in the RCM ordering and checked against the dense solver
+  size_t m = 8;
+  size_t n = m * m;
+  std::vector<size_t> number;
+  auto adjacency = shuffled_grid(m, number);
+  std::vector<std::vector<double>> M(n, std::vector<double>(n, 0.0));
+  for (size_t i = 0; i < n; ++i) {
+    M[i][i] = 4.0 + 0.1 * (i % 3);
+    for (size_t j : adjacency[i]) {
+      M[i][j] = M[j][i] = -1.0;
+    }
+  }
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (i % 5);
+  }
+
+  skyline::PermutedMatrix<size_t, double, std::vector> skyline(M);
+  skyline::Graph<size_t, std::vector> graph(adjacency);
+  CHECK(skyline.permutation() == graph.rcm());
+  CHECK(skyline.heights() == graph.heights(skyline.permutation()));
+  CHECK(skyline.structure()->profile() < graph.profile());
+  for (size_t i = 0; i < n; ++i) {
+    CHECK(skyline(i, i) == M[i][i]);
+    CHECK(skyline.diagonal(i) == M[i][i]);
+    for (size_t j : adjacency[i]) {
+      CHECK(skyline(i, j) == -1.0);
+      CHECK(skyline.index(i, j));
+    }
+  }
+
+  // The product, in the original numbering
+  std::vector<double> Mb(n);
+  skyline.multiply(b, Mb);
+  for (size_t i = 0; i < n; ++i) {
+    double sum = 0.0;
+    for (size_t j = 0; j < n; ++j) {
+      sum += M[i][j] * b[j];
+    }
+    CHECK(Mb[i] == Approx(sum));
+  }
+
+  std::vector<double> x(b);
+  skyline.ldlt_solve(x);
+
+  std::vector<std::vector<double>> A(M);
+  std::vector<double> y(n), z(n);
+  std::vector<size_t> ip(n);
+  jsl::GEnxn<size_t, double, std::vector>(n, A, y, b, z, ip);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(x[i] == Approx(y[i]));
+  }
+
+  // The same system twice over in a block with the factors already in place, the second copy scaled
+  std::vector<double> xb(2 * n);
+  for (size_t i = 0; i < n; ++i) {
+    xb[2 * i] = b[i];
+    xb[2 * i + 1] = -2.0 * b[i];
+  }
+  skyline.forward_substitution(xb, 2);
+  skyline.back_substitution(xb, 2);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(xb[2 * i] == Approx(y[i]));
+    CHECK(xb[2 * i + 1] == Approx(-2.0 * y[i]));
+  }
+
+  // A right hand side with two nonzeros, in the original numbering
+  std::vector<double> e(n, 0.0), f(n, 0.0);
+  e[3] = f[3] = 1.0;
+  e[n - 2] = f[n - 2] = -2.0;
+  skyline.sparse_forward_substitution(e, { 3, n - 2 });
+  skyline.back_substitution(e);
+  skyline.forward_substitution(f);
+  skyline.back_substitution(f);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(e[i] == Approx(f[i]));
+  }
+
+  // Only a few of the unknowns, in the original numbering
+  std::vector<double> g(b);
+  skyline.forward_substitution(g);
+  skyline.partial_back_substitution(g, { 0, n - 1, 17 });
+  CHECK(g[0] == Approx(y[0]));
+  CHECK(g[n - 1] == Approx(y[n - 1]));
+  CHECK(g[17] == Approx(y[17]));
+}
+
+TEST_CASE("Sloan And GPS Orderings", "[Graph]")
+{
+  size_t m = 20;
+  std::vector<size_t> number;
+  auto adjacency = shuffled_grid(m, number);
+  // A second, irregular component: a star with a tail
+  size_t n = m * m;
+  adjacency.resize(n + 12);
+  for (size_t i = 1; i < 8; ++i) {
+    adjacency[n + i].push_back(n);
+  }
+  for (size_t i = 8; i < 12; ++i) {
+    adjacency[n + i].push_back(n + i - 1);
+  }
+  skyline::Graph<size_t, std::vector> graph(adjacency);
+  for (auto ordering : { skyline::Ordering::Sloan, skyline::Ordering::GPS }) {
+    auto permutation = graph.order(ordering);
+    REQUIRE(is_permutation(permutation));
+    CHECK(graph.profile(permutation) < m * m * m);
+  }
+
+  auto results = graph.compare();
+  REQUIRE(results.size() == 4);
+  CHECK(results[0].ordering == skyline::Ordering::Natural);
+  CHECK(results[0].profile == graph.profile());
+  size_t smallest = results[0].profile;
+  double seconds = 0.0;
+  for (auto &result : results) {
+    CHECK(result.profile == graph.profile(result.permutation));
+    CHECK(result.seconds >= 0.0);
+    smallest = std::min(smallest, result.profile);
+    seconds += result.seconds;
+  }
+  auto best = graph.best();
+  CHECK(best.ordering != skyline::Ordering::Natural);
+  CHECK(best.ordering != skyline::Ordering::Best);
+  CHECK(best.profile == smallest);
+  CHECK(graph.profile(graph.order(skyline::Ordering::Best)) == smallest);
+}
+
+TEST_CASE("Permuted Solve With The Best Ordering", "[PermutedMatrix]")
+{
+  size_t m = 8;
+  size_t n = m * m;
+  std::vector<size_t> number;
+  auto adjacency = shuffled_grid(m, number);
+  skyline::Graph<size_t, std::vector> graph(adjacency);
+  auto best = graph.best();
+  skyline::PermutedMatrix<size_t, double, std::vector> skyline(graph, best.permutation);
+  CHECK(skyline.structure()->profile() == best.profile);
+  CHECK(skyline.permutation() == skyline::PermutedMatrix<size_t, double, std::vector>(graph,
+    skyline::Ordering::Best).permutation());
+
+  std::vector<std::vector<double>> M(n, std::vector<double>(n, 0.0));
+  for (size_t i = 0; i < n; ++i) {
+    skyline.diagonal(i) = M[i][i] = 4.0;
+    for (size_t j : adjacency[i]) {
+      skyline(i, j) = M[i][j] = M[j][i] = -1.0;
+    }
+  }
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (i % 5);
+  }
+  std::vector<double> x(b);
+  skyline.ldlt_solve(x);
+
+  std::vector<double> y(n), z(n);
+  std::vector<size_t> ip(n);
+  jsl::GEnxn<size_t, double, std::vector>(n, M, y, b, z, ip);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(x[i] == Approx(y[i]));
+  }
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2019, Alliance for Sustainable Energy, LLC
+// Copyright (c) 2019, Jason W. DeGraw
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "catch.hpp"
+#include "../include/outofcore.hpp"
+#include "../include/skyline.hpp"
+#include <cstdio>
+#include <vector>
+
+TEST_CASE("Out Of Core Factorization", "[OutOfCoreMatrix]")
+{
+  // An irregular skyline in compressed sparse rows, factored in memory to check against
+  size_t n = 500;
+  std::vector<size_t> offsets{ 0 }, indices;
+  std::vector<double> values;
+  for (size_t i = 0; i < n; ++i) {
+    size_t height = std::min(i, (i * 31) % 60);
+    for (size_t j = i - height; j < i; j += 1 + (j % 4)) {
+      indices.push_back(j);
+      values.push_back(-1.0 + 0.01 * ((i + j) % 17));
+    }
+    indices.push_back(i);
+    values.push_back(80.0 + (double)(i % 9));
+    offsets.push_back(indices.size());
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> memory(offsets, indices, values);
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  std::vector<double> x(b);
+  memory.ldlt_solve(x);
+
+  const char *path = "outofcore_tests.sky";
+  // Windows from a block per column up to everything in one block
+  for (size_t window : { (size_t)1, (size_t)3000, (size_t)24000, (size_t)1000000 }) {
+    INFO("Window " << window);
+    skyline::OutOfCoreMatrix<size_t, double, std::vector> disk(memory.heights(), path, window);
+    REQUIRE(disk.good());
+    if (window == 1) {
+      // The first column is empty, it goes in with the second
+      CHECK(disk.blocks() == n - 1);
+    } else if (window == 1000000) {
+      CHECK(disk.blocks() == 1);
+    } else {
+      CHECK(disk.blocks() > 1);
+    }
+    CHECK_FALSE(disk.assign_compressed(std::vector<size_t>(), indices, values));
+    CHECK(disk.assign_compressed(offsets, indices, values));
+    std::vector<double> y(b);
+    CHECK(disk.ldlt_solve(y));
+    CHECK(disk.factored());
+    std::vector<double> d = disk.diagonal();
+    std::vector<double> e = memory.diagonal();
+    for (size_t i = 0; i < n; ++i) {
+      INFO("Error at index " << i);
+      CHECK(d[i] == Approx(e[i]));
+      CHECK(y[i] == Approx(x[i]));
+    }
+    // Solving again uses the factors as they are
+    std::vector<double> z(b);
+    CHECK(disk.ldlt_solve(z));
+    CHECK(z == y);
+  }
+  std::remove(path);
+}
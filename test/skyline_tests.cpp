@@ -828,3 +828,1293 @@ TEST_CASE("Case 5 - ADAD, Skyline Skip w/out Skip Incremental 4x4", "[SymmetricS
   }
 
 }
+
+TEST_CASE("Irregular Skyline", "[SymmetricMatrix]")
+{
+  // Diagonally dominant matrix with column tops that are not monotone
+  size_t N = 12;
+  std::vector<std::vector<double>> M(N, std::vector<double>(N, 0.0));
+  std::vector<std::pair<size_t, size_t>> links{ { {0, 3}, {1, 2}, {0, 5}, {4, 5}, {2, 6}, {6, 7}, {1, 8},
+    {7, 8}, {8, 9}, {5, 10}, {9, 10}, {10, 11}, {3, 11} } };
+  for (size_t i = 0; i < N; ++i) {
+    M[i][i] = 5.0 + 0.1*i;
+  }
+  for (auto &link : links) {
+    M[link.first][link.second] = -1.0 - 0.01*link.first;
+    M[link.second][link.first] = -1.0 - 0.01*link.first;
+  }
+  std::vector<double> b(N);
+  for (size_t i = 0; i < N; ++i) {
+    b[i] = 1.0 + i;
+  }
+
+  skyline::SymmetricMatrix<size_t, double, std::vector> skyline(M);
+
+  REQUIRE(skyline.minima().size() == N);
+  CHECK(skyline.minima()[3] == 0);
+  CHECK(skyline.minima()[4] == 4);
+  CHECK(skyline.minima()[6] == 2);
+  CHECK(skyline.minima()[11] == 3);
+
+  std::vector<std::vector<double>> A(M);
+  std::vector<double> x(N), z(N);
+  std::vector<size_t> ip(N);
+  jsl::GEnxn<size_t, double, std::vector>(N, A, x, b, z, ip);
+
+  skyline.ldlt_solve(b);
+  for (size_t i = 0; i < N; ++i) {
+    INFO("Error at index " << i);
+    CHECK(x[i] == Approx(b[i]));
+  }
+}
+
+TEST_CASE("Blocked Panel Factorization", "[SymmetricMatrix]")
+{
+  // Laplacian on a 40x40 grid, the band is wide enough to be factored in panels. Every
+  // seventh column is a little taller to break up the panels.
+  size_t m = 40;
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m + (k % 7 == 0 ? 3 : 0));
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> skyline(heights);
+  for (size_t k = 0; k < n; ++k) {
+    skyline(k, k) = 4.0;
+    if (k % m != 0) {
+      skyline(k - 1, k) = -1.0;
+    }
+    if (k >= m) {
+      skyline(k - m, k) = -1.0;
+    }
+    if (k % 7 == 0 && k >= m + 3) {
+      skyline(k - m - 3, k) = -0.5;
+    }
+  }
+  REQUIRE(!skyline.panels().empty());
+  CHECK(skyline.blocked());
+
+  skyline::SymmetricMatrix<size_t, double, std::vector> reference(skyline);
+  reference.blocked(false);
+
+  std::vector<double> b(n), x(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  x = b;
+
+  skyline.ldlt_solve(b);
+  reference.ldlt_solve(x);
+
+  auto d = skyline.diagonal();
+  auto dr = reference.diagonal();
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(d[i] == Approx(dr[i]));
+    CHECK(b[i] == Approx(x[i]));
+  }
+  auto u = skyline.upper();
+  auto ur = reference.upper();
+  REQUIRE(u.size() == ur.size());
+  for (size_t i = 0; i < u.size(); ++i) {
+    INFO("Error at index " << i);
+    CHECK(u[i] == Approx(ur[i]).margin(1.0e-12));
+  }
+}
+
+TEST_CASE("Threaded Factorization", "[SymmetricMatrix]")
+{
+  // Laplacian on a 64x64 grid with a few taller columns, wide enough that most steps are split
+  // among the threads. Each element gets the same operations in the same order no matter which
+  // thread does them, so the factors should match the serial ones exactly.
+  size_t m = 64;
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m + (k % 7 == 0 ? 3 : 0));
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> original(heights);
+  for (size_t k = 0; k < n; ++k) {
+    original(k, k) = 4.0;
+    if (k % m != 0) {
+      original(k - 1, k) = -1.0;
+    }
+    if (k >= m) {
+      original(k - m, k) = -1.0;
+    }
+    if (k % 7 == 0 && k >= m + 3) {
+      original(k - m - 3, k) = -0.5;
+    }
+  }
+  CHECK(original.threads() == 1);
+
+  for (bool blocked : { true, false }) {
+    skyline::SymmetricMatrix<size_t, double, std::vector> reference(original);
+    reference.blocked(blocked);
+    reference.utdu();
+    auto dr = reference.diagonal();
+    auto ur = reference.upper();
+    for (unsigned threads : { 2u, 3u, 4u }) {
+      INFO("Blocked: " << blocked << ", threads: " << threads);
+      skyline::SymmetricMatrix<size_t, double, std::vector> skyline(original);
+      skyline.blocked(blocked);
+      skyline.threads(threads);
+      CHECK(skyline.threads() == threads);
+      skyline.utdu();
+      CHECK(skyline.diagonal() == dr);
+      CHECK(skyline.upper() == ur);
+    }
+  }
+}
+
+TEST_CASE("Multiple Right Hand Sides", "[SymmetricMatrix]")
+{
+  // Laplacian on a 30x30 grid with a few taller columns, solved for blocks of right hand sides
+  // of several widths to get through each part of the kernels
+  size_t m = 30;
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m + (k % 7 == 0 ? 3 : 0));
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> original(heights);
+  for (size_t k = 0; k < n; ++k) {
+    original(k, k) = 4.0;
+    if (k % m != 0) {
+      original(k - 1, k) = -1.0;
+    }
+    if (k >= m) {
+      original(k - m, k) = -1.0;
+    }
+    if (k % 7 == 0 && k >= m + 3) {
+      original(k - m - 3, k) = -0.5;
+    }
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> single(original);
+  single.utdu();
+
+  for (size_t nrhs : { 1, 3, 8, 37, 64 }) {
+    INFO("Right hand sides: " << nrhs);
+    std::vector<double> b(n * nrhs);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t r = 0; r < nrhs; ++r) {
+        b[nrhs * i + r] = 1.0 + (double)((i + 3 * r) % 5) - 0.1 * r;
+      }
+    }
+    std::vector<double> x(b);
+    skyline::SymmetricMatrix<size_t, double, std::vector> skyline(original);
+    skyline.ldlt_solve(x, nrhs);
+    for (size_t r = 0; r < nrhs; ++r) {
+      std::vector<double> y(n);
+      for (size_t i = 0; i < n; ++i) {
+        y[i] = b[nrhs * i + r];
+      }
+      single.forward_substitution(y);
+      single.back_substitution(y);
+      for (size_t i = 0; i < n; ++i) {
+        INFO("Error at index " << i << " of right hand side " << r);
+        CHECK(x[nrhs * i + r] == Approx(y[i]));
+      }
+    }
+  }
+}
+
+TEST_CASE("Batched Factorization", "[BatchedSymmetricMatrix]")
+{
+  // A batch of small matrices with an irregular skyline and different values, checked
+  // against factoring and solving each of them on its own
+  std::vector<size_t> heights{ 0, 1, 2, 1, 3, 4, 1, 6, 2, 3, 9, 1, 2, 12, 3, 5, 4, 2, 17, 1 };
+  size_t n = heights.size();
+  auto structure = std::make_shared<const skyline::Structure<size_t, std::vector>>(heights);
+  skyline::BatchedSymmetricMatrix<size_t, double, std::vector> batch(structure);
+  size_t w = batch.width();
+  CHECK(w == 8);
+  std::vector<std::vector<double>> values(w);
+  std::vector<double> b(n * w);
+  for (size_t s = 0; s < w; ++s) {
+    values[s].resize(n + structure->profile());
+    for (size_t i = 0; i < n; ++i) {
+      values[s][i] = 30.0 + s + 0.5 * (i % 3);
+      b[w * i + s] = 1.0 + (double)((i + s) % 5);
+    }
+    for (size_t i = n; i < values[s].size(); ++i) {
+      values[s][i] = -1.0 + 0.1 * s + 0.01 * (i % 7);
+    }
+    batch.set(s, values[s]);
+  }
+  CHECK(batch(0, 0, 3) == 33.0);
+  CHECK(batch(4, 3, 2) == values[2][*batch.index(3, 4)]);
+  CHECK(batch.values(5) == values[5]);
+
+  std::vector<double> x(b);
+  batch.ldlt_solve(x);
+  for (size_t s = 0; s < w; ++s) {
+    skyline::SymmetricMatrix<size_t, double, std::vector> single(structure);
+    single.refactor(values[s]);
+    std::vector<double> factors = single.diagonal();
+    std::vector<double> upper = single.upper();
+    factors.insert(factors.end(), upper.begin(), upper.end());
+    std::vector<double> batched = batch.values(s);
+    for (size_t i = 0; i < factors.size(); ++i) {
+      INFO("Error at index " << i << " of matrix " << s);
+      CHECK(batched[i] == Approx(factors[i]));
+    }
+    std::vector<double> y(n);
+    for (size_t i = 0; i < n; ++i) {
+      y[i] = b[w * i + s];
+    }
+    single.forward_substitution(y);
+    single.back_substitution(y);
+    for (size_t i = 0; i < n; ++i) {
+      INFO("Error at index " << i << " of matrix " << s);
+      CHECK(x[w * i + s] == Approx(y[i]));
+    }
+  }
+}
+
+TEST_CASE("Fixed Structure Factorization", "[FixedSymmetricMatrix]")
+{
+  // The skyline of the batched test, cut down to ten unknowns, fixed when compiled and checked
+  // against the same values in a SymmetricMatrix
+  typedef skyline::FixedSymmetricMatrix<size_t, double, 0, 1, 2, 1, 3, 4, 1, 6, 2, 3> Fixed;
+  static_assert(Fixed::rows() == 10, "Wrong size");
+  static_assert(skyline::FixedStructure<size_t, 0, 1, 2, 1, 3, 4, 1, 6, 2, 3>::profile() == 23, "Wrong profile");
+  static_assert(Fixed::offsets()[9] == 20, "Wrong offset");
+  static_assert(Fixed::minima()[7] == 1, "Wrong top");
+  static_assert(*Fixed::index(4, 1) == 10 + 4 + 0, "Wrong index");
+  static_assert(!Fixed::index(0, 3), "Index outside of the skyline");
+  static_assert(skyline::FixedStructure<size_t, 0, 1, 2>::valid(), "A valid skyline");
+  static_assert(!skyline::FixedStructure<size_t, 1, 1, 2>::valid(), "The first column reaches above the first row");
+  static_assert(!skyline::FixedStructure<size_t, 0, 1, 3>::valid(), "The last column reaches above the first row");
+
+  std::vector<size_t> heights{ 0, 1, 2, 1, 3, 4, 1, 6, 2, 3 };
+  size_t n = heights.size();
+  skyline::SymmetricMatrix<size_t, double, std::vector> single(heights);
+  std::array<double, 33> values;
+  for (size_t i = 0; i < n; ++i) {
+    values[i] = 12.0 + 0.5 * (i % 3);
+  }
+  for (size_t i = n; i < values.size(); ++i) {
+    values[i] = -1.0 + 0.01 * (i % 7);
+  }
+  Fixed fixed;
+  for (size_t j = 0; j < n; ++j) {
+    for (size_t i = j - heights[j]; i <= j; ++i) {
+      auto ij = Fixed::index(i, j);
+      REQUIRE(ij);
+      REQUIRE(*ij == *single.index(i, j));
+      fixed(i, j) = values[*ij];
+      single(i, j) = values[*ij];
+    }
+  }
+  CHECK(fixed(4, 1) == values[14]);
+  CHECK(fixed(1, 4) == values[14]);
+
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  std::vector<double> x(b);
+  std::array<double, 10> y;
+  std::copy(b.begin(), b.end(), y.begin());
+  single.ldlt_solve(x);
+  fixed.ldlt_solve(y);
+  std::vector<double> d = single.diagonal();
+  std::vector<double> u = single.upper();
+  auto fd = fixed.diagonal();
+  auto fu = fixed.upper();
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(fd[i] == Approx(d[i]));
+    CHECK(y[i] == Approx(x[i]));
+  }
+  for (size_t i = 0; i < u.size(); ++i) {
+    INFO("Error at index " << i);
+    CHECK(fu[i] == Approx(u[i]));
+  }
+
+  // Refactoring from the values in index order, and solving into a vector
+  fixed.refactor(values);
+  std::vector<double> z(b);
+  fixed.forward_substitution(z);
+  fixed.back_substitution(z);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(z[i] == Approx(x[i]));
+  }
+
+  // A single unknown, and a diagonal matrix
+  skyline::FixedSymmetricMatrix<size_t, double, 0> one;
+  one(0, 0) = 4.0;
+  std::array<double, 1> c{ { 2.0 } };
+  one.ldlt_solve(c);
+  CHECK(c[0] == 0.5);
+  skyline::FixedSymmetricMatrix<size_t, float, 0, 0, 0> diagonal;
+  diagonal.fill(2.0f);
+  std::vector<float> e{ 1.0f, 2.0f, 3.0f };
+  diagonal.ldlt_solve(e);
+  CHECK(e[2] == 1.5f);
+}
+
+TEST_CASE("Level Scheduled Solves", "[SymmetricMatrix]")
+{
+  // A band has a level per row, there is nothing to solve at the same time
+  std::vector<size_t> band(50);
+  for (size_t k = 0; k < band.size(); ++k) {
+    band[k] = std::min(k, (size_t)3);
+  }
+  skyline::Structure<size_t, std::vector> banded(band);
+  CHECK(banded.forward_levels() == 50);
+  CHECK(banded.back_levels() == 50);
+
+  // Many dense blocks that do not touch each other, the rows in the same place in each block
+  // make up a level. The later levels have enough work to be split among the threads.
+  size_t blocks = 64;
+  size_t m = 60;
+  size_t n = blocks * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = k % m;
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> original(heights);
+  CHECK(original.structure()->forward_levels() == m);
+  CHECK(original.structure()->back_levels() == m);
+  for (size_t k = 0; k < n; ++k) {
+    original(k, k) = 100.0 + (double)(k % 7);
+    for (size_t i = k - k % m; i < k; ++i) {
+      original(i, k) = -1.0 + 0.01 * ((i + k) % 11);
+    }
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> serial(original);
+  skyline::SymmetricMatrix<size_t, double, std::vector> threaded(original);
+  threaded.threads(4);
+  serial.utdu();
+  threaded.utdu();
+
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  std::vector<double> x(b), y(b);
+  serial.forward_substitution(x);
+  serial.back_substitution(x);
+  threaded.forward_substitution(y);
+  threaded.back_substitution(y);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(y[i] == Approx(x[i]));
+  }
+
+  // Several right hand sides, split among the threads
+  size_t nrhs = 40;
+  std::vector<double> bb(n * nrhs);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t r = 0; r < nrhs; ++r) {
+      bb[nrhs * i + r] = b[i] * (1.0 + r);
+    }
+  }
+  threaded.forward_substitution(bb, nrhs);
+  threaded.back_substitution(bb, nrhs);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t r = 0; r < nrhs; ++r) {
+      INFO("Error at index " << i << " of right hand side " << r);
+      CHECK(bb[nrhs * i + r] == Approx(x[i] * (1.0 + r)));
+    }
+  }
+
+  // The same blocks with a border at the end whose skyline reaches every row, the shape nested
+  // dissection gives. The matrix is connected, but the blocks still share levels, and the
+  // border adds one level per row.
+  size_t w = 20;
+  std::vector<size_t> bordered(n + w);
+  for (size_t k = 0; k < n + w; ++k) {
+    bordered[k] = k < n ? k % m : k;
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> coupled(bordered);
+  CHECK(coupled.structure()->forward_levels() == m + w);
+  CHECK(coupled.structure()->back_levels() == m + w);
+  for (size_t k = 0; k < n + w; ++k) {
+    coupled(k, k) = 100.0 + (double)(k % 7);
+    for (size_t i = k - bordered[k]; i < k; ++i) {
+      coupled(i, k) = -1.0 + 0.01 * ((i + k) % 11);
+    }
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> coupled_threaded(coupled);
+  coupled_threaded.threads(4);
+  coupled.utdu();
+  coupled_threaded.utdu();
+  b.resize(n + w, 1.0);
+  x = b;
+  y = b;
+  coupled.forward_substitution(x);
+  coupled.back_substitution(x);
+  coupled_threaded.forward_substitution(y);
+  coupled_threaded.back_substitution(y);
+  for (size_t i = 0; i < n + w; ++i) {
+    INFO("Error at index " << i);
+    CHECK(y[i] == Approx(x[i]));
+  }
+}
+
+TEST_CASE("Sparse Right Hand Side", "[SymmetricMatrix]")
+{
+  // Dense blocks of 10 with a band of 3 coupling the last five blocks. A nonzero in one of the
+  // separate blocks only reaches the rest of its block, in the coupled part it reaches every
+  // row after it.
+  size_t m = 10;
+  size_t n = 10 * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = k >= 5 * m + 1 ? 3 : k % m;
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> skyline(heights);
+  for (size_t k = 0; k < n; ++k) {
+    skyline(k, k) = 20.0;
+    for (size_t i = k - heights[k]; i < k; ++i) {
+      skyline(i, k) = -1.0 + 0.1 * ((i + k) % 3);
+    }
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> unfactored(skyline);
+  skyline.utdu();
+
+  CHECK(skyline.reach({ 23 }) == std::vector<size_t>({ 23, 24, 25, 26, 27, 28, 29 }));
+  CHECK(skyline.reach({ 27, 5, 23 }) == std::vector<size_t>({ 5, 6, 7, 8, 9, 23, 24, 25, 26, 27, 28, 29 }));
+  CHECK(skyline.reach({ 90 }).size() == 10);
+  CHECK(skyline.reach({}).empty());
+
+  for (auto nonzeros : { std::vector<size_t>{ 23 }, std::vector<size_t>{ 27, 5, 23 }, std::vector<size_t>{ 41, 77 } }) {
+    std::vector<double> b(n, 0.0);
+    for (size_t i : nonzeros) {
+      b[i] = 1.0 + 0.5 * i;
+    }
+    std::vector<double> x(b);
+    skyline.forward_substitution(x);
+    auto rows = skyline.sparse_forward_substitution(b, nonzeros);
+    CHECK(rows == skyline.reach(nonzeros));
+    for (size_t i = 0; i < n; ++i) {
+      INFO("Error at index " << i);
+      CHECK(b[i] == Approx(x[i]));
+    }
+  }
+
+  // Only some of the solution, in a separate block, in the coupled part and in both
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  std::vector<double> x(b);
+  skyline.forward_substitution(x);
+  skyline.back_substitution(x);
+  for (auto rows : { std::vector<size_t>{ 25 }, std::vector<size_t>{ 95, 60 }, std::vector<size_t>{ 3, 99, 47, 3 } }) {
+    std::vector<double> y(b);
+    skyline.forward_substitution(y);
+    skyline.partial_back_substitution(y, rows);
+    for (size_t i : rows) {
+      INFO("Error at index " << i);
+      CHECK(y[i] == Approx(x[i]));
+    }
+  }
+  std::vector<double> y(b);
+  auto values = unfactored.partial_solve(y, { 97, 12 });
+  REQUIRE(values.size() == 2);
+  CHECK(values[0] == Approx(x[97]));
+  CHECK(values[1] == Approx(x[12]));
+}
+
+TEST_CASE("Matrix Vector Product", "[SymmetricMatrix]")
+{
+  // An irregular skyline, long enough that the product is split among the threads
+  size_t n = 600;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, (size_t)((k * 37) % 90));
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> matrix(heights);
+  std::vector<std::vector<double>> M(n, std::vector<double>(n, 0.0));
+  std::vector<double> x(n);
+  for (size_t k = 0; k < n; ++k) {
+    matrix(k, k) = M[k][k] = 50.0 + (double)(k % 7);
+    for (size_t i = k - heights[k]; i < k; ++i) {
+      matrix(i, k) = M[i][k] = M[k][i] = -0.5 + 0.01 * ((i + 3 * k) % 13);
+    }
+    x[k] = 1.0 - 0.003 * k;
+  }
+  std::vector<double> Ax(n, 0.0);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      Ax[i] += M[i][j] * x[j];
+    }
+  }
+
+  std::vector<double> y(n, 7.0);
+  matrix.multiply(x, y);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(y[i] == Approx(Ax[i]));
+  }
+  matrix.multiply_add(x, y, -2.0);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(y[i] == Approx(-Ax[i]));
+  }
+
+  skyline::SymmetricMatrix<size_t, double, std::vector> threaded(matrix);
+  threaded.threads(3);
+  std::vector<double> z(n, 1.0);
+  threaded.multiply_add(x, z);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(z[i] == Approx(Ax[i] + 1.0));
+  }
+
+  // With tracking, the product is with the values that were factored
+  threaded.track(true);
+  threaded.utdu();
+  threaded.multiply(x, z);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(z[i] == Approx(Ax[i]));
+  }
+}
+
+TEST_CASE("Preconditioned Conjugate Gradient", "[ConjugateGradientMatrix]")
+{
+  // The grid Laplacian, with a direct solve to check against
+  size_t m = 20;
+  size_t n = m * m;
+  std::vector<std::vector<double>> M(n, std::vector<double>(n, 0.0));
+  std::vector<double> b(n);
+  for (size_t k = 0; k < n; ++k) {
+    M[k][k] = 4.0 + 0.01 * (k % 3);
+    if (k % m != 0) {
+      M[k][k - 1] = M[k - 1][k] = -1.0;
+    }
+    if (k >= m) {
+      M[k][k - m] = M[k - m][k] = -1.0;
+    }
+    b[k] = 1.0 + (double)(k % 7);
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> direct(M);
+  std::vector<double> x(b);
+  direct.ldlt_solve(x);
+
+  skyline::ConjugateGradientMatrix<size_t, double, std::vector> cg(M);
+  CHECK(cg(3, 2) == -1.0);
+  CHECK(cg(2 + m, 2) == -1.0);
+  CHECK_FALSE(cg.index(2, 5));
+  std::vector<double> y(n), z(n);
+  cg.multiply(b, y);
+  for (size_t i = 0; i < n; ++i) {
+    double sum = 0.0;
+    for (size_t j = 0; j < n; ++j) {
+      sum += M[i][j] * b[j];
+    }
+    CHECK(y[i] == Approx(sum));
+  }
+
+  // By default the preconditioner is tridiagonal, far smaller than the skyline
+  CHECK(cg.band() == 1);
+  CHECK(cg.drop_tolerance() == 0.0);
+  z = b;
+  CHECK(cg.solve(z));
+  CHECK(cg.iterations() > 1);
+  CHECK(cg.preconditioner()->structure()->profile() <= n);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(z[i] == Approx(x[i]).epsilon(1.0e-6));
+  }
+
+  // With the whole skyline the preconditioner is the exact factorization
+  cg.band(n);
+  z = b;
+  CHECK(cg.solve(z));
+  CHECK(cg.iterations() == 1);
+  CHECK(cg.preconditioner()->structure()->profile() == direct.structure()->profile());
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(z[i] == Approx(x[i]));
+  }
+
+  // A narrow band, and a band that drops the entries m rows away, cost iterations
+  for (size_t band : { m, m - 1, (size_t)1, (size_t)0 }) {
+    INFO("Band " << band);
+    cg.band(band);
+    z = b;
+    CHECK(cg.solve(z));
+    CHECK(cg.history().size() == cg.iterations() + 1);
+    CHECK(cg.history().back() <= cg.tolerance());
+    CHECK(cg.preconditioner()->structure()->profile() <= n * band);
+    for (size_t i = 0; i < n; ++i) {
+      INFO("Error at index " << i);
+      CHECK(z[i] == Approx(x[i]).epsilon(1.0e-6));
+    }
+  }
+  size_t narrow = cg.iterations();
+  cg.band(1);
+  z = b;
+  cg.solve(z);
+  CHECK(cg.iterations() > 1);
+  CHECK(narrow >= cg.iterations());
+
+  // Dropping every entry off the diagonal leaves a diagonal preconditioner
+  cg.band(n);
+  cg.drop_tolerance(0.5);
+  z = b;
+  CHECK(cg.solve(z));
+  CHECK(cg.preconditioner()->structure()->profile() == 0);
+  CHECK(cg.shift() == 0.0);
+  CHECK(cg.iterations() >= narrow);
+
+  // Too few iterations to get there
+  cg.maximum_iterations(2);
+  z = b;
+  CHECK_FALSE(cg.solve(z));
+  CHECK(cg.iterations() == 2);
+
+  // A positive definite matrix whose band of one is not, so the preconditioner needs a shift
+  std::vector<std::vector<double>> T{ { 1.0, 0.9, 0.8 }, { 0.9, 1.0, 0.9 }, { 0.8, 0.9, 1.0 } };
+  std::vector<double> c{ 1.0, 2.0, 3.0 };
+  skyline::SymmetricMatrix<size_t, double, std::vector> exact(T);
+  std::vector<double> u(c);
+  exact.ldlt_solve(u);
+  skyline::ConjugateGradientMatrix<size_t, double, std::vector> shifted(T);
+  shifted.band(1);
+  CHECK(shifted.precondition());
+  CHECK(shifted.shift() > 0.0);
+  auto d = shifted.preconditioner()->diagonal();
+  for (double v : d) {
+    CHECK(v > 0.0);
+  }
+  std::vector<double> w(c);
+  CHECK(shifted.solve(w));
+  for (size_t i = 0; i < 3; ++i) {
+    INFO("Error at index " << i);
+    CHECK(w[i] == Approx(u[i]).epsilon(1.0e-6).margin(1.0e-8));
+  }
+
+  // A negative diagonal entry can't be shifted away, so there is no preconditioner and no solve
+  T[1][1] = -1.0;
+  skyline::ConjugateGradientMatrix<size_t, double, std::vector> indefinite(T);
+  indefinite.band(1);
+  CHECK_FALSE(indefinite.precondition());
+  CHECK(indefinite.shift() == indefinite.maximum_shift);
+  CHECK(indefinite.preconditioner() == nullptr);
+  w = c;
+  CHECK_FALSE(indefinite.solve(w));
+  CHECK(indefinite.iterations() == 0);
+  CHECK(w == c);
+}
+
+TEST_CASE("Triplet Assembly", "[TripletAssembler]")
+{
+  // The grid Laplacian from the stencils of the cells, each edge split in half between the two
+  // cells on either side of it, added in a scrambled order
+  size_t m = 12;
+  size_t n = m * m;
+  std::vector<std::vector<double>> M(n, std::vector<double>(n, 0.0));
+  std::vector<std::pair<size_t, size_t>> edges;
+  for (size_t k = 0; k < n; ++k) {
+    M[k][k] = 4.0 + 0.1 * (k % 3);
+    if (k % m != 0) {
+      M[k][k - 1] = M[k - 1][k] = -1.0;
+      edges.push_back({ k - 1, k });
+    }
+    if (k >= m) {
+      M[k][k - m] = M[k - m][k] = -1.0 + 0.01 * (k % 5);
+      edges.push_back({ k, k - m });
+    }
+  }
+  skyline::TripletAssembler<size_t, double, std::vector> assembler;
+  for (size_t e = 0; e < edges.size(); ++e) {
+    size_t p = (e * 7) % edges.size();
+    size_t i = edges[p].first;
+    size_t j = edges[p].second;
+    assembler.add(i, j, 0.5 * M[i][j]);
+    assembler.add(j, i, 0.5 * M[i][j]);
+  }
+  for (size_t k = n; k-- > 0;) {
+    assembler.add(k, k, M[k][k]);
+  }
+  CHECK(assembler.size() == n);
+  CHECK(assembler.count() == 2 * edges.size() + n);
+
+  skyline::SymmetricMatrix<size_t, double, std::vector> dense(M);
+  skyline::SymmetricMatrix<size_t, double, std::vector> skyline = assembler.matrix();
+  CHECK(assembler.heights() == dense.heights());
+  CHECK(skyline.heights() == dense.heights());
+  CHECK(skyline.diagonal() == dense.diagonal());
+  std::vector<double> u = skyline.upper();
+  std::vector<double> v = dense.upper();
+  REQUIRE(u.size() == v.size());
+  for (size_t i = 0; i < u.size(); ++i) {
+    CHECK(u[i] == Approx(v[i]));
+  }
+
+  // Again into the same matrix, after it has been factored
+  std::vector<double> b(n, 1.0), x(b);
+  dense.ldlt_solve(x);
+  skyline.utdu();
+  assembler.assemble(skyline);
+  std::vector<double> y(b);
+  skyline.ldlt_solve(y);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(y[i] == Approx(x[i]));
+  }
+
+  // In a new numbering
+  skyline::PermutedMatrix<size_t, double, std::vector> permuted(assembler.graph());
+  assembler.assemble(permuted);
+  CHECK(permuted.structure()->profile() <= skyline.structure()->profile());
+  std::vector<double> z(b);
+  permuted.ldlt_solve(z);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(z[i] == Approx(x[i]));
+  }
+}
+
+TEST_CASE("Compressed Sparse Rows", "[SymmetricMatrix]")
+{
+  // The grid Laplacian in compressed sparse rows, whole and as the lower triangle
+  size_t m = 20;
+  size_t n = m * m;
+  std::vector<std::vector<double>> M(n, std::vector<double>(n, 0.0));
+  for (size_t k = 0; k < n; ++k) {
+    M[k][k] = 4.0 + 0.1 * (k % 3);
+    if (k % m != 0) {
+      M[k][k - 1] = M[k - 1][k] = -1.0 + 0.01 * (k % 7);
+    }
+    if (k >= m) {
+      M[k][k - m] = M[k - m][k] = -1.0;
+    }
+  }
+  std::vector<size_t> offsets{ 0 }, indices, lower_offsets{ 0 }, lower_indices;
+  std::vector<double> values, lower_values;
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      if (M[i][j] != 0.0) {
+        indices.push_back(j);
+        values.push_back(M[i][j]);
+        if (j <= i) {
+          lower_indices.push_back(j);
+          lower_values.push_back(M[i][j]);
+        }
+      }
+    }
+    offsets.push_back(indices.size());
+    lower_offsets.push_back(lower_indices.size());
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> dense(M);
+  CHECK(skyline::SymmetricMatrix<size_t, double, std::vector>::compressed_heights(offsets, indices) == dense.heights());
+  skyline::SymmetricMatrix<size_t, double, std::vector> whole(offsets, indices, values);
+  skyline::SymmetricMatrix<size_t, double, std::vector> lower(lower_offsets, lower_indices, lower_values);
+  CHECK(whole.diagonal() == dense.diagonal());
+  CHECK(whole.upper() == dense.upper());
+  CHECK(lower.diagonal() == dense.diagonal());
+  CHECK(lower.upper() == dense.upper());
+
+  // Out again, on the pattern of the skyline and on the original pattern
+  std::vector<size_t> sky_offsets, sky_indices;
+  whole.compressed(sky_offsets, sky_indices);
+  CHECK(sky_offsets.size() == n + 1);
+  CHECK(sky_indices.size() == n + 2 * whole.structure()->profile());
+  std::vector<double> sky_values(sky_indices.size());
+  CHECK(whole.compressed_values(sky_offsets, sky_indices, sky_values));
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t r = sky_offsets[i]; r < sky_offsets[i + 1]; ++r) {
+      if (r > sky_offsets[i]) {
+        CHECK(sky_indices[r - 1] < sky_indices[r]);
+      }
+      CHECK(sky_values[r] == M[i][sky_indices[r]]);
+    }
+  }
+  std::vector<double> out(values.size());
+  CHECK(whole.compressed_values(offsets, indices, out));
+  CHECK(out == values);
+
+  // Arrays that don't fit are turned away without being read
+  std::vector<size_t> none, short_offsets(offsets.begin(), offsets.end() - 1);
+  CHECK(skyline::SymmetricMatrix<size_t, double, std::vector>::compressed_heights(none, indices).empty());
+  CHECK(skyline::SymmetricMatrix<size_t, double, std::vector>::compressed_heights(offsets, none).empty());
+  CHECK_FALSE(whole.assign_compressed(none, indices, values));
+  CHECK_FALSE(whole.assign_compressed(short_offsets, indices, values));
+  CHECK_FALSE(whole.assign_compressed(offsets, indices, std::vector<double>(values.size() - 1)));
+  CHECK_FALSE(whole.compressed_values(short_offsets, indices, out));
+  CHECK_FALSE(whole.compressed_values(offsets, none, out));
+  CHECK(whole.diagonal() == dense.diagonal());
+
+  // Back in with threads, into a matrix that has been factored
+  whole.threads(3);
+  whole.utdu();
+  CHECK(whole.assign_compressed(sky_offsets, sky_indices, sky_values));
+  CHECK(whole.diagonal() == dense.diagonal());
+  CHECK(whole.upper() == dense.upper());
+  std::vector<double> b(n, 1.0), x(b), y(b);
+  dense.ldlt_solve(x);
+  whole.ldlt_solve(y);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(y[i] == Approx(x[i]));
+  }
+}
+
+TEST_CASE("Concurrent Scatter Assembly", "[ScatterAssembler]")
+{
+  // Bilinear elements on a grid of cells, each adding a small symmetric matrix over its four
+  // corners. Neighboring cells share corners, so a checkerboard of four colors is needed.
+  size_t m = 30;
+  size_t n = (m + 1) * (m + 1);
+  std::vector<std::vector<size_t>> elements;
+  for (size_t y = 0; y < m; ++y) {
+    for (size_t x = 0; x < m; ++x) {
+      size_t c = y * (m + 1) + x;
+      elements.push_back({ c, c + 1, c + m + 1, c + m + 2 });
+    }
+  }
+  auto contribution = [&](size_t e, const auto &add) {
+    const std::vector<size_t> &nodes = elements[e];
+    for (size_t p = 0; p < 4; ++p) {
+      add(nodes[p], nodes[p], 2.0 + 0.001 * e);
+      for (size_t q = p + 1; q < 4; ++q) {
+        add(nodes[p], nodes[q], -0.5 - 0.01 * ((p + q) % 3));
+      }
+    }
+  };
+  skyline::TripletAssembler<size_t, double, std::vector> triplets(n);
+  for (size_t e = 0; e < elements.size(); ++e) {
+    contribution(e, [&](size_t i, size_t j, double v) { triplets.add(i, j, v); });
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> reference = triplets.matrix();
+
+  for (skyline::Scatter scatter : { skyline::Scatter::Colored, skyline::Scatter::Private }) {
+    for (unsigned threads : { 1u, 3u }) {
+      INFO("Threads " << threads);
+      skyline::SymmetricMatrix<size_t, double, std::vector> matrix(reference.structure());
+      matrix.threads(threads);
+      skyline::ScatterAssembler<size_t, double, std::vector> assembler(matrix, elements);
+      CHECK(assembler.colors() == 4);
+      assembler.add(contribution, scatter);
+      CHECK(matrix.diagonal().size() == reference.diagonal().size());
+      std::vector<double> d = matrix.diagonal(), u = matrix.upper();
+      std::vector<double> dr = reference.diagonal(), ur = reference.upper();
+      for (size_t i = 0; i < d.size(); ++i) {
+        CHECK(d[i] == Approx(dr[i]));
+      }
+      for (size_t i = 0; i < u.size(); ++i) {
+        CHECK(u[i] == Approx(ur[i]));
+      }
+      // Twice over, into a tracked matrix that has been factored
+      matrix.track(true);
+      matrix.utdu();
+      assembler.add(contribution, scatter);
+      CHECK(matrix.dirty() == 0);
+      CHECK(matrix(n - 1, n - 1) == Approx(2.0 * dr[n - 1]));
+      CHECK(matrix(0, 1) == Approx(2.0 * reference(0, 1)));
+    }
+  }
+}
+
+TEST_CASE("Structure Indices", "[Structure]")
+{
+  // The heights are given back from the offsets, with a first column that has a height
+  std::vector<size_t> heights{ 1, 1, 2, 0, 3, 4, 1, 6 };
+  skyline::Structure<size_t, std::vector> structure(heights);
+  CHECK(structure.heights() == heights);
+  CHECK(structure.offsets() == std::vector<size_t>({ 0, 1, 2, 4, 4, 7, 11, 12 }));
+  CHECK(structure.minima() == std::vector<size_t>({ 0, 0, 0, 3, 1, 1, 5, 1 }));
+  CHECK(structure.profile() == 18);
+  skyline::SymmetricMatrix<size_t, double, std::vector> sky(std::make_shared<const skyline::Structure<size_t, std::vector>>(heights));
+  CHECK(sky.heights() == heights);
+  // Element access through the position in storage finds the column of the element
+  sky.track(true);
+  sky.utdu();
+  CHECK(sky.dirty() == 8);
+#ifndef SKYLINE_MULTIPLE_ARRAY
+  sky(8 + 9) = 1.0;
+#else
+  sky(9) = 1.0;
+#endif
+  CHECK(sky.dirty() == 5);
+
+#ifdef SKYLINE_COMPACT_INDEX
+  // Indices that need more than 32 bits are split into runs with their own base
+  std::vector<size_t> small{ 0, 5, 3, 4000000000, 7 };
+  skyline::CompactIndex<size_t, std::vector> narrow(small);
+  CHECK(narrow.runs() == 1);
+  CHECK(narrow.expand() == small);
+  std::vector<size_t> wide{ 0, 5, (size_t)1 << 33, ((size_t)1 << 33) + 7, (size_t)1 << 40, 3, 9, 11, 12 };
+  skyline::CompactIndex<size_t, std::vector> split(wide);
+  CHECK(split.runs() > 1);
+  CHECK(split.size() == wide.size());
+  for (size_t i = 0; i < wide.size(); ++i) {
+    INFO("Error at index " << i);
+    CHECK(split[i] == wide[i]);
+  }
+  CHECK(sizeof(skyline::CompactIndex<size_t, std::vector>::Compact) == 4);
+  CHECK(sizeof(skyline::CompactIndex<unsigned short, std::vector>::Compact) == 2);
+#endif
+}
+
+TEST_CASE("Shared Structure And Refactorization", "[SymmetricMatrix]")
+{
+  // Two matrices with the pattern of a 12x12 grid Laplacian share one structure, the second
+  // is refactored with scaled values and should give the scaled factors
+  size_t m = 12;
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m);
+  }
+  auto structure = std::make_shared<const skyline::Structure<size_t, std::vector>>(heights);
+  CHECK(structure->size() == n);
+  CHECK(structure->profile() == std::accumulate(heights.begin(), heights.end(), (size_t)0));
+
+  skyline::SymmetricMatrix<size_t, double, std::vector> first(structure);
+  skyline::SymmetricMatrix<size_t, double, std::vector> second(structure);
+  CHECK(first.structure() == second.structure());
+  CHECK(first.minima() == structure->minima());
+
+  std::vector<double> values(n + structure->profile());
+  for (size_t k = 0; k < n; ++k) {
+    first(k, k) = 4.0;
+    values[*first.index(k, k)] = 8.0;
+    if (k % m != 0) {
+      first(k - 1, k) = -1.0;
+      values[*first.index(k - 1, k)] = -2.0;
+    }
+    if (k >= m) {
+      first(k - m, k) = -1.0;
+      values[*first.index(k - m, k)] = -2.0;
+    }
+  }
+  first.utdu();
+
+  // Values that don't match the structure are turned away, and zero pivots are reported
+  std::vector<double> longer(values.size() + 1, 1.0), shorter(values.size() - 1, 1.0);
+  auto before = second.diagonal();
+  CHECK_FALSE(second.refactor(longer));
+  CHECK_FALSE(second.refactor(shorter));
+  CHECK(second.diagonal() == before);
+  CHECK_FALSE(second.refactor(std::vector<double>(values.size(), 0.0)));
+
+  // The unit upper triangular factor is the same, the diagonal is doubled
+  for (int pass = 0; pass < 2; ++pass) {
+    CHECK(second.refactor(values));
+    auto d = second.diagonal();
+    auto dr = first.diagonal();
+    for (size_t i = 0; i < n; ++i) {
+      INFO("Error at index " << i);
+      CHECK(d[i] == Approx(2.0 * dr[i]));
+    }
+    auto u = second.upper();
+    auto ur = first.upper();
+    for (size_t i = 0; i < u.size(); ++i) {
+      INFO("Error at index " << i);
+      CHECK(u[i] == Approx(ur[i]).margin(1.0e-14));
+    }
+  }
+}
+
+TEST_CASE("Allocator Aware Storage", "[SymmetricMatrix]")
+{
+  // The 12x12 grid Laplacian with aligned vectors and with polymorphic vectors from an arena,
+  // checked against the same system with the default vectors
+  struct CountingResource : public std::pmr::memory_resource
+  {
+    size_t allocations{ 0 };
+    size_t outstanding{ 0 };
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+      ++allocations;
+      outstanding += bytes;
+      return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override
+    {
+      outstanding -= bytes;
+      std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+      return this == &other;
+    }
+  };
+
+  size_t m = 12;
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m);
+  }
+  auto set = [m, n](auto &sky) {
+    for (size_t k = 0; k < n; ++k) {
+      sky(k, k) = 4.0;
+      if (k % m != 0) {
+        sky(k - 1, k) = -1.0;
+      }
+      if (k >= m) {
+        sky(k - m, k) = -1.0;
+      }
+    }
+  };
+  skyline::SymmetricMatrix<size_t, double, std::vector> reference(heights);
+  set(reference);
+  std::vector<double> x(n, 1.0);
+  reference.ldlt_solve(x);
+
+  skyline::SymmetricMatrix<size_t, double, skyline::AlignedVector> aligned(std::make_shared<const skyline::Structure<size_t, skyline::AlignedVector>>(
+    skyline::AlignedVector<size_t>(heights.begin(), heights.end())));
+  set(aligned);
+  CHECK(reinterpret_cast<uintptr_t>(&aligned(0, 0)) % skyline::storage_alignment == 0);
+  skyline::AlignedVector<double> y(n, 1.0);
+  aligned.ldlt_solve(y);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(y[i] == Approx(x[i]));
+  }
+
+  // Everything but the structure comes from the arena, which gets its memory from the counting
+  // resource. Releasing it hands all of that back at once.
+  auto structure = std::make_shared<const skyline::Structure<size_t, std::pmr::vector>>(
+    std::pmr::vector<size_t>(heights.begin(), heights.end()));
+  CountingResource counting;
+  std::pmr::monotonic_buffer_resource arena(&counting);
+  skyline::AlignedResource resource(&arena);
+  for (int step = 0; step < 3; ++step) {
+    {
+      skyline::SymmetricMatrix<size_t, double, std::pmr::vector> first(structure, &resource);
+      skyline::SymmetricMatrix<size_t, double, std::pmr::vector> second(structure, &resource);
+      CHECK(first.get_allocator().resource() == &resource);
+      CHECK(reinterpret_cast<uintptr_t>(&first(0, 0)) % skyline::storage_alignment == 0);
+      CHECK(reinterpret_cast<uintptr_t>(&second(0, 0)) % skyline::storage_alignment == 0);
+      set(first);
+      set(second);
+      std::pmr::vector<double> z(n, 1.0);
+      first.ldlt_solve(z);
+      second.utdu();
+      for (size_t i = 0; i < n; ++i) {
+        INFO("Error at index " << i);
+        CHECK(z[i] == Approx(x[i]));
+      }
+    }
+    CHECK(counting.allocations > 0);
+    CHECK(counting.outstanding > 0);
+    arena.release();
+    CHECK(counting.outstanding == 0);
+  }
+  CHECK(reference.get_allocator() == std::allocator<double>());
+}
+
+TEST_CASE("Partial Refactorization", "[SymmetricMatrix]")
+{
+  // Laplacian on a 40x40 grid, wide enough for panels. The values are changed after the first
+  // factorization, first near the end and then in the middle of a panel, and the refactored
+  // matrix is compared with one that gets the same values and a full factorization. A copy
+  // with threads resumes on them.
+  size_t m = 40;
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m);
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> skyline(heights);
+  skyline::SymmetricMatrix<size_t, double, std::vector> fresh(heights);
+  skyline::SymmetricMatrix<size_t, double, std::vector> threaded(heights);
+  CHECK(skyline.dirty() == 0);
+  CHECK(skyline.track(true));
+  CHECK(threaded.track(true));
+  threaded.threads(3);
+  for (auto sky : { &skyline, &fresh, &threaded }) {
+    for (size_t k = 0; k < n; ++k) {
+      (*sky)(k, k) = 4.0;
+      if (k % m != 0) {
+        (*sky)(k - 1, k) = -1.0;
+      }
+      if (k >= m) {
+        (*sky)(k - m, k) = -1.0;
+      }
+    }
+  }
+  skyline.utdu();
+  threaded.utdu();
+  CHECK(skyline.dirty() == n);
+  // Element access is to the values now, not the factors. Reading with value() leaves the
+  // factors alone, the references count as changes.
+  CHECK(skyline.value(n - 1, n - 1) == 4.0);
+  CHECK(skyline.value(n - 2, n - 1) == -1.0);
+  CHECK(skyline.value(0, n - 1) == 0.0);
+  CHECK(skyline.dirty() == n);
+  CHECK(skyline(n - 1, n - 1) == 4.0);
+  CHECK(skyline(n - 2, n - 1) == -1.0);
+  CHECK(skyline.dirty() == n - 1);
+
+  auto compare = [&]() {
+    skyline::SymmetricMatrix<size_t, double, std::vector> reference(fresh);
+    reference.utdu();
+    skyline.utdu();
+    CHECK(skyline.dirty() == n);
+    threaded.utdu();
+    CHECK(threaded.dirty() == n);
+    CHECK(threaded.diagonal() == skyline.diagonal());
+    CHECK(threaded.upper() == skyline.upper());
+    auto d = skyline.diagonal();
+    auto dr = reference.diagonal();
+    for (size_t i = 0; i < n; ++i) {
+      INFO("Error at index " << i);
+      CHECK(d[i] == Approx(dr[i]));
+    }
+    auto u = skyline.upper();
+    auto ur = reference.upper();
+    for (size_t i = 0; i < u.size(); ++i) {
+      INFO("Error at index " << i);
+      CHECK(u[i] == Approx(ur[i]).margin(1.0e-12));
+    }
+    std::vector<double> b(n, 1.0), x(n, 1.0);
+    skyline.forward_substitution(b);
+    skyline.back_substitution(b);
+    reference.forward_substitution(x);
+    reference.back_substitution(x);
+    for (size_t i = 0; i < n; ++i) {
+      INFO("Error at index " << i);
+      CHECK(b[i] == Approx(x[i]));
+    }
+  };
+
+  for (auto sky : { &skyline, &fresh, &threaded }) {
+    (*sky)(n - m - 3, n - 3) = -1.5;
+    sky->diagonal(n - 2) = 5.0;
+  }
+  CHECK(skyline.dirty() == n - 3);
+  compare();
+
+  size_t k = n / 2 + 1;
+  for (auto sky : { &skyline, &fresh, &threaded }) {
+    sky->set(k - m, k, -0.5);
+  }
+  CHECK(skyline.dirty() == k);
+  compare();
+
+  // Nothing changed, so nothing to do
+  compare();
+
+  // A band wide enough that the rows above the first change are split among the threads too
+  size_t w = 120;
+  std::vector<size_t> band(600);
+  for (size_t k = 0; k < band.size(); ++k) {
+    band[k] = std::min(k, w);
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> serial_band(band), threaded_band(band);
+  threaded_band.threads(4);
+  for (auto sky : { &serial_band, &threaded_band }) {
+    CHECK(sky->track(true));
+    for (size_t k = 0; k < band.size(); ++k) {
+      sky->set(k, k, 2.0 * w + 1.0);
+      for (size_t i = k - band[k]; i < k; ++i) {
+        sky->set(i, k, -1.0 + 0.001 * ((i + k) % 11));
+      }
+    }
+    sky->utdu();
+    sky->set(band.size() - 50 - w, band.size() - 50, -0.5);
+    sky->utdu();
+  }
+  CHECK(threaded_band.diagonal() == serial_band.diagonal());
+  CHECK(threaded_band.upper() == serial_band.upper());
+
+  // Without the values there's no going back
+  skyline::SymmetricMatrix<size_t, double, std::vector> untracked(fresh);
+  untracked.utdu();
+  CHECK_FALSE(untracked.track(true));
+  CHECK_FALSE(untracked.track());
+}
+
+TEST_CASE("Mixed Precision Solve", "[MixedPrecisionMatrix]")
+{
+  // Laplacian on a 40x40 grid, refinement of the single precision solution should give the
+  // double precision one
+  size_t m = 40;
+  size_t n = m * m;
+  std::vector<size_t> heights(n);
+  for (size_t k = 0; k < n; ++k) {
+    heights[k] = std::min(k, m);
+  }
+  skyline::MixedPrecisionMatrix<size_t, std::vector> mixed(heights);
+  for (size_t k = 0; k < n; ++k) {
+    mixed(k, k) = 4.0;
+    if (k % m != 0) {
+      mixed(k - 1, k) = -1.0;
+    }
+    if (k >= m) {
+      mixed(k - m, k) = -1.0;
+    }
+  }
+  skyline::SymmetricMatrix<size_t, double, std::vector> reference(mixed);
+
+  std::vector<double> b(n), x(n);
+  for (size_t i = 0; i < n; ++i) {
+    b[i] = 1.0 + (double)(i % 5);
+  }
+  x = b;
+  mixed.ldlt_solve(b);
+  reference.ldlt_solve(x);
+  CHECK_FALSE(mixed.fell_back());
+  CHECK(mixed.iterations() > 1);
+  CHECK(mixed.iterations() < 10);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(b[i] == Approx(x[i]).epsilon(1.0e-12));
+  }
+
+  // The factors are reused for another right hand side
+  std::fill(b.begin(), b.end(), 1.0);
+  std::fill(x.begin(), x.end(), 1.0);
+  mixed.solve(b);
+  reference.forward_substitution(x);
+  reference.back_substitution(x);
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(b[i] == Approx(x[i]).epsilon(1.0e-12));
+  }
+
+  // Values too big for single precision
+  for (size_t k = 0; k < n; ++k) {
+    mixed(k, k) *= 1.0e40;
+    if (k >= m) {
+      mixed(k - m, k) *= 1.0e40;
+    }
+    if (k % m != 0) {
+      mixed(k - 1, k) *= 1.0e40;
+    }
+  }
+  std::fill(b.begin(), b.end(), 1.0e40);
+  CHECK(mixed.ldlt_solve(b));
+  CHECK(mixed.fell_back());
+  for (size_t i = 0; i < n; ++i) {
+    INFO("Error at index " << i);
+    CHECK(b[i] == Approx(x[i]).epsilon(1.0e-12));
+  }
+
+  // Singular in both precisions, nothing can be solved and b is left alone
+  std::vector<size_t> pair{ 0, 1 };
+  skyline::MixedPrecisionMatrix<size_t, std::vector> zero(pair);
+  std::vector<double> c{ 1.0, 2.0 };
+  CHECK_FALSE(zero.ldlt_solve(c));
+  CHECK(zero.fell_back());
+  CHECK(c == std::vector<double>({ 1.0, 2.0 }));
+  CHECK_FALSE(zero.solve(c));
+  CHECK_FALSE(zero.ldlt_solve(c, 1));
+  CHECK(c == std::vector<double>({ 1.0, 2.0 }));
+
+  // Singular in double precision but not once rounded to single precision, so the refinement
+  // stalls and the double precision factorization it falls back on breaks down
+  skyline::MixedPrecisionMatrix<size_t, std::vector> rounded(pair);
+  double e = 1.0 + std::ldexp(1.0, -24) - std::ldexp(1.0, -40);
+  rounded(0, 0) = 1.0;
+  rounded(0, 1) = e;
+  rounded(1, 1) = e * e;
+  CHECK(rounded.utdu());
+  CHECK_FALSE(rounded.fell_back());
+  CHECK_FALSE(rounded.solve(c));
+  CHECK(rounded.fell_back());
+  CHECK(c == std::vector<double>({ 1.0, 2.0 }));
+}